@@ -0,0 +1,281 @@
+include(write_if_diff)
+
+# Writes `<DIR>/noctern/enum_<SIZE>.bench.hpp`, defining `noctern::bench::enum_<SIZE>`: an
+# `enum_mixin` enum of SIZE values, `v0` to `v<SIZE - 1>`, to benchmark enum dispatch and the
+# build with.
+function(bench_enum DIR SIZE)
+  set(name enum_${SIZE})
+  math(EXPR last "${SIZE} - 1")
+  if(SIZE GREATER 256)
+    set(underlying uint16_t)
+  else()
+    set(underlying uint8_t)
+  endif()
+
+  set(values "")
+  set(cases "")
+  set(vals "")
+  foreach(i RANGE ${last})
+    string(APPEND values "            v${i},\n")
+    string(APPEND cases "                NOCTERN_ENUM_X_INTROSPECT(v${i})\n")
+    string(APPEND vals ", val<v${i}>")
+  endforeach()
+
+  write_if_diff(${DIR}/noctern/${name}.bench.hpp "\
+#pragma once
+
+// Generated by cmake/bench_enum.cmake.
+
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+#include <utility>
+
+#include \"noctern/enum.hpp\"
+
+namespace noctern::bench {
+    struct _${name}_wrapper {
+        enum class ${name} : ${underlying} {
+${values}        };
+
+    private:
+        friend enum_mixin;
+
+        template <typename Fn>
+        friend constexpr decltype(auto) switch_introspect(${name} e, Fn&& fn) {
+            switch (e) {
+                using enum ${name};
+${cases}            }
+            assert(false);
+            std::unreachable();
+        }
+
+        template <typename Fn>
+        friend constexpr decltype(auto) introspect(type_t<${name}>, Fn&& fn) {
+            using enum ${name};
+            return std::invoke(std::forward<Fn>(fn)${vals});
+        }
+    };
+
+    using ${name} = _${name}_wrapper::${name};
+}
+")
+endfunction()
+
+# The source of one translation unit for `bench_build`, over `enum_<SIZE>`, in OUT.
+function(_bench_build_source OUT KIND SIZE)
+  set(name enum_${SIZE})
+  if(KIND STREQUAL enum_switch OR KIND STREQUAL enum_dispatch)
+    # Dispatch from several call sites, as over the token and rule enums.
+    set(sites "")
+    foreach(site RANGE 7)
+      string(APPEND sites "    template uint64_t dispatch<${site}>(${name}, uint64_t);\n")
+    endforeach()
+    set(${OUT} "\
+// Generated by cmake/bench_enum.cmake.
+
+#include <cstdint>
+
+#include \"noctern/${name}.bench.hpp\"
+
+namespace noctern::bench {
+    template <int Site>
+    uint64_t dispatch(${name} e, uint64_t acc) {
+        return noctern::${KIND}(e, [&]<${name} v>(val_t<v>) -> uint64_t {
+            return acc * 31 + noctern::to_underlying(v) * (Site + 1);
+        });
+    }
+
+${sites}}
+" PARENT_SCOPE)
+  elseif(KIND STREQUAL token_data)
+    # One in four tokens has runtime data, as identifiers and literals do; the rest are spelled
+    # `t<i>`, as keywords and operators are.
+    math(EXPR last "${SIZE} - 1")
+    set(specializations "")
+    foreach(i RANGE ${last})
+      math(EXPR remainder "${i} % 4")
+      if(remainder EQUAL 0)
+        set(data "string_data {}")
+      else()
+        set(data "empty_data<\"t${i}\"> {}")
+      endif()
+      string(APPEND specializations "\
+    template <>
+    inline constexpr auto token_data<${name}::v${i}> = ${data};
+
+")
+    endforeach()
+    set(${OUT} "\
+// Generated by cmake/bench_enum.cmake.
+
+#include <concepts>
+#include <cstddef>
+#include <string_view>
+#include <type_traits>
+
+#include \"noctern/enum.hpp\"
+#include \"noctern/${name}.bench.hpp\"
+#include \"noctern/tokenize.hpp\"
+
+// A `token_data` table over `${name}`, and what tokenize.hpp and tokenize.cpp build from theirs.
+
+namespace noctern::bench {
+    template <${name} token>
+    inline constexpr auto token_data = nullptr;
+
+${specializations}\
+    template <${name} token>
+    using token_data_t = std::remove_cvref_t<decltype(token_data<token>)>;
+
+    template <${name} token>
+    concept has_defined_token_data = !std::same_as<token_data_t<token>, std::nullptr_t>;
+
+    static_assert(enum_values(type<${name}>, []<${name}... tokens>(val_t<tokens>...) {
+        static_assert((has_defined_token_data<tokens> && ...));
+        return true;
+    }));
+
+    template <typename Fn>
+    constexpr void for_each_empty_token(Fn&& fn) {
+        enum_values(type<${name}>, [&]<${name}... tokens>(val_t<tokens>...) {
+            (
+                [&]<${name} token, typename Data>(val_t<token> val, Data data) {
+                    if constexpr (is_empty_data<Data>) {
+                        fn(val, data);
+                    }
+                }(val<tokens>, token_data<tokens>),
+                ...);
+        });
+    }
+
+    inline constexpr enum_bitset<${name}> tokens_with_data = [] {
+        enum_bitset<${name}> result;
+        enum_values(type<${name}>, [&]<${name}... tokens>(val_t<tokens>...) {
+            (
+                [&]<${name} token>(val_t<token>) {
+                    if constexpr (!is_empty_data<token_data_t<token>>) result.insert(token);
+                }(val<tokens>),
+                ...);
+        });
+        return result;
+    }();
+
+    // Built as `token_for_leading_char` is.
+    inline constexpr enum_array<${name}, std::string_view> spellings = [] {
+        enum_array<${name}, std::string_view> result;
+        for_each_empty_token([&]<${name} token, typename Data>(val_t<token>, Data) {
+            result[token] = Data::value;
+        });
+        return result;
+    }();
+
+    std::string_view spelling(${name} token) {
+        return enum_switch(token, []<${name} t>(val_t<t>) -> std::string_view {
+            if constexpr (is_empty_data<token_data_t<t>>) {
+                return token_data_t<t>::value;
+            } else {
+                return {};
+            }
+        });
+    }
+
+    bool has_data(${name} token) {
+        return tokens_with_data.contains(token) && spellings[token].empty();
+    }
+}
+" PARENT_SCOPE)
+  elseif(KIND STREQUAL iterators)
+    set(${OUT} "\
+// Generated by cmake/bench_enum.cmake.
+
+#include <cstddef>
+#include <iterator>
+#include <utility>
+
+#include \"noctern/iterator_facade.hpp\"
+
+namespace noctern::bench {
+    // ${SIZE} iterators like `tokens::const_iterator`, one per `I`.
+    template <int I>
+    class iterator : public iterator_facade<iterator<I>> {
+    public:
+        using difference_type = std::ptrdiff_t;
+
+        constexpr iterator() = default;
+
+        constexpr std::ptrdiff_t read() const {
+            return index_ * (I + 1);
+        }
+
+        constexpr void advance(std::ptrdiff_t offset) {
+            index_ += offset;
+        }
+
+        constexpr std::ptrdiff_t distance(iterator rhs) const {
+            return rhs.index_ - index_;
+        }
+
+    private:
+        std::ptrdiff_t index_ = 0;
+    };
+
+    static_assert([]<int... Is>(std::integer_sequence<int, Is...>) {
+        return (std::random_access_iterator<iterator<Is>> && ...);
+    }(std::make_integer_sequence<int, ${SIZE}>()));
+}
+" PARENT_SCOPE)
+  else()
+    message(FATAL_ERROR "Unknown build benchmark: ${KIND}")
+  endif()
+endfunction()
+
+# Adds TARGET, which measures the time and peak memory of compiling each of the KINDS of
+# translation unit at each of the SIZES, e.g. `cmake --build . --target noctern.bench.build`:
+#
+#   enum_switch, enum_dispatch: either over an enum of SIZE values.
+#   token_data: a `token_data` table of SIZE tokens, with what tokenize.hpp builds from it.
+#   iterators: SIZE iterator types on `iterator_facade`, checked against the iterator concepts.
+#
+# Each kind is reported with its growth from the previous size, to catch super-linear build cost.
+# Only for GCC-like compilers.
+function(bench_build TARGET DIR)
+  cmake_parse_arguments(PARSE_ARGV 2 arg "" "" "SIZES;KINDS")
+
+  set(sources "")
+  foreach(kind IN LISTS arg_KINDS)
+    foreach(size IN LISTS arg_SIZES)
+      bench_enum(${DIR} ${size})
+      _bench_build_source(content ${kind} ${size})
+      # Named `<series>_<size>`, for compile_cost.cmake.
+      set(source ${DIR}/${kind}_${size}.bench_build.cpp)
+      write_if_diff(${source} "${content}")
+      list(APPEND sources ${source})
+    endforeach()
+  endforeach()
+
+  # As a release build would compile them.
+  separate_arguments(flags NATIVE_COMMAND "${CMAKE_CXX_FLAGS} ${CMAKE_CXX_FLAGS_RELEASE}")
+  list(APPEND flags
+    ${CMAKE_CXX23_STANDARD_COMPILE_OPTION}
+    -I${PROJECT_SOURCE_DIR}/src
+    -I${DIR}
+  )
+
+  set(script ${DIR}/${TARGET}.cmake)
+  write_if_diff(${script} "\
+set(COMPILER [[${CMAKE_CXX_COMPILER}]])
+set(FLAGS [[${flags}]])
+set(SOURCES [[${sources}]])
+set(OUTPUT_DIR [[${DIR}]])
+include([[${PROJECT_SOURCE_DIR}/cmake/compile_cost.cmake]])
+")
+  add_custom_target(${TARGET}
+    COMMAND ${CMAKE_COMMAND} -DCOMPILE_COST=$<TARGET_FILE:noctern.compile_cost> -P ${script}
+    DEPENDS ${sources}
+    COMMENT "Measuring the build cost of ${arg_KINDS}"
+    VERBATIM
+  )
+  add_dependencies(${TARGET} noctern.compile_cost)
+endfunction()
@@ -0,0 +1,54 @@
+# Compiles each of SOURCES with COMPILER and FLAGS into OUTPUT_DIR, under COMPILE_COST (the
+# noctern.compile_cost tool), and reports how long each took and its peak memory.
+# Run as a script (`cmake -P`), with the variables set first.
+#
+# Sources named `<series>_<size>` are a series: each is also compared with the one before it, so
+# that build cost growing faster than the size stands out.
+
+# `NUMERATOR / DENOMINATOR` to one decimal place, e.g. "2.1".
+function(_compile_cost_ratio OUT NUMERATOR DENOMINATOR)
+  if(DENOMINATOR EQUAL 0)
+    set(${OUT} "?" PARENT_SCOPE)
+    return()
+  endif()
+  math(EXPR tenths "(${NUMERATOR} * 10 + ${DENOMINATOR} / 2) / ${DENOMINATOR}")
+  math(EXPR whole "${tenths} / 10")
+  math(EXPR fraction "${tenths} % 10")
+  set(${OUT} "${whole}.${fraction}" PARENT_SCOPE)
+endfunction()
+
+foreach(source IN LISTS SOURCES)
+  get_filename_component(name ${source} NAME_WE)
+
+  execute_process(
+    COMMAND ${COMPILE_COST} ${COMPILER} ${FLAGS} -c ${source} -o ${OUTPUT_DIR}/${name}.o
+    OUTPUT_VARIABLE cost
+    RESULT_VARIABLE result
+  )
+  if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Couldn't compile ${source}")
+  endif()
+  string(STRIP "${cost}" cost)
+  separate_arguments(cost UNIX_COMMAND "${cost}")
+  list(GET cost 0 ms)
+  list(GET cost 1 bytes)
+  math(EXPR mib "${bytes} / (1024 * 1024)")
+
+  set(report "${name}: ${ms} ms, ${mib} MiB")
+  if(name MATCHES "^(.*)_([0-9]+)$")
+    set(series ${CMAKE_MATCH_1})
+    set(size ${CMAKE_MATCH_2})
+    if(DEFINED last_size_${series})
+      _compile_cost_ratio(size_growth ${size} ${last_size_${series}})
+      _compile_cost_ratio(ms_growth ${ms} ${last_ms_${series}})
+      _compile_cost_ratio(bytes_growth ${bytes} ${last_bytes_${series}})
+      string(APPEND report
+        " (${size_growth}x the size of ${series}_${last_size_${series}}: "
+        "${ms_growth}x the time, ${bytes_growth}x the memory)")
+    endif()
+    set(last_size_${series} ${size})
+    set(last_ms_${series} ${ms})
+    set(last_bytes_${series} ${bytes})
+  endif()
+  message(STATUS "${report}")
+endforeach()
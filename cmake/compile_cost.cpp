@@ -0,0 +1,50 @@
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <fmt/core.h>
+
+#include <spawn.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+extern char** environ;
+
+// Usage: noctern.compile_cost <command> [args...]
+//
+// Runs the command, e.g. a compiler, and prints how long it took and the most memory it had
+// resident at once: "<milliseconds> <bytes>". The command's own output passes through. Fails as
+// the command does.
+//
+// Used by compile_cost.cmake to measure each translation unit of a build benchmark. Only built with
+// the benchmarks, and doesn't need the library.
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fmt::println(stderr, "Usage: noctern.compile_cost <command> [args...]");
+        return 2;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    pid_t pid;
+    if (const int error = ::posix_spawnp(&pid, argv[1], nullptr, nullptr, argv + 1, environ)) {
+        fmt::println(stderr, "Couldn't run {}: {}", argv[1], std::strerror(error));
+        return 1;
+    }
+
+    // The child's own usage, unlike `getrusage(RUSAGE_CHILDREN)`, which is the largest of all.
+    int status;
+    rusage usage;
+    if (::wait4(pid, &status, 0, &usage) != pid) {
+        fmt::println(stderr, "Couldn't wait for {}: {}", argv[1], std::strerror(errno));
+        return 1;
+    }
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+
+    if (!WIFEXITED(status)) return 1;
+    if (WEXITSTATUS(status) != 0) return WEXITSTATUS(status);
+
+    // In KiB on Linux.
+    fmt::println("{} {}", elapsed.count(), static_cast<long long>(usage.ru_maxrss) * 1024);
+}
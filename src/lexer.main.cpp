@@ -1,18 +1,23 @@
-#include <iostream>
-#include <sstream>
-#include <string>
+#include <cstdio>
 
 #include <fmt/core.h>
+#include <noctern/source_file.hpp>
 #include <noctern/tokenize.hpp>
 
-int main() {
-    const std::string input = [] {
-        std::ostringstream out;
-        out << std::cin.rdbuf();
-        return out.str();
-    }();
+#include <unistd.h>
 
-    noctern::tokens tokens = noctern::tokenize_all(input);
+// Usage: noctern.lexer [file.nct]
+//
+// Reads stdin if no file is given.
+int main(int argc, char** argv) {
+    auto input = argc > 1 ? noctern::source_file::open(argv[1])
+                          : noctern::source_file::read(STDIN_FILENO);
+    if (!input.has_value()) {
+        fmt::println(stderr, "Couldn't read input: {}", input.error().message());
+        return 1;
+    }
+
+    noctern::tokens tokens = noctern::tokenize_all(input->contents());
 
     for (noctern::token token : tokens) {
         noctern::token_id id = tokens.id(token);
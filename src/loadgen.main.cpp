@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "noctern/eval_client.hpp"
+#include "noctern/eval_protocol.hpp"
+
+namespace {
+    using clock_type = std::chrono::steady_clock;
+
+    struct options {
+        std::string socket_path;
+        std::string module;
+        std::string function = "Main";
+        std::vector<double> args;
+        int connections = 4;
+        int requests = 10000;
+        // How many requests each connection keeps in flight.
+        int pipeline = 1;
+    };
+
+    template <typename T>
+    bool parse_number(std::string_view text, T& out) {
+        auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+        return ec == std::errc {} && ptr == text.data() + text.size();
+    }
+
+    bool parse_args(std::string_view text, std::vector<double>& out) {
+        while (!text.empty()) {
+            const size_t comma = std::min(text.find(','), text.size());
+            double arg;
+            if (!parse_number(text.substr(0, comma), arg)) return false;
+            out.push_back(arg);
+            text.remove_prefix(std::min(comma + 1, text.size()));
+        }
+        return true;
+    }
+
+    bool parse_options(int argc, char** argv, options& out) {
+        for (int i = 1; i < argc; ++i) {
+            std::string_view arg = argv[i];
+            const size_t equals = arg.find('=');
+            if (!arg.starts_with("--") || equals == std::string_view::npos) return false;
+            const std::string_view name = arg.substr(2, equals - 2);
+            const std::string_view value = arg.substr(equals + 1);
+
+            bool ok = true;
+            if (name == "socket") {
+                out.socket_path = value;
+            } else if (name == "module") {
+                out.module = value;
+            } else if (name == "fn") {
+                out.function = value;
+            } else if (name == "args") {
+                ok = parse_args(value, out.args);
+            } else if (name == "connections") {
+                ok = parse_number(value, out.connections) && out.connections > 0;
+            } else if (name == "requests") {
+                ok = parse_number(value, out.requests) && out.requests > 0;
+            } else if (name == "pipeline") {
+                ok = parse_number(value, out.pipeline) && out.pipeline > 0;
+            } else {
+                ok = false;
+            }
+            if (!ok) return false;
+        }
+        return !out.socket_path.empty() && !out.module.empty();
+    }
+
+    // Sends `options.requests` requests over one connection, recording each one's latency in
+    // microseconds.
+    bool run_connection(const options& options, std::vector<double>& latencies) {
+        auto client = noctern::eval_client::connect(options.socket_path);
+        if (!client.has_value()) {
+            fmt::println(stderr, "Couldn't connect to {}: {}", options.socket_path,
+                client.error().message());
+            return false;
+        }
+
+        noctern::eval_protocol::request request {
+            .module = options.module,
+            .function = options.function,
+            .args = options.args,
+        };
+        noctern::eval_protocol::response response;
+
+        std::vector<clock_type::time_point> sent(options.requests);
+        latencies.reserve(options.requests);
+
+        int num_sent = 0;
+        int num_received = 0;
+        while (num_received < options.requests) {
+            while (num_sent < options.requests && num_sent - num_received < options.pipeline) {
+                request.id = static_cast<uint32_t>(num_sent);
+                sent[num_sent] = clock_type::now();
+                if (std::error_code error = client->send(request)) {
+                    fmt::println(stderr, "send failed: {}", error.message());
+                    return false;
+                }
+                ++num_sent;
+            }
+
+            if (std::error_code error = client->receive(response)) {
+                fmt::println(stderr, "receive failed: {}", error.message());
+                return false;
+            }
+            if (response.status != noctern::eval_protocol::status::ok) {
+                fmt::println(stderr, "Request failed: {}", response.error);
+                return false;
+            }
+            const std::chrono::duration<double, std::micro> latency
+                = clock_type::now() - sent[response.id];
+            latencies.push_back(latency.count());
+            ++num_received;
+        }
+        return true;
+    }
+
+    double percentile(const std::vector<double>& sorted, double fraction) {
+        const auto index = static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1));
+        return sorted[index];
+    }
+}
+
+int main(int argc, char** argv) {
+    options options;
+    if (!parse_options(argc, argv, options)) {
+        fmt::println(stderr,
+            "Usage: noctern.loadgen --socket=<path> --module=<file.nct> [--fn=Main] [--args=1,2] "
+            "[--connections=4] [--requests=10000] [--pipeline=1]");
+        return 1;
+    }
+
+    std::vector<std::vector<double>> latencies(options.connections);
+    std::vector<char> succeeded(options.connections);
+    std::vector<std::thread> threads;
+
+    const clock_type::time_point start = clock_type::now();
+    for (int i = 0; i < options.connections; ++i) {
+        threads.emplace_back(
+            [&, i] { succeeded[i] = run_connection(options, latencies[i]) ? 1 : 0; });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    const std::chrono::duration<double> elapsed = clock_type::now() - start;
+
+    if (std::find(succeeded.begin(), succeeded.end(), 0) != succeeded.end()) return 1;
+
+    std::vector<double> all;
+    for (const std::vector<double>& connection : latencies) {
+        all.insert(all.end(), connection.begin(), connection.end());
+    }
+    std::sort(all.begin(), all.end());
+
+    fmt::println("requests:    {}", all.size());
+    fmt::println("connections: {} (pipeline depth {})", options.connections, options.pipeline);
+    fmt::println("throughput:  {:.0f} req/s", static_cast<double>(all.size()) / elapsed.count());
+    fmt::println("p50 latency: {:.1f} us", percentile(all, 0.50));
+    fmt::println("p99 latency: {:.1f} us", percentile(all, 0.99));
+}
@@ -0,0 +1,84 @@
+#include "./arena.hpp"
+
+#include <catch2/catch.hpp>
+#include <optional>
+#include <string>
+#include <utility>
+
+#include <fmt/format.h>
+
+#include "noctern/compilation_unit.hpp"
+#include "noctern/memory_stats.hpp"
+#include "noctern/parser.hpp"
+#include "noctern/symbol_table.hpp"
+#include "noctern/tokenize.hpp"
+#include "noctern/value_numbering.hpp"
+
+namespace noctern {
+    namespace {
+        std::string generated_module(int num_fns) {
+            std::string source;
+            for (int i = 0; i < num_fns; ++i) {
+                source += fmt::format(
+                    "def f{}(x, y): {{ let a = x * {}; let b = a - y / 3; return a + b * 2; }};\n",
+                    i, i);
+            }
+            return source;
+        }
+
+        // The whole front end, up to the structures which live as long as the compilation.
+        size_t compile(std::string_view source, arena* arena) {
+            const tokens parsed = noctern::eliminate_common_subexpressions(
+                noctern::parse(noctern::tokenize_all(source, arena)));
+            const compilation_unit unit(parsed);
+            const symbol_table symbols(parsed, unit);
+            return parsed.num_tokens() + unit.fn_defs().size();
+        }
+
+        TEST_CASE("compiling a module into an arena", "[benchmark]") {
+            const int num_fns = GENERATE(10, 1000, 100000);
+            const std::string source = noctern::generated_module(num_fns);
+
+            BENCHMARK(fmt::format("heap, {} functions", num_fns)) {
+                return noctern::compile(source, nullptr);
+            };
+
+            BENCHMARK(fmt::format("arena, {} functions", num_fns)) {
+                arena arena;
+                return noctern::compile(source, &arena);
+            };
+        }
+
+        // Not a timing benchmark: reports the memory of each phase, to catch regressions.
+        TEST_CASE("front end memory per phase", "[benchmark]") {
+            const std::string source = noctern::generated_module(10000);
+            arena arena;
+
+            std::optional<tokens> lexed;
+            memory_sample lex = noctern::measure_allocations(
+                arena, [&] { lexed.emplace(noctern::tokenize_all(source, &arena)); });
+            lex.retained = lexed->memory_usage();
+            const size_t num_tokens = lexed->num_tokens();
+
+            std::optional<tokens> parsed;
+            memory_sample parse = noctern::measure_allocations(
+                arena, [&] { parsed.emplace(noctern::parse(std::move(*lexed))); });
+            parse.retained = parsed->memory_usage();
+
+            std::optional<compilation_unit> unit;
+            std::optional<symbol_table> symbols;
+            memory_sample symbol_table = noctern::measure_allocations(arena, [&] {
+                unit.emplace(*parsed);
+                symbols.emplace(*parsed, *unit);
+            });
+            symbol_table.retained = unit->memory_usage() + symbols->memory_usage();
+            CHECK(symbol_table.retained > 0);
+
+            for (const auto& [name, sample] : {std::pair("lex", lex), std::pair("parse", parse),
+                     std::pair("symbol table", symbol_table)}) {
+                fmt::println("{:<14}{}", name,
+                    noctern::format_memory_sample(sample, source.size(), num_tokens));
+            }
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include "./arena.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <new>
+
+#include <sys/mman.h>
+
+namespace noctern {
+    namespace {
+        constexpr size_t huge_page_size = 2 * 1024 * 1024;
+        // Past this, growing the blocks further only wastes more of the last one.
+        constexpr size_t max_block_size = 64 * 1024 * 1024;
+
+        constexpr size_t round_up(size_t size, size_t alignment) {
+            return (size + alignment - 1) / alignment * alignment;
+        }
+
+        // Maps `size` bytes aligned to a huge page, or returns null.
+        void* map_huge_aligned(size_t size) {
+            // Over-map, then trim to the alignment.
+            const size_t mapped_size = size + huge_page_size;
+            void* mapped = ::mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (mapped == MAP_FAILED) return nullptr;
+
+            auto* const begin = static_cast<std::byte*>(mapped);
+            const auto address = reinterpret_cast<uintptr_t>(begin);
+            auto* const aligned = begin + (round_up(address, huge_page_size) - address);
+            if (aligned != begin) ::munmap(begin, aligned - begin);
+            auto* const end = aligned + size;
+            if (end != begin + mapped_size) ::munmap(end, begin + mapped_size - end);
+
+            // Only advice; the kernel may not have huge pages enabled.
+            ::madvise(aligned, size, MADV_HUGEPAGE);
+            return aligned;
+        }
+    }
+
+    arena::~arena() {
+        while (last_block_ != nullptr) {
+            block_header* const block = last_block_;
+            last_block_ = block->previous;
+            if (block->mapped) {
+                ::munmap(block, block->size);
+            } else {
+                ::operator delete(block, block->size);
+            }
+        }
+    }
+
+    void* arena::allocate_block(size_t size, size_t alignment) {
+        const size_t needed = sizeof(block_header) + alignment + size;
+        size_t block_size = std::max(next_block_size_, needed);
+        next_block_size_ = std::min(next_block_size_ * 2, max_block_size);
+
+        void* memory = nullptr;
+        bool mapped = false;
+        if (block_size >= huge_page_size) {
+            block_size = noctern::round_up(block_size, huge_page_size);
+            memory = noctern::map_huge_aligned(block_size);
+            mapped = memory != nullptr;
+        }
+        if (memory == nullptr) memory = ::operator new(block_size);
+
+        last_block_ = ::new (memory) block_header {
+            .previous = last_block_,
+            .size = block_size,
+            .mapped = mapped,
+        };
+        bytes_reserved_ += block_size;
+        ++num_blocks_;
+
+        next_ = static_cast<std::byte*>(memory) + sizeof(block_header);
+        end_ = static_cast<std::byte*>(memory) + block_size;
+
+        void* result = allocate(size, alignment);
+        assert(result != nullptr);
+        return result;
+    }
+}
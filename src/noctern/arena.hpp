@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace noctern {
+    // A bump allocator for data which all dies together, such as everything built while compiling
+    // one module.
+    //
+    // Allocating is a pointer increment, deallocating does nothing, and all the memory is freed at
+    // once when the arena is destroyed. Blocks double in size as the arena fills. Those of 2 MiB or
+    // more are mapped directly, aligned so that they can be backed by transparent huge pages.
+    //
+    // Not thread safe, and pinned in place, since allocators refer to it.
+    class arena {
+    public:
+        explicit arena(size_t first_block_size = 64 * 1024)
+            : next_block_size_(first_block_size) {
+        }
+
+        // Allocates out of `buffer` until it's used up, e.g. a buffer on the stack. The buffer is
+        // not owned.
+        explicit arena(std::span<std::byte> buffer)
+            : next_(buffer.data())
+            , end_(buffer.data() + buffer.size())
+            , next_block_size_(buffer.size() * 2) {
+        }
+
+        arena(const arena&) = delete;
+        arena& operator=(const arena&) = delete;
+
+        ~arena();
+
+        void* allocate(size_t size, size_t alignment) {
+            const auto next = reinterpret_cast<uintptr_t>(next_);
+            const uintptr_t aligned = (next + alignment - 1) & ~(uintptr_t(alignment) - 1);
+            if (aligned + size <= reinterpret_cast<uintptr_t>(end_)) [[likely]] {
+                next_ = reinterpret_cast<std::byte*>(aligned + size);
+                bytes_allocated_ += size;
+                ++num_allocations_;
+                return reinterpret_cast<void*>(aligned);
+            }
+            return allocate_block(size, alignment);
+        }
+
+        // The memory taken from the system so far, not counting any initial buffer.
+        size_t bytes_reserved() const {
+            return bytes_reserved_;
+        }
+
+        size_t num_blocks() const {
+            return num_blocks_;
+        }
+
+        // The bytes handed out so far, including any initial buffer. Since nothing is freed early,
+        // this is also the arena's live data, plus whatever its containers have outgrown. The
+        // difference between two points in time is what happened in between, e.g. one phase of a
+        // compilation.
+        size_t bytes_allocated() const {
+            return bytes_allocated_;
+        }
+
+        size_t num_allocations() const {
+            return num_allocations_;
+        }
+
+    private:
+        struct block_header {
+            block_header* previous;
+            size_t size;
+            bool mapped;
+        };
+
+        void* allocate_block(size_t size, size_t alignment);
+
+        std::byte* next_ = nullptr;
+        std::byte* end_ = nullptr;
+        block_header* last_block_ = nullptr;
+        size_t next_block_size_;
+
+        size_t bytes_reserved_ = 0;
+        size_t num_blocks_ = 0;
+        size_t bytes_allocated_ = 0;
+        size_t num_allocations_ = 0;
+    };
+
+    // Allocates from an `arena` if it's given one, or else from the heap, as does a default
+    // constructed allocator. Always uses the heap during constant evaluation.
+    //
+    // Copying a container gives the copy the heap, so that it can outlive the arena.
+    template <typename T>
+    class arena_allocator {
+    public:
+        using value_type = T;
+        using propagate_on_container_move_assignment = std::true_type;
+        using propagate_on_container_swap = std::true_type;
+
+        constexpr arena_allocator() = default;
+
+        explicit constexpr arena_allocator(noctern::arena* arena)
+            : arena_(arena) {
+        }
+
+        template <typename U>
+        constexpr arena_allocator(const arena_allocator<U>& other)
+            : arena_(other.arena()) {
+        }
+
+        constexpr T* allocate(size_t n) {
+            if consteval {
+                return std::allocator<T>().allocate(n);
+            } else {
+                if (arena_ == nullptr) return std::allocator<T>().allocate(n);
+                return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+            }
+        }
+
+        constexpr void deallocate(T* ptr, size_t n) {
+            if consteval {
+                std::allocator<T>().deallocate(ptr, n);
+            } else {
+                if (arena_ == nullptr) std::allocator<T>().deallocate(ptr, n);
+            }
+        }
+
+        constexpr arena_allocator select_on_container_copy_construction() const {
+            return arena_allocator();
+        }
+
+        constexpr noctern::arena* arena() const {
+            return arena_;
+        }
+
+        template <typename U>
+        constexpr bool operator==(const arena_allocator<U>& rhs) const {
+            return arena_ == rhs.arena();
+        }
+
+    private:
+        noctern::arena* arena_ = nullptr;
+    };
+
+    template <typename T>
+    using arena_vector = std::vector<T, arena_allocator<T>>;
+}
@@ -0,0 +1,95 @@
+#include "./arena.hpp"
+
+#include <array>
+#include <catch2/catch.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "noctern/compilation_unit.hpp"
+#include "noctern/parser.hpp"
+#include "noctern/symbol_table.hpp"
+#include "noctern/tokenize.hpp"
+
+namespace noctern {
+    namespace {
+        bool is_aligned(void* ptr, size_t alignment) {
+            return reinterpret_cast<uintptr_t>(ptr) % alignment == 0;
+        }
+
+        TEST_CASE("arena allocates aligned, disjoint memory") {
+            arena arena(256);
+
+            auto* const a = static_cast<std::byte*>(arena.allocate(3, 1));
+            auto* const b = static_cast<std::byte*>(arena.allocate(16, 16));
+            CHECK(is_aligned(b, 16));
+            CHECK(b >= a + 3);
+            CHECK(arena.num_blocks() == 1);
+
+            // Bigger than the next block would have been, and big enough to be mapped.
+            auto* const big = static_cast<std::byte*>(arena.allocate(3 * 1024 * 1024, 64));
+            CHECK(is_aligned(big, 64));
+            std::memset(big, 0xAB, 3 * 1024 * 1024);
+            CHECK(arena.num_blocks() == 2);
+            CHECK(arena.bytes_reserved() >= 3 * 1024 * 1024);
+
+            // The rest of the big block is used before another is needed.
+            arena.allocate(1024, 8);
+            CHECK(arena.num_blocks() == 2);
+        }
+
+        TEST_CASE("arena counts what it hands out") {
+            alignas(16) std::array<std::byte, 64> buffer;
+            arena arena(buffer);
+
+            arena.allocate(24, 8);
+            CHECK(arena.bytes_allocated() == 24);
+            // From a new block.
+            arena.allocate(100, 8);
+            CHECK(arena.bytes_allocated() == 124);
+            CHECK(arena.num_allocations() == 2);
+        }
+
+        TEST_CASE("arena uses an initial buffer first") {
+            alignas(16) std::array<std::byte, 64> buffer;
+            arena arena(buffer);
+
+            void* const first = arena.allocate(32, 16);
+            CHECK(first == buffer.data());
+            CHECK(arena.num_blocks() == 0);
+
+            arena.allocate(64, 8);
+            CHECK(arena.num_blocks() == 1);
+        }
+
+        TEST_CASE("copies of arena containers don't refer to the arena") {
+            arena arena;
+            arena_vector<int> in_arena({1, 2, 3}, arena_allocator<int>(&arena));
+            CHECK(in_arena.get_allocator().arena() == &arena);
+
+            const arena_vector<int> copy = in_arena;
+            CHECK(copy.get_allocator().arena() == nullptr);
+            CHECK(copy == in_arena);
+
+            // Moving keeps the allocator along with the memory.
+            const arena_vector<int> moved = std::move(in_arena);
+            CHECK(moved.get_allocator().arena() == &arena);
+        }
+
+        TEST_CASE("a compilation allocates from the arena its tokens were given") {
+            arena arena;
+            const tokens parsed = noctern::parse(noctern::tokenize_all(R"(
+                def f(x): { let y = x * 2; return y + 1; };
+                def g(): 4;
+            )", &arena));
+            const compilation_unit unit(parsed);
+            const symbol_table symbols(parsed, unit);
+
+            CHECK(parsed.allocator().arena() == &arena);
+            CHECK(symbols.find_fn_decl("f").has_value());
+            CHECK(symbols.find_fn_decl("g").has_value());
+            CHECK(!symbols.find_fn_decl("h").has_value());
+            CHECK(arena.num_blocks() == 1);
+        }
+    }
+}
@@ -0,0 +1,238 @@
+#include "./batch.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <iterator>
+#include <string_view>
+
+#include <fmt/format.h>
+
+namespace noctern {
+    // Binary columns are mapped and used in place, which needs the host to agree on the layout.
+    static_assert(std::endian::native == std::endian::little);
+
+    namespace {
+        // Large enough to amortize dispatch per operation, small enough that the frame of a
+        // typical function stays in cache.
+        constexpr size_t block_rows = 1024;
+
+        constexpr size_t csv_chunk_size = 1 << 20;
+
+        std::string_view trim(std::string_view value) {
+            while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+                value.remove_prefix(1);
+            }
+            while (!value.empty()
+                && (value.back() == ' ' || value.back() == '\t' || value.back() == '\r')) {
+                value.remove_suffix(1);
+            }
+            return value;
+        }
+
+        bool parse_double(std::string_view text, double& out) {
+            auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), out);
+            return ec == std::errc {} && ptr == text.data() + text.size();
+        }
+
+        bool is_header(std::string_view line) {
+            double value;
+            return !noctern::parse_double(
+                noctern::trim(line.substr(0, std::min(line.find(','), line.size()))), value);
+        }
+
+        std::string io_error(std::string_view what) {
+            return fmt::format("{}: {}", what, std::strerror(errno));
+        }
+    }
+
+    csv_input::csv_input(std::FILE* file, size_t num_columns)
+        : file_(file)
+        , num_columns_(num_columns)
+        , buffer_(csv_chunk_size)
+        , columns_(num_columns) {
+    }
+
+    std::expected<bool, std::string> csv_input::refill() {
+        if (at_eof_) return false;
+
+        // Keep the partial line at the front, growing the buffer if it's a very long line.
+        std::copy(buffer_.begin() + begin_, buffer_.begin() + end_, buffer_.begin());
+        end_ -= begin_;
+        begin_ = 0;
+        if (end_ == buffer_.size()) buffer_.resize(buffer_.size() * 2);
+
+        const size_t count = std::fread(buffer_.data() + end_, 1, buffer_.size() - end_, file_);
+        if (count == 0) {
+            if (std::ferror(file_) != 0) return std::unexpected(noctern::io_error("fread failed"));
+            at_eof_ = true;
+            return false;
+        }
+        end_ += count;
+        return true;
+    }
+
+    std::expected<void, std::string> csv_input::parse_line(std::string_view line, size_t row) {
+        size_t column = 0;
+        while (true) {
+            const size_t comma = std::min(line.find(','), line.size());
+            const std::string_view field = noctern::trim(line.substr(0, comma));
+
+            if (column == num_columns_) {
+                return std::unexpected(fmt::format(
+                    "line {}: expected {} fields, but found more", line_number_, num_columns_));
+            }
+            double value;
+            if (!noctern::parse_double(field, value)) {
+                return std::unexpected(
+                    fmt::format("line {}: `{}` is not a number", line_number_, field));
+            }
+            columns_[column][row] = value;
+            ++column;
+
+            if (comma == line.size()) break;
+            line.remove_prefix(comma + 1);
+        }
+
+        if (column != num_columns_) {
+            return std::unexpected(fmt::format(
+                "line {}: expected {} fields, but found {}", line_number_, num_columns_, column));
+        }
+        return {};
+    }
+
+    std::expected<size_t, std::string> csv_input::next_block(
+        size_t max_rows, std::span<const double*> columns) {
+        assert(columns.size() == num_columns_);
+        for (std::vector<double>& column : columns_) {
+            column.resize(max_rows);
+        }
+
+        size_t row = 0;
+        while (row < max_rows) {
+            const auto begin = buffer_.begin() + begin_;
+            const auto end = buffer_.begin() + end_;
+            auto newline = std::find(begin, end, '\n');
+
+            if (newline == end && !at_eof_) {
+                auto refilled = refill();
+                if (!refilled.has_value()) return std::unexpected(std::move(refilled.error()));
+                continue;
+            }
+            if (begin == end) break;
+
+            const std::string_view line(&*begin, static_cast<size_t>(newline - begin));
+            begin_ += line.size() + (newline == end ? 0 : 1);
+            ++line_number_;
+            if (noctern::trim(line).empty()) continue;
+            if (line_number_ == 1 && noctern::is_header(line)) continue;
+
+            auto parsed = parse_line(line, row);
+            if (!parsed.has_value()) return std::unexpected(std::move(parsed.error()));
+            ++row;
+        }
+
+        for (size_t i = 0; i < num_columns_; ++i) {
+            columns[i] = columns_[i].data();
+        }
+        return row;
+    }
+
+    std::expected<column_input, std::string> column_input::open(
+        std::span<const std::string> paths) {
+        std::vector<source_file> files;
+        size_t num_bytes = 0;
+        for (const std::string& path : paths) {
+            auto file = source_file::open(path.c_str());
+            if (!file.has_value()) {
+                return std::unexpected(
+                    fmt::format("Couldn't read {}: {}", path, file.error().message()));
+            }
+
+            const size_t size = file->contents().size();
+            if (size % sizeof(double) != 0) {
+                return std::unexpected(
+                    fmt::format("{} is not a column of doubles: it has {} bytes", path, size));
+            }
+            if (!files.empty() && size != num_bytes) {
+                return std::unexpected(fmt::format("{} has {} rows, but {} has {}", path,
+                    size / sizeof(double), paths[0], num_bytes / sizeof(double)));
+            }
+            num_bytes = size;
+            files.push_back(std::move(*file));
+        }
+
+        return column_input(std::move(files), num_bytes / sizeof(double));
+    }
+
+    std::expected<size_t, std::string> column_input::next_block(
+        size_t max_rows, std::span<const double*> columns) {
+        assert(columns.size() == files_.size());
+
+        const size_t num_rows = std::min(max_rows, num_rows_ - next_row_);
+        for (size_t i = 0; i < files_.size(); ++i) {
+            // The previous block is done with.
+            files_[i].release_before(next_row_ * sizeof(double));
+            // Mappings are page aligned, and buffers come from `operator new`, so the doubles are
+            // suitably aligned.
+            columns[i] = reinterpret_cast<const double*>(files_[i].contents().data()) + next_row_;
+        }
+        next_row_ += num_rows;
+        return num_rows;
+    }
+
+    std::expected<void, std::string> csv_output::write(std::span<const double> results) {
+        for (double result : results) {
+            fmt::format_to(std::back_inserter(buffer_), "{}\n", result);
+        }
+        if (buffer_.size() >= csv_chunk_size) return flush();
+        return {};
+    }
+
+    std::expected<void, std::string> csv_output::flush() {
+        const size_t count = std::fwrite(buffer_.data(), 1, buffer_.size(), file_);
+        const bool failed = count != buffer_.size();
+        buffer_.clear();
+        if (failed) return std::unexpected(noctern::io_error("fwrite failed"));
+        if (std::fflush(file_) != 0) return std::unexpected(noctern::io_error("fflush failed"));
+        return {};
+    }
+
+    std::expected<void, std::string> column_output::write(std::span<const double> results) {
+        if (std::fwrite(results.data(), sizeof(double), results.size(), file_) != results.size()) {
+            return std::unexpected(noctern::io_error("fwrite failed"));
+        }
+        return {};
+    }
+
+    std::expected<void, std::string> column_output::flush() {
+        if (std::fflush(file_) != 0) return std::unexpected(noctern::io_error("fflush failed"));
+        return {};
+    }
+
+    std::expected<size_t, std::string> apply(
+        const compiled_fn& fn, batch_input& input, batch_output& output) {
+        std::vector<const double*> columns(fn.num_params());
+        std::vector<double> frame(fn.frame_size() * block_rows);
+        std::vector<double> results(block_rows);
+
+        size_t total_rows = 0;
+        while (true) {
+            auto num_rows = input.next_block(block_rows, columns);
+            if (!num_rows.has_value()) return std::unexpected(std::move(num_rows.error()));
+            if (*num_rows == 0) break;
+
+            fn.call_block(columns, *num_rows, frame, results.data());
+            auto written = output.write(std::span(results).first(*num_rows));
+            if (!written.has_value()) return std::unexpected(std::move(written.error()));
+            total_rows += *num_rows;
+        }
+
+        auto flushed = output.flush();
+        if (!flushed.has_value()) return std::unexpected(std::move(flushed.error()));
+        return total_rows;
+    }
+}
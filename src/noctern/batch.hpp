@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdio>
+#include <expected>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "noctern/compiled_fn.hpp"
+#include "noctern/source_file.hpp"
+
+// Evaluating a function over many rows of arguments, streaming them from and to files.
+//
+// Inputs are read and outputs written a block at a time, so memory use doesn't depend on the
+// number of rows.
+namespace noctern {
+    // Where `apply` reads its argument rows from.
+    class batch_input {
+    public:
+        virtual ~batch_input() = default;
+
+        // Reads the next block of at most `max_rows` rows. `columns[i]` is set to point at the
+        // block's values of parameter `i`, which stay valid until the next call.
+        //
+        // Returns the number of rows read, which is only 0 at the end of the input.
+        virtual std::expected<size_t, std::string> next_block(
+            size_t max_rows, std::span<const double*> columns)
+            = 0;
+    };
+
+    // Where `apply` writes its results to.
+    class batch_output {
+    public:
+        virtual ~batch_output() = default;
+
+        virtual std::expected<void, std::string> write(std::span<const double> results) = 0;
+
+        // Writes out anything still buffered.
+        virtual std::expected<void, std::string> flush() = 0;
+    };
+
+    // Rows of comma-separated numbers, one field per parameter, read from `file` in chunks.
+    //
+    // A first line which doesn't start with a number is taken to be a header and skipped. Blank
+    // lines are ignored.
+    class csv_input final : public batch_input {
+    public:
+        // Does not take ownership of `file`.
+        csv_input(std::FILE* file, size_t num_columns);
+
+        std::expected<size_t, std::string> next_block(
+            size_t max_rows, std::span<const double*> columns) override;
+
+    private:
+        // Reads more input, keeping the unparsed part. Returns false at the end of the input.
+        std::expected<bool, std::string> refill();
+
+        std::expected<void, std::string> parse_line(std::string_view line, size_t row);
+
+        std::FILE* file_;
+        size_t num_columns_;
+
+        std::vector<char> buffer_;
+        // The unparsed input is `buffer_[begin_, end_)`.
+        size_t begin_ = 0;
+        size_t end_ = 0;
+        bool at_eof_ = false;
+        size_t line_number_ = 0;
+
+        std::vector<std::vector<double>> columns_;
+    };
+
+    // One file per parameter, each holding the parameter's values as raw little-endian doubles.
+    //
+    // The files are memory mapped, so a block is handed out without copying. Pages are released
+    // once read.
+    class column_input final : public batch_input {
+    public:
+        static std::expected<column_input, std::string> open(std::span<const std::string> paths);
+
+        std::expected<size_t, std::string> next_block(
+            size_t max_rows, std::span<const double*> columns) override;
+
+    private:
+        explicit column_input(std::vector<source_file> files, size_t num_rows)
+            : files_(std::move(files))
+            , num_rows_(num_rows) {
+        }
+
+        std::vector<source_file> files_;
+        size_t num_rows_;
+        size_t next_row_ = 0;
+    };
+
+    // One result per line, in the shortest form which reads back as the same double.
+    class csv_output final : public batch_output {
+    public:
+        // Does not take ownership of `file`.
+        explicit csv_output(std::FILE* file)
+            : file_(file) {
+        }
+
+        std::expected<void, std::string> write(std::span<const double> results) override;
+        std::expected<void, std::string> flush() override;
+
+    private:
+        std::FILE* file_;
+        std::string buffer_;
+    };
+
+    // The results as raw little-endian doubles.
+    class column_output final : public batch_output {
+    public:
+        // Does not take ownership of `file`.
+        explicit column_output(std::FILE* file)
+            : file_(file) {
+        }
+
+        std::expected<void, std::string> write(std::span<const double> results) override;
+        std::expected<void, std::string> flush() override;
+
+    private:
+        std::FILE* file_;
+    };
+
+    // Evaluates `fn` on each row of `input`, writing the results to `output` in order.
+    //
+    // `input` must have one column per parameter of `fn`. Returns the number of rows.
+    std::expected<size_t, std::string> apply(
+        const compiled_fn& fn, batch_input& input, batch_output& output);
+}
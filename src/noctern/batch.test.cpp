@@ -0,0 +1,169 @@
+#include "./batch.hpp"
+
+#include <catch2/catch.hpp>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "noctern/compiled_fn.hpp"
+#include "noctern/ir.hpp"
+#include "noctern/parser.hpp"
+#include "noctern/temp_dir.test.hpp"
+#include "noctern/tokenize.hpp"
+
+namespace noctern {
+    namespace {
+        compiled_fn compile(std::string_view source) {
+            return noctern::lower(
+                ir::build(noctern::parse(noctern::tokenize_all(source))).functions[0]);
+        }
+
+        // A temporary file holding `contents`, positioned at its start.
+        std::FILE* temp_file(std::string_view contents) {
+            std::FILE* file = std::tmpfile();
+            REQUIRE(file != nullptr);
+            std::fwrite(contents.data(), 1, contents.size(), file);
+            std::rewind(file);
+            return file;
+        }
+
+        std::string read_all(std::FILE* file) {
+            std::rewind(file);
+            std::string result;
+            char chunk[4096];
+            while (size_t count = std::fread(chunk, 1, sizeof(chunk), file)) {
+                result.append(chunk, count);
+            }
+            return result;
+        }
+
+        TEST_CASE("apply over csv") {
+            const compiled_fn fn = noctern::compile("def f(x, y): x * y + 1;");
+
+            std::FILE* in = noctern::temp_file("x, y\r\n1, 2\r\n\r\n-0.5,4\n3,0.25");
+            std::FILE* out = std::tmpfile();
+            csv_input input(in, 2);
+            csv_output output(out);
+
+            auto rows = noctern::apply(fn, input, output);
+            REQUIRE(rows.has_value());
+            CHECK(*rows == 3);
+            CHECK(noctern::read_all(out) == "3\n-1\n1.75\n");
+
+            std::fclose(in);
+            std::fclose(out);
+        }
+
+        TEST_CASE("apply streams many csv rows") {
+            const compiled_fn fn = noctern::compile("def f(x): x * 2;");
+
+            // Several read chunks and blocks, with lines split between chunks.
+            constexpr int num_rows = 200'000;
+            std::string contents;
+            std::string expected;
+            for (int i = 0; i < num_rows; ++i) {
+                contents += fmt::format("{}.5\n", i);
+                expected += fmt::format("{}\n", i * 2 + 1);
+            }
+
+            std::FILE* in = noctern::temp_file(contents);
+            std::FILE* out = std::tmpfile();
+            csv_input input(in, 1);
+            csv_output output(out);
+
+            auto rows = noctern::apply(fn, input, output);
+            REQUIRE(rows.has_value());
+            CHECK(*rows == num_rows);
+            CHECK(noctern::read_all(out) == expected);
+
+            std::fclose(in);
+            std::fclose(out);
+        }
+
+        TEST_CASE("csv_input reports bad rows") {
+            const compiled_fn fn = noctern::compile("def f(x, y): x * y;");
+
+            const auto error = [&](std::string_view contents) {
+                std::FILE* in = noctern::temp_file(contents);
+                std::FILE* out = std::tmpfile();
+                csv_input input(in, 2);
+                csv_output output(out);
+                auto rows = noctern::apply(fn, input, output);
+                std::fclose(in);
+                std::fclose(out);
+                return rows.has_value() ? std::string() : rows.error();
+            };
+
+            CHECK(error("1,2\n3\n") == "line 2: expected 2 fields, but found 1");
+            CHECK(error("1,2\n3,4,5\n") == "line 2: expected 2 fields, but found more");
+            CHECK(error("1,2\n3,four\n") == "line 2: `four` is not a number");
+        }
+
+        TEST_CASE("apply over binary columns") {
+            const compiled_fn fn = noctern::compile("def f(x, y): x - y;");
+
+            const temp_dir dir;
+            const std::vector<std::string> paths = {
+                (dir / "x.f64").string(),
+                (dir / "y.f64").string(),
+            };
+
+            // More than one block.
+            constexpr size_t num_rows = 3000;
+            std::vector<double> xs;
+            std::vector<double> ys;
+            for (size_t row = 0; row < num_rows; ++row) {
+                xs.push_back(static_cast<double>(row) * 1.5);
+                ys.push_back(static_cast<double>(row));
+            }
+            for (size_t i = 0; i < paths.size(); ++i) {
+                std::FILE* file = std::fopen(paths[i].c_str(), "wb");
+                REQUIRE(file != nullptr);
+                std::fwrite((i == 0 ? xs : ys).data(), sizeof(double), num_rows, file);
+                std::fclose(file);
+            }
+
+            auto input = column_input::open(paths);
+            REQUIRE(input.has_value());
+            std::FILE* out = std::tmpfile();
+            column_output output(out);
+
+            auto rows = noctern::apply(fn, *input, output);
+            REQUIRE(rows.has_value());
+            CHECK(*rows == num_rows);
+
+            const std::string written = noctern::read_all(out);
+            REQUIRE(written.size() == num_rows * sizeof(double));
+            std::vector<double> results(num_rows);
+            std::memcpy(results.data(), written.data(), written.size());
+            for (size_t row = 0; row < num_rows; ++row) {
+                CHECK(results[row] == xs[row] - ys[row]);
+            }
+
+            std::fclose(out);
+        }
+
+        TEST_CASE("column_input rejects mismatched columns") {
+            const temp_dir dir;
+            const std::vector<std::string> paths = {
+                (dir / "a.f64").string(),
+                (dir / "b.f64").string(),
+            };
+            const double values[] = {1, 2, 3};
+            for (size_t i = 0; i < paths.size(); ++i) {
+                std::FILE* file = std::fopen(paths[i].c_str(), "wb");
+                REQUIRE(file != nullptr);
+                std::fwrite(values, sizeof(double), i + 2, file);
+                std::fclose(file);
+            }
+
+            auto input = column_input::open(paths);
+            REQUIRE_FALSE(input.has_value());
+            CHECK(input.error() == fmt::format("{} has 3 rows, but {} has 2", paths[1], paths[0]));
+        }
+    }
+}
@@ -1,20 +1,32 @@
 #pragma once
 
+#include <cstddef>
 #include <span>
-#include <vector>
 
+#include "noctern/arena.hpp"
 #include "noctern/tokenize.hpp"
 
 namespace noctern {
     class compilation_unit {
     public:
-        explicit compilation_unit(const tokens& input);
+        // Allocates from the same arena as `input`.
+        explicit constexpr compilation_unit(const tokens& input)
+            : fn_defs_(input.allocator()) {
+            for (token t : input) {
+                if (input.id(t) == token_id::fn_intro) fn_defs_.push_back(t);
+            }
+        }
 
-        std::span<const token> fn_defs() const {
+        constexpr std::span<const token> fn_defs() const {
             return fn_defs_;
         }
 
+        // The bytes allocated, not counting the tokens.
+        constexpr size_t memory_usage() const {
+            return fn_defs_.capacity() * sizeof(token);
+        }
+
     private:
-        std::vector<token> fn_defs_;
+        arena_vector<token> fn_defs_;
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,58 @@
+#include "./compile_cache.hpp"
+
+#include <catch2/catch.hpp>
+#include <filesystem>
+#include <optional>
+#include <string>
+
+#include <fmt/format.h>
+
+#include "noctern/compilation_unit.hpp"
+#include "noctern/parser.hpp"
+#include "noctern/symbol_table.hpp"
+#include "noctern/tokenize.hpp"
+#include "noctern/value_numbering.hpp"
+
+namespace noctern {
+    namespace {
+        std::string generated_module(int num_fns) {
+            std::string source;
+            for (int i = 0; i < num_fns; ++i) {
+                source += fmt::format(
+                    "def f{}(x, y): {{ let a = x * {}; let b = a - y / 3; return a + b * 2; }};\n",
+                    i, i);
+            }
+            return source;
+        }
+
+        // What a hit saves: the front end and the symbol table, against reading them back.
+        TEST_CASE("compile_cache hit against compiling", "[benchmark]") {
+            const int num_fns = GENERATE(100, 10000, 100000);
+            const std::string source = noctern::generated_module(num_fns);
+
+            const std::filesystem::path dir
+                = std::filesystem::temp_directory_path() / "noctern.compile_cache.bench";
+            std::filesystem::remove_all(dir);
+            const compile_cache cache(dir);
+            {
+                const tokens compiled = noctern::eliminate_common_subexpressions(
+                    noctern::parse(noctern::tokenize_all(source)));
+                REQUIRE(cache.store(
+                    source, compiled, symbol_table(compiled, compilation_unit(compiled))));
+            }
+
+            BENCHMARK(fmt::format("compile, {} functions", num_fns)) {
+                const tokens compiled = noctern::eliminate_common_subexpressions(
+                    noctern::parse(noctern::tokenize_all(source)));
+                return symbol_table(compiled, compilation_unit(compiled)).memory_usage();
+            };
+
+            BENCHMARK(fmt::format("load from the cache, {} functions", num_fns)) {
+                std::optional<cached_module> cached = cache.load(source);
+                return cached->symbols().memory_usage();
+            };
+
+            std::filesystem::remove_all(dir);
+        }
+    }
+}
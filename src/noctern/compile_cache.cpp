@@ -0,0 +1,429 @@
+#include "./compile_cache.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <span>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include <elf.h>
+#include <link.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace noctern {
+    namespace {
+        // Bump whenever the layout changes. Changes to what the front end produces for the same
+        // source are caught by the build ID in the key.
+        constexpr uint32_t format_version = 3;
+
+        constexpr std::array<char, 8> magic = {'N', 'C', 'T', 'C', 'A', 'C', 'H', 'E'};
+
+        // An entry is laid out as:
+        //
+        //     entry_header
+        //     string_ref     refs[num_tokens]
+        //     function_entry functions[num_functions]
+        //     uint32_t       displacements[num_displacements]
+        //     uint32_t       overflow[num_overflow]
+        //     token_id       ids[num_tokens]
+        //     char           strings[strings_size]
+        //
+        // `functions` and the two tables after it are the built `symbol_table`, so that a hit
+        // doesn't build its perfect hash again: `functions[i]` is the function at index `i`.
+        //
+        // Each array starts suitably aligned for its elements, so nothing needs padding.
+        struct entry_header {
+            std::array<char, 8> magic;
+            uint32_t format_version;
+            uint32_t num_tokens;
+            uint32_t num_functions;
+            uint32_t strings_size;
+            uint64_t source_size;
+            std::array<uint64_t, 2> key;
+            // The symbol table's `perfect_hash`.
+            uint64_t hash_seed;
+            uint32_t num_displacements;
+            uint32_t num_overflow;
+            // The `entry_checksum` of everything else.
+            uint64_t checksum;
+        };
+
+        // A range of `strings`.
+        struct string_ref {
+            uint32_t offset;
+            uint32_t size;
+        };
+
+        struct function_entry {
+            string_ref name;
+            // The token which `symbol_table` indexes the function by.
+            uint32_t token;
+        };
+
+        static_assert(sizeof(entry_header) % alignof(string_ref) == 0);
+        static_assert(sizeof(string_ref) % alignof(function_entry) == 0);
+        static_assert(sizeof(function_entry) % alignof(uint32_t) == 0);
+        static_assert(sizeof(token_id) == 1);
+
+        size_t entry_size(const entry_header& header) {
+            return sizeof(entry_header) + size_t {header.num_tokens} * sizeof(string_ref)
+                + size_t {header.num_functions} * sizeof(function_entry)
+                + (size_t {header.num_displacements} + header.num_overflow) * sizeof(uint32_t)
+                + size_t {header.num_tokens} * sizeof(token_id) + header.strings_size;
+        }
+
+        __extension__ typedef unsigned __int128 uint128;
+
+        constexpr uint128 make_uint128(uint64_t high, uint64_t low) {
+            return (static_cast<uint128>(high) << 64) | low;
+        }
+
+        // FNV-1a, 128 bits wide so that collisions between sources aren't a practical concern.
+        class fnv1a_128 {
+        public:
+            void update(std::string_view bytes) {
+                for (char c : bytes) {
+                    state_ ^= static_cast<unsigned char>(c);
+                    state_ *= prime;
+                }
+            }
+
+            std::array<uint64_t, 2> digest() const {
+                return {static_cast<uint64_t>(state_ >> 64), static_cast<uint64_t>(state_)};
+            }
+
+        private:
+            static constexpr uint128 prime
+                = noctern::make_uint128(0x0000000001000000, 0x000000000000013B);
+            uint128 state_ = noctern::make_uint128(0x6C62272E07BB0142, 0x62B821756295C58D);
+        };
+
+        // A bijective mix, as `perfect_hash` uses.
+        constexpr uint64_t mix(uint64_t x) {
+            x ^= x >> 32;
+            x *= 0xD6E8FEB86659FD93;
+            x ^= x >> 32;
+            return x;
+        }
+
+        // A checksum of `bytes`, chained from `seed`, to catch entries which were damaged since
+        // they were written: the interpreter only asserts on bad tokens. A word at a time, since
+        // every hit checks all of its entry.
+        uint64_t checksum(std::string_view bytes, uint64_t seed) {
+            uint64_t state = seed ^ (bytes.size() * 0x9E3779B97F4A7C15);
+            for (; bytes.size() >= sizeof(uint64_t); bytes.remove_prefix(sizeof(uint64_t))) {
+                uint64_t word;
+                std::memcpy(&word, bytes.data(), sizeof(word));
+                state = noctern::mix(state ^ word) + 0x2545F4914F6CDD1D;
+            }
+            uint64_t tail = 0;
+            std::memcpy(&tail, bytes.data(), bytes.size());
+            return noctern::mix(state ^ tail);
+        }
+
+        template <typename T>
+        std::string_view as_bytes(std::span<const T> values) {
+            return std::string_view(
+                reinterpret_cast<const char*>(values.data()), values.size_bytes());
+        }
+
+        // Covers the header up to its checksum, and then each of the arrays after it.
+        uint64_t entry_checksum(
+            const entry_header& header, std::initializer_list<std::string_view> arrays) {
+            uint64_t result = noctern::checksum(
+                std::string_view(reinterpret_cast<const char*>(&header),
+                    offsetof(entry_header, checksum)),
+                0);
+            for (std::string_view array : arrays) {
+                result = noctern::checksum(array, result);
+            }
+            return result;
+        }
+
+        // The GNU build ID of the binary this is linked into, which changes with any change to the
+        // compiler. Empty where the linker didn't add one.
+        std::string_view build_id() {
+            static const std::string id = [] {
+                std::string result;
+                ::dl_iterate_phdr(
+                    [](dl_phdr_info* info, size_t, void* data) {
+                        const auto self = reinterpret_cast<ElfW(Addr)>(&noctern::build_id);
+                        const std::span phdrs(info->dlpi_phdr, info->dlpi_phnum);
+                        const bool contains_self
+                            = std::ranges::any_of(phdrs, [&](const ElfW(Phdr)& phdr) {
+                                  const ElfW(Addr) start = info->dlpi_addr + phdr.p_vaddr;
+                                  return phdr.p_type == PT_LOAD && start <= self
+                                      && self - start < phdr.p_memsz;
+                              });
+                        if (!contains_self) return 0;
+
+                        for (const ElfW(Phdr)& phdr : phdrs) {
+                            if (phdr.p_type != PT_NOTE) continue;
+                            const char* note
+                                = reinterpret_cast<const char*>(info->dlpi_addr + phdr.p_vaddr);
+                            const char* const end = note + phdr.p_memsz;
+                            // Each note's name and description are padded to 4 bytes.
+                            while (note + sizeof(ElfW(Nhdr)) <= end) {
+                                ElfW(Nhdr) header;
+                                std::memcpy(&header, note, sizeof(header));
+                                const char* name = note + sizeof(header);
+                                const char* desc = name + (header.n_namesz + 3) / 4 * 4;
+                                if (header.n_type == NT_GNU_BUILD_ID && header.n_namesz == 4
+                                    && std::memcmp(name, "GNU", 4) == 0) {
+                                    static_cast<std::string*>(data)->assign(desc, header.n_descsz);
+                                    return 1;
+                                }
+                                note = desc + (header.n_descsz + 3) / 4 * 4;
+                            }
+                        }
+                        return 1;
+                    },
+                    &result);
+                return result;
+            }();
+            return id;
+        }
+
+        std::array<uint64_t, 2> cache_key(std::string_view source) {
+            fnv1a_128 hash;
+            hash.update(NOCTERN_VERSION);
+            hash.update(std::string_view("\0", 1));
+            hash.update(noctern::build_id());
+            hash.update(std::string_view("\0", 1));
+            hash.update(std::string_view(
+                reinterpret_cast<const char*>(&format_version), sizeof(format_version)));
+            hash.update(source);
+            return hash.digest();
+        }
+
+        // Reads a `T` out of `bytes` at `offset`, which the layout guarantees is aligned.
+        template <typename T>
+        const T* view_at(std::string_view bytes, size_t offset) {
+            return reinterpret_cast<const T*>(bytes.data() + offset);
+        }
+
+        bool in_bounds(string_ref ref, uint32_t strings_size) {
+            return ref.offset <= strings_size && ref.size <= strings_size - ref.offset;
+        }
+
+        // Closes the file when leaving scope.
+        class file_closer {
+        public:
+            explicit file_closer(std::FILE* file)
+                : file_(file) {
+            }
+
+            file_closer(const file_closer&) = delete;
+            file_closer& operator=(const file_closer&) = delete;
+
+            ~file_closer() {
+                if (file_ != nullptr) std::fclose(file_);
+            }
+
+            // Closes the file now, returning whether everything was written.
+            bool close() {
+                return std::fclose(std::exchange(file_, nullptr)) == 0;
+            }
+
+        private:
+            std::FILE* file_;
+        };
+
+        template <typename T>
+        bool write_all(std::FILE* file, std::span<const T> values) {
+            return std::fwrite(values.data(), sizeof(T), values.size(), file) == values.size();
+        }
+    }
+
+    std::filesystem::path compile_cache::entry_path(std::string_view source) const {
+        const std::array<uint64_t, 2> key = noctern::cache_key(source);
+        return dir_ / fmt::format("{:016x}{:016x}.nctc", key[0], key[1]);
+    }
+
+    std::optional<cached_module> compile_cache::load(std::string_view source) const {
+        auto file = source_file::open(entry_path(source).c_str());
+        if (!file.has_value()) return std::nullopt;
+
+        const std::string_view bytes = file->contents();
+        entry_header header;
+        if (bytes.size() < sizeof(header)) return std::nullopt;
+        std::memcpy(&header, bytes.data(), sizeof(header));
+        if (header.magic != magic || header.format_version != format_version
+            || header.key != noctern::cache_key(source) || header.source_size != source.size()
+            || bytes.size() != noctern::entry_size(header)) {
+            return std::nullopt;
+        }
+
+        size_t offset = sizeof(header);
+        const auto* refs = noctern::view_at<string_ref>(bytes, offset);
+        offset += header.num_tokens * sizeof(string_ref);
+        const auto* functions = noctern::view_at<function_entry>(bytes, offset);
+        offset += header.num_functions * sizeof(function_entry);
+        const auto* displacements = noctern::view_at<uint32_t>(bytes, offset);
+        offset += header.num_displacements * sizeof(uint32_t);
+        const auto* overflow = noctern::view_at<uint32_t>(bytes, offset);
+        offset += header.num_overflow * sizeof(uint32_t);
+        const auto* ids = noctern::view_at<token_id>(bytes, offset);
+        offset += header.num_tokens * sizeof(token_id);
+        const std::string_view strings = bytes.substr(offset);
+
+        if (header.checksum
+            != noctern::entry_checksum(header,
+                {
+                    noctern::as_bytes(std::span(refs, header.num_tokens)),
+                    noctern::as_bytes(std::span(functions, header.num_functions)),
+                    noctern::as_bytes(std::span(displacements, header.num_displacements)),
+                    noctern::as_bytes(std::span(overflow, header.num_overflow)),
+                    noctern::as_bytes(std::span(ids, header.num_tokens)),
+                    strings,
+                })) {
+            return std::nullopt;
+        }
+
+        arena_vector<token_id> token_ids(ids, ids + header.num_tokens);
+        arena_vector<std::string_view> token_strs;
+        token_strs.reserve(header.num_tokens);
+        for (uint32_t i = 0; i < header.num_tokens; ++i) {
+            if (token_ids[i] >= token_id::empty_invalid) return std::nullopt;
+            if (!has_data(token_ids[i])) {
+                token_strs.push_back(spelling(token_ids[i]));
+                continue;
+            }
+            if (!noctern::in_bounds(refs[i], header.strings_size)) return std::nullopt;
+            token_strs.push_back(strings.substr(refs[i].offset, refs[i].size));
+        }
+
+        noctern::tokens tokens(strings, std::move(token_ids), std::move(token_strs));
+
+        std::optional<perfect_hash> hash = perfect_hash::restore(header.hash_seed,
+            header.num_functions, std::span(displacements, header.num_displacements),
+            std::span(overflow, header.num_overflow));
+        if (!hash.has_value()) return std::nullopt;
+
+        std::vector<symbol_table::fn_decl> fn_decls;
+        fn_decls.reserve(header.num_functions);
+        for (uint32_t i = 0; i < header.num_functions; ++i) {
+            const function_entry& fn = functions[i];
+            if (!noctern::in_bounds(fn.name, header.strings_size)
+                || fn.token >= header.num_tokens) {
+                return std::nullopt;
+            }
+            fn_decls.push_back(symbol_table::fn_decl {
+                .name = strings.substr(fn.name.offset, fn.name.size),
+                .decl = *(tokens.begin() + static_cast<token_index_t>(fn.token)),
+            });
+        }
+
+        return cached_module(
+            std::move(*file), std::move(tokens), symbol_table(std::move(*hash), fn_decls));
+    }
+
+    bool compile_cache::store(
+        std::string_view source, const tokens& compiled, const symbol_table& symbols) const {
+        if (compiled.num_tokens() > std::numeric_limits<uint32_t>::max()) return false;
+
+        std::vector<string_ref> refs;
+        std::vector<token_id> ids;
+        std::vector<function_entry> functions;
+        std::string strings;
+        refs.reserve(compiled.num_tokens());
+        ids.reserve(compiled.num_tokens());
+
+        const auto add_string = [&](std::string_view string) {
+            const string_ref ref {static_cast<uint32_t>(strings.size()),
+                static_cast<uint32_t>(string.size())};
+            strings += string;
+            return ref;
+        };
+
+        for (auto it = compiled.begin(); it != compiled.end(); ++it) {
+            const token_id id = compiled.id(*it);
+            ids.push_back(id);
+            refs.push_back(has_data(id) ? add_string(compiled.string(*it)) : string_ref {0, 0});
+        }
+        for (const symbol_table::fn_decl& fn : symbols.fn_decls()) {
+            functions.push_back(function_entry {
+                .name = add_string(fn.name),
+                .token = static_cast<uint32_t>(compiled.to_iterator(fn.decl) - compiled.begin()),
+            });
+        }
+        const std::span<const uint32_t> displacements = symbols.hash().displacements();
+        const std::span<const uint32_t> overflow = symbols.hash().overflow();
+        if (strings.size() > std::numeric_limits<uint32_t>::max()) return false;
+
+        entry_header header {
+            .magic = magic,
+            .format_version = format_version,
+            .num_tokens = static_cast<uint32_t>(ids.size()),
+            .num_functions = static_cast<uint32_t>(functions.size()),
+            .strings_size = static_cast<uint32_t>(strings.size()),
+            .source_size = source.size(),
+            .key = noctern::cache_key(source),
+            .hash_seed = symbols.hash().seed(),
+            .num_displacements = static_cast<uint32_t>(displacements.size()),
+            .num_overflow = static_cast<uint32_t>(overflow.size()),
+            .checksum = 0,
+        };
+        header.checksum = noctern::entry_checksum(header,
+            {
+                noctern::as_bytes(std::span<const string_ref>(refs)),
+                noctern::as_bytes(std::span<const function_entry>(functions)),
+                noctern::as_bytes(displacements),
+                noctern::as_bytes(overflow),
+                noctern::as_bytes(std::span<const token_id>(ids)),
+                strings,
+            });
+
+        std::error_code error;
+        std::filesystem::create_directories(dir_, error);
+        if (error) return false;
+
+        // Written under a unique name and renamed into place, so that a concurrent `load` never
+        // sees a partial entry. `mkstemp` makes the name unique across threads as well as
+        // processes, since `program::compile` stores from its workers.
+        const std::filesystem::path path = entry_path(source);
+        std::string temp_path = path.string() + ".XXXXXX";
+        const int fd = ::mkstemp(temp_path.data());
+        if (fd == -1) return false;
+        // `mkstemp` only lets the owner read it, unlike the entries other compilers write.
+        ::fchmod(fd, 0644);
+
+        std::FILE* file = ::fdopen(fd, "wb");
+        if (file == nullptr) {
+            ::close(fd);
+            std::filesystem::remove(temp_path, error);
+            return false;
+        }
+        file_closer closer(file);
+        const bool written = std::fwrite(&header, sizeof(header), 1, file) == 1
+            && noctern::write_all(file, std::span<const string_ref>(refs))
+            && noctern::write_all(file, std::span<const function_entry>(functions))
+            && noctern::write_all(file, displacements) && noctern::write_all(file, overflow)
+            && noctern::write_all(file, std::span<const token_id>(ids))
+            && std::fwrite(strings.data(), 1, strings.size(), file) == strings.size();
+        if (!closer.close() || !written) {
+            std::filesystem::remove(temp_path, error);
+            return false;
+        }
+
+        std::filesystem::rename(temp_path, path, error);
+        if (error) {
+            std::filesystem::remove(temp_path, error);
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "noctern/source_file.hpp"
+#include "noctern/symbol_table.hpp"
+#include "noctern/tokenize.hpp"
+
+namespace noctern {
+    // A module loaded from the compile cache.
+    //
+    // The tokens' strings and the function index are read out of the memory-mapped cache entry;
+    // nothing is tokenized or parsed, and the index's perfect hash isn't built again. Loading does
+    // copy the token ids, and makes a `string_view` for each token, in one pass over them.
+    class cached_module {
+    public:
+        const noctern::tokens& tokens() const {
+            return tokens_;
+        }
+
+        const symbol_table& symbols() const {
+            return symbols_;
+        }
+
+    private:
+        friend class compile_cache;
+
+        cached_module(source_file file, noctern::tokens tokens, symbol_table symbols)
+            : file_(std::move(file))
+            , tokens_(std::move(tokens))
+            , symbols_(std::move(symbols)) {
+        }
+
+        // Owns the memory which `tokens_` and `symbols_` refer into. Its contents don't move with
+        // the `source_file`.
+        source_file file_;
+        noctern::tokens tokens_;
+        symbol_table symbols_;
+    };
+
+    // An on-disk cache of front end results, i.e. the tokens after parsing and optimization.
+    //
+    // Entries are content addressed: they are named by a hash of the source together with the
+    // compiler version, the build ID of the binary and the cache format version, so a changed
+    // source or compiler simply misses. An entry holds the postfix token ids, the string data of
+    // the tokens which have it, and the built `symbol_table`. compile_cache.bench.cpp measures what
+    // a hit saves over compiling.
+    //
+    // The cache is best effort: anything unreadable or inconsistent is a miss, including an entry
+    // which fails its checksum, and failing to store an entry isn't an error. Entries are written atomically, so concurrent compilers can
+    // share a directory.
+    class compile_cache {
+    public:
+        explicit compile_cache(std::filesystem::path dir)
+            : dir_(std::move(dir)) {
+        }
+
+        std::optional<cached_module> load(std::string_view source) const;
+
+        // Stores `compiled`, the front end's result for `source`, and `symbols`, its symbol table.
+        // Returns whether it was stored.
+        bool store(
+            std::string_view source, const tokens& compiled, const symbol_table& symbols) const;
+
+        // Where the entry for `source` lives.
+        std::filesystem::path entry_path(std::string_view source) const;
+
+    private:
+        std::filesystem::path dir_;
+    };
+}
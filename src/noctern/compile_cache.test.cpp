@@ -0,0 +1,156 @@
+#include "./compile_cache.hpp"
+
+#include <atomic>
+#include <catch2/catch.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "noctern/compilation_unit.hpp"
+#include "noctern/interpreter.hpp"
+#include "noctern/parser.hpp"
+#include "noctern/temp_dir.test.hpp"
+#include "noctern/tokenize.test.hpp"
+#include "noctern/value_numbering.hpp"
+
+namespace noctern {
+    namespace {
+        constexpr std::string_view source = R"(
+            def Square(x): x * x;
+            def Main(): { let y = 1.5; let z = y + 2; return z * z - y; };
+        )";
+
+        tokens compile(std::string_view source) {
+            return noctern::eliminate_common_subexpressions(
+                noctern::parse(noctern::tokenize_all(source)));
+        }
+
+        bool store(const compile_cache& cache, std::string_view source, const tokens& compiled) {
+            return cache.store(
+                source, compiled, symbol_table(compiled, compilation_unit(compiled)));
+        }
+
+        double eval_main(const tokens& tokens, symbol_table symbols) {
+            std::optional<token> main = symbols.find_fn_decl("Main");
+            REQUIRE(main.has_value());
+            return interpreter(std::move(symbols)).eval_fn(tokens, *main, interpreter::frame {});
+        }
+
+        TEST_CASE("compile_cache round trips the front end's output") {
+            const temp_dir dir;
+            const compile_cache cache(dir.path());
+
+            CHECK_FALSE(cache.load(source).has_value());
+
+            const tokens compiled = noctern::compile(source);
+            REQUIRE(noctern::store(cache, source, compiled));
+            CHECK(std::filesystem::exists(cache.entry_path(source)));
+
+            std::optional<cached_module> cached = cache.load(source);
+            REQUIRE(cached.has_value());
+
+            const tokens& loaded = cached->tokens();
+            REQUIRE(loaded.num_tokens() == compiled.num_tokens());
+            for (auto lhs = compiled.begin(), rhs = loaded.begin(); lhs != compiled.end();
+                 ++lhs, ++rhs) {
+                CHECK(compiled.id(*lhs) == loaded.id(*rhs));
+                CHECK(compiled.string(*lhs) == loaded.string(*rhs));
+            }
+
+            CHECK(cached->symbols().find_fn_decl("Square").has_value());
+            CHECK_FALSE(cached->symbols().find_fn_decl("Missing").has_value());
+
+            const compilation_unit unit(compiled);
+            CHECK(noctern::eval_main(loaded, cached->symbols())
+                == noctern::eval_main(compiled, symbol_table(compiled, unit)));
+        }
+
+        TEST_CASE("compile_cache misses when the source changes") {
+            const temp_dir dir;
+            const compile_cache cache(dir.path());
+
+            REQUIRE(noctern::store(cache, source, noctern::compile(source)));
+
+            const std::string changed = std::string(source) + " ";
+            CHECK(cache.entry_path(changed) != cache.entry_path(source));
+            CHECK_FALSE(cache.load(changed).has_value());
+        }
+
+        TEST_CASE("compile_cache treats damaged entries as misses") {
+            const temp_dir dir;
+            const compile_cache cache(dir.path());
+            REQUIRE(noctern::store(cache, source, noctern::compile(source)));
+
+            const std::filesystem::path path = cache.entry_path(source);
+            SECTION("truncated") {
+                std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+            }
+            SECTION("wrong magic") {
+                std::FILE* file = std::fopen(path.c_str(), "r+b");
+                REQUIRE(file != nullptr);
+                std::fputc('X', file);
+                std::fclose(file);
+            }
+            SECTION("a changed byte") {
+                // E.g. one of the token ids, which the interpreter would trust.
+                const auto offset = static_cast<long>(
+                    GENERATE_COPY(std::filesystem::file_size(path) / 2,
+                        std::filesystem::file_size(path) - 1));
+                std::FILE* file = std::fopen(path.c_str(), "r+b");
+                REQUIRE(file != nullptr);
+                REQUIRE(std::fseek(file, offset, SEEK_SET) == 0);
+                const int byte = std::fgetc(file);
+                REQUIRE(std::fseek(file, offset, SEEK_SET) == 0);
+                std::fputc(byte ^ 1, file);
+                std::fclose(file);
+            }
+            SECTION("not an entry at all") {
+                std::FILE* file = std::fopen(path.c_str(), "wb");
+                REQUIRE(file != nullptr);
+                std::fputs("not a cache entry", file);
+                std::fclose(file);
+            }
+
+            CHECK_FALSE(cache.load(source).has_value());
+
+            // Storing again repairs the entry.
+            REQUIRE(noctern::store(cache, source, noctern::compile(source)));
+            CHECK(cache.load(source).has_value());
+        }
+
+        TEST_CASE("compile_cache stores the same entry from several threads") {
+            const temp_dir dir;
+            const compile_cache cache(dir.path());
+            const tokens compiled = noctern::compile(source);
+
+            // As `program::compile`'s workers do when several files share a source. Catch's
+            // assertions aren't thread safe, so the threads only count their failures.
+            std::atomic<int> failed_stores = 0;
+            std::vector<std::thread> threads;
+            for (int i = 0; i < 8; ++i) {
+                threads.emplace_back([&] {
+                    for (int j = 0; j < 20; ++j) {
+                        if (!noctern::store(cache, source, compiled)) ++failed_stores;
+                    }
+                });
+            }
+            for (std::thread& thread : threads) {
+                thread.join();
+            }
+            CHECK(failed_stores == 0);
+
+            std::optional<cached_module> cached = cache.load(source);
+            REQUIRE(cached.has_value());
+            CHECK(cached->tokens().num_tokens() == compiled.num_tokens());
+            // No temporary files are left behind.
+            CHECK(std::distance(std::filesystem::directory_iterator(dir.path()),
+                      std::filesystem::directory_iterator())
+                == 1);
+        }
+    }
+}
@@ -0,0 +1,191 @@
+#include "./compiled_fn.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+
+#include "noctern/enum.hpp"
+#include "noctern/ir.hpp"
+
+// Without hardware FMA, `std::fma` is a slow library call. Compile an FMA-capable clone of the
+// evaluation loop, selected at load time when the CPU supports it.
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define NOCTERN_FMA_CLONES [[gnu::target_clones("arch=haswell", "default")]]
+#else
+#define NOCTERN_FMA_CLONES
+#endif
+
+namespace noctern {
+    NOCTERN_FMA_CLONES
+    double compiled_fn::call(std::span<const double> args, std::span<double> frame) const {
+        assert(args.size() == static_cast<size_t>(num_params_));
+        assert(frame.size() >= frame_size_);
+
+        std::ranges::copy(args, frame.begin());
+        std::ranges::copy(constants_, frame.begin() + num_params_);
+
+        for (const operation& operation : operations_) {
+            const double lhs = frame[operation.lhs];
+            const double rhs = frame[operation.rhs];
+
+            frame[operation.dest] = enum_switch(
+                operation.op, [lhs, rhs, &frame, &operation]<ir::opcode op>(val_t<op>) -> double {
+                    if constexpr (op == ir::opcode::add) {
+                        return lhs + rhs;
+                    } else if constexpr (op == ir::opcode::sub) {
+                        return lhs - rhs;
+                    } else if constexpr (op == ir::opcode::mul) {
+                        return lhs * rhs;
+                    } else if constexpr (op == ir::opcode::div) {
+                        return lhs / rhs;
+                    } else if constexpr (op == ir::opcode::fma) {
+                        return std::fma(lhs, rhs, frame[operation.addend]);
+                    } else if constexpr (op == ir::opcode::fms) {
+                        return std::fma(lhs, rhs, -frame[operation.addend]);
+                    } else if constexpr (op == ir::opcode::fnma) {
+                        return std::fma(-lhs, rhs, frame[operation.addend]);
+                    } else {
+                        assert(false && "not an operation");
+                        return 0;
+                    }
+                });
+        }
+
+        return frame[result_slot_];
+    }
+
+    NOCTERN_FMA_CLONES
+    void compiled_fn::call_block(std::span<const double* const> args, size_t num_rows,
+        std::span<double> frame, double* results) const {
+        assert(args.size() == static_cast<size_t>(num_params_));
+        assert(frame.size() >= frame_size_ * num_rows);
+
+        // Slot `s` holds the block's values at `[s * num_rows, (s + 1) * num_rows)`.
+        const auto slot = [&](uint32_t s) { return frame.data() + s * num_rows; };
+
+        for (size_t i = 0; i < args.size(); ++i) {
+            std::copy_n(args[i], num_rows, slot(static_cast<uint32_t>(i)));
+        }
+        for (size_t i = 0; i < constants_.size(); ++i) {
+            std::fill_n(slot(static_cast<uint32_t>(num_params_ + i)), num_rows, constants_[i]);
+        }
+
+        for (const operation& operation : operations_) {
+            double* const dest = slot(operation.dest);
+            const double* const lhs = slot(operation.lhs);
+            const double* const rhs = slot(operation.rhs);
+            const double* const addend = slot(operation.addend);
+
+            enum_switch(operation.op, [&]<ir::opcode op>(val_t<op>) {
+                for (size_t row = 0; row < num_rows; ++row) {
+                    if constexpr (op == ir::opcode::add) {
+                        dest[row] = lhs[row] + rhs[row];
+                    } else if constexpr (op == ir::opcode::sub) {
+                        dest[row] = lhs[row] - rhs[row];
+                    } else if constexpr (op == ir::opcode::mul) {
+                        dest[row] = lhs[row] * rhs[row];
+                    } else if constexpr (op == ir::opcode::div) {
+                        dest[row] = lhs[row] / rhs[row];
+                    } else if constexpr (op == ir::opcode::fma) {
+                        dest[row] = std::fma(lhs[row], rhs[row], addend[row]);
+                    } else if constexpr (op == ir::opcode::fms) {
+                        dest[row] = std::fma(lhs[row], rhs[row], -addend[row]);
+                    } else if constexpr (op == ir::opcode::fnma) {
+                        dest[row] = std::fma(-lhs[row], rhs[row], addend[row]);
+                    } else {
+                        assert(false && "not an operation");
+                    }
+                }
+            });
+        }
+
+        std::copy_n(slot(result_slot_), num_rows, results);
+    }
+
+    double compiled_fn::call(std::span<const double> args) const {
+        constexpr size_t inline_frame_size = 64;
+        if (frame_size_ <= inline_frame_size) {
+            std::array<double, inline_frame_size> frame;
+            return call(args, frame);
+        }
+        std::vector<double> frame(frame_size_);
+        return call(args, frame);
+    }
+
+    compiled_fn lower(const ir::function& fn) {
+        using ir::opcode;
+        using ir::value_id;
+
+        const auto num_values = static_cast<value_id>(fn.instructions.size());
+
+        // The last instruction which reads each value. Dead values have no reader; the result is
+        // read "after" every instruction.
+        std::vector<value_id> last_use(num_values, -1);
+        last_use[fn.result] = num_values;
+        for (value_id id = num_values - 1; id >= 0; --id) {
+            const ir::instruction& inst = fn.instructions[id];
+            if (last_use[id] == -1) continue;
+            for (int i = 0; i < ir::num_operands(inst.op); ++i) {
+                last_use[inst.args[i]] = std::max(last_use[inst.args[i]], id);
+            }
+        }
+
+        compiled_fn result;
+        result.name_ = fn.name;
+        result.num_params_ = fn.num_params();
+        result.constants_ = fn.constants;
+
+        const auto first_temporary = static_cast<uint32_t>(fn.num_params() + fn.constants.size());
+        uint32_t next_slot = first_temporary;
+        std::vector<uint32_t> free_slots;
+        std::vector<uint32_t> slots(num_values);
+
+        for (value_id id = 0; id < num_values; ++id) {
+            const ir::instruction& inst = fn.instructions[id];
+            if (inst.op == opcode::param) {
+                slots[id] = static_cast<uint32_t>(inst.args[0]);
+                continue;
+            }
+            if (inst.op == opcode::constant) {
+                slots[id] = static_cast<uint32_t>(fn.num_params() + inst.args[0]);
+                continue;
+            }
+            if (last_use[id] == -1) continue;
+
+            // Operands read here for the last time can hand their slot to the result, since each
+            // operation reads all operands before writing.
+            const int num_operands = ir::num_operands(inst.op);
+            for (int i = 0; i < num_operands; ++i) {
+                const value_id arg = inst.args[i];
+                const ir::instruction& def = fn.instructions[arg];
+                const bool is_temporary = def.op != opcode::param && def.op != opcode::constant;
+                const bool already_freed
+                    = std::ranges::find(inst.args.begin(), inst.args.begin() + i, arg)
+                    != inst.args.begin() + i;
+                if (is_temporary && last_use[arg] == id && !already_freed) {
+                    free_slots.push_back(slots[arg]);
+                }
+            }
+
+            if (free_slots.empty()) {
+                slots[id] = next_slot++;
+            } else {
+                slots[id] = free_slots.back();
+                free_slots.pop_back();
+            }
+
+            result.operations_.push_back(compiled_fn::operation {
+                .op = inst.op,
+                .dest = slots[id],
+                .lhs = slots[inst.args[0]],
+                .rhs = slots[inst.args[1]],
+                .addend = num_operands == 3 ? slots[inst.args[2]] : 0,
+            });
+        }
+
+        result.result_slot_ = slots[fn.result];
+        result.frame_size_ = next_slot;
+        return result;
+    }
+}
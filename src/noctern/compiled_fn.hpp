@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "noctern/ir.hpp"
+
+namespace noctern {
+    // A function lowered from the IR into a compact register program, for fast repeated calls.
+    //
+    // The frame is laid out as `[parameters][constants][temporaries]`. Lowering drops dead
+    // instructions and reuses temporary slots once their value is no longer needed, so the frame is
+    // usually much smaller than the number of IR values.
+    class compiled_fn {
+    public:
+        struct operation {
+            ir::opcode op;
+            uint32_t dest;
+            uint32_t lhs;
+            uint32_t rhs;
+            // Only read by the fused multiply-add family.
+            uint32_t addend;
+        };
+
+        const std::string& name() const {
+            return name_;
+        }
+
+        int32_t num_params() const {
+            return num_params_;
+        }
+
+        size_t frame_size() const {
+            return frame_size_;
+        }
+
+        std::span<const operation> operations() const {
+            return operations_;
+        }
+
+        // The fast-call interface: evaluates the function without allocating.
+        //
+        // `args` must have `num_params()` elements, and `frame` at least `frame_size()` elements.
+        double call(std::span<const double> args, std::span<double> frame) const;
+
+        // Convenience overload which provides its own frame.
+        double call(std::span<const double> args) const;
+
+        // Evaluates the function on `num_rows` rows at once, running each operation over the whole
+        // block. This amortizes the dispatch on `op` and lets the loops vectorize.
+        //
+        // `args[i]` points at the `num_rows` values of parameter `i`. `frame` must have at least
+        // `frame_size() * num_rows` elements.
+        void call_block(std::span<const double* const> args, size_t num_rows,
+            std::span<double> frame, double* results) const;
+
+    private:
+        friend compiled_fn lower(const ir::function& fn);
+
+        std::string name_;
+        int32_t num_params_ = 0;
+        size_t frame_size_ = 0;
+        uint32_t result_slot_ = 0;
+
+        std::vector<double> constants_;
+        std::vector<operation> operations_;
+    };
+
+    // Lowers a verified IR function into its executable form.
+    compiled_fn lower(const ir::function& fn);
+}
@@ -0,0 +1,111 @@
+#include "./compiled_fn.hpp"
+
+#include <catch2/catch.hpp>
+#include <vector>
+
+#include "noctern/compilation_unit.hpp"
+#include "noctern/fast_math.hpp"
+#include "noctern/interpreter.hpp"
+#include "noctern/ir.hpp"
+#include "noctern/parser.hpp"
+#include "noctern/symbol_table.hpp"
+#include "noctern/tokenize.hpp"
+
+namespace noctern {
+    namespace {
+        TEST_CASE("lowered functions match the interpreter") {
+            noctern::tokens parsed = noctern::parse(noctern::tokenize_all(R"(
+                def silly_add(x, y): {
+                    let unused = x / y;
+                    let z = y - 0.2;
+                    return y + z  + x * 2. - 2 + .1;
+                };
+            )"));
+
+            noctern::compilation_unit cu(parsed);
+            noctern::symbol_table st(parsed, cu);
+            noctern::interpreter interpreter(st);
+
+            compiled_fn fn = noctern::lower(ir::build(parsed).functions[0]);
+            CHECK(fn.name() == "silly_add");
+            REQUIRE(fn.num_params() == 2);
+
+            for (double x : {42.3, -1.0, 0.0}) {
+                for (double y : {-2.9, 1e-3}) {
+                    double expected = interpreter.eval_fn(parsed, *st.find_fn_decl("silly_add"),
+                        noctern::interpreter::frame {
+                            .locals = {{"x", x}, {"y", y}},
+                            .expr_stack = {},
+                        });
+                    CHECK(fn.call(std::vector<double> {x, y}) == expected);
+                }
+            }
+        }
+
+        TEST_CASE("lowering drops dead code and reuses slots") {
+            noctern::tokens parsed = noctern::parse(noctern::tokenize_all(R"(
+                def f(x): {
+                    let dead = x * x * x;
+                    let a = x + 1;
+                    let b = a * a;
+                    let c = b * b;
+                    return c * c;
+                };
+            )"));
+            ir::function ir_fn = ir::build(parsed).functions[0];
+            compiled_fn fn = noctern::lower(ir_fn);
+
+            // One parameter, one constant, and each temporary can overwrite the previous one.
+            CHECK(fn.operations().size() == 4);
+            CHECK(fn.frame_size() == 3);
+
+            std::vector<double> frame(fn.frame_size());
+            double x = 0.5;
+            double a = x + 1;
+            double b = a * a;
+            double c = b * b;
+            CHECK(fn.call(std::vector<double> {x}, frame) == c * c);
+        }
+
+        TEST_CASE("call_block matches call row by row") {
+            const ir::module module = ir::build(noctern::parse(noctern::tokenize_all(R"(
+                def f(x, y): { let a = x * y + 1; return a * x - y / 3; };
+                def constant(x): 4;
+            )")));
+
+            // Contraction exercises the fused operations too.
+            const std::vector<ir::function> variants = {
+                module.functions[0],
+                noctern::optimize_math(module.functions[0], math_mode::contract),
+            };
+            for (const ir::function& ir_fn : variants) {
+                compiled_fn fn = noctern::lower(ir_fn);
+
+                constexpr size_t num_rows = 37;
+                std::vector<double> xs;
+                std::vector<double> ys;
+                for (size_t row = 0; row < num_rows; ++row) {
+                    xs.push_back(static_cast<double>(row) * 0.75 - 9);
+                    ys.push_back(1.0 / static_cast<double>(row + 1));
+                }
+
+                std::vector<double> frame(fn.frame_size() * num_rows);
+                std::vector<double> results(num_rows);
+                const double* const args[] = {xs.data(), ys.data()};
+                fn.call_block(args, num_rows, frame, results.data());
+
+                for (size_t row = 0; row < num_rows; ++row) {
+                    CHECK(results[row] == fn.call(std::vector<double> {xs[row], ys[row]}));
+                }
+            }
+
+            compiled_fn constant = noctern::lower(module.functions[1]);
+            std::vector<double> frame(constant.frame_size() * 3);
+            std::vector<double> results(3);
+            const double xs[] = {1, 2, 3};
+            const double* const args[] = {xs};
+            constant.call_block(args, 3, frame, results.data());
+            CHECK(results == std::vector<double> {4, 4, 4});
+        }
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+// Replaces the global `operator new` and `operator delete` to count allocations, so that tests
+// can check that hot paths don't allocate.
+//
+// Replacements must be defined once per program: include this in a single translation unit of a
+// test executable.
+
+namespace noctern::count_allocations_internal {
+    // Per thread, so that only the allocations of the code under test are counted.
+    inline thread_local size_t num_allocations = 0;
+
+    inline void* allocate(size_t size) {
+        ++num_allocations;
+        // `malloc(0)` may return null; `operator new` may not.
+        if (void* ptr = std::malloc(size == 0 ? 1 : size)) return ptr;
+        throw std::bad_alloc();
+    }
+
+    inline void* allocate(size_t size, std::align_val_t alignment) {
+        ++num_allocations;
+        const auto align = static_cast<size_t>(alignment);
+        // `aligned_alloc` needs a multiple of the alignment.
+        const size_t rounded = (size + align - 1) / align * align;
+        if (void* ptr = std::aligned_alloc(align, rounded == 0 ? align : rounded)) return ptr;
+        throw std::bad_alloc();
+    }
+}
+
+// The other forms (nothrow) are defined in terms of these.
+void* operator new(size_t size) {
+    return noctern::count_allocations_internal::allocate(size);
+}
+void* operator new[](size_t size) {
+    return noctern::count_allocations_internal::allocate(size);
+}
+void* operator new(size_t size, std::align_val_t alignment) {
+    return noctern::count_allocations_internal::allocate(size, alignment);
+}
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return noctern::count_allocations_internal::allocate(size, alignment);
+}
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+void operator delete(void* ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+void operator delete[](void* ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+void operator delete[](void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+namespace noctern {
+    // The number of heap allocations which `fn()` makes on this thread, e.g.:
+    //
+    //     CHECK(noctern::count_allocations([&] { table.find_fn_decl("f"); }) == 0);
+    template <typename Fn>
+    size_t count_allocations(Fn&& fn) {
+        const size_t before = count_allocations_internal::num_allocations;
+        std::forward<Fn>(fn)();
+        return count_allocations_internal::num_allocations - before;
+    }
+}
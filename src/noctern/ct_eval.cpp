@@ -0,0 +1 @@
+#include "./ct_eval.hpp"
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <concepts>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+#include "noctern/compilation_unit.hpp"
+#include "noctern/interpreter.hpp"
+#include "noctern/meta.hpp"
+#include "noctern/parser.hpp"
+#include "noctern/symbol_table.hpp"
+#include "noctern/tokenize.hpp"
+
+namespace noctern {
+    namespace ct_eval_internal {
+        // Not `constexpr`, so that reaching one of these fails the compilation with its name.
+        inline void unknown_function() {
+        }
+        inline void wrong_number_of_arguments() {
+        }
+    }
+
+    // Evaluates the function `fn` of the program `Source` at compile time, e.g.:
+    //
+    //     constexpr double r = noctern::ct_eval<"def f(x): x * 2 + 1;">("f", 3.0);
+    //
+    // The same front end and interpreter as at run time, so the result is the same as
+    // `interpreter::eval_fn` would give. Anything which isn't a constant expression, such as a
+    // division by zero, fails the compilation instead.
+    template <fixed_string Source, typename... Args>
+        requires(std::convertible_to<Args, double> && ...)
+    consteval double ct_eval(std::string_view fn, Args... args) {
+        const tokens parsed = noctern::parse(noctern::tokenize_all(Source));
+        const compilation_unit unit(parsed);
+        symbol_table table(parsed, unit);
+
+        const std::optional<token> decl = table.find_fn_decl(fn);
+        if (!decl) ct_eval_internal::unknown_function();
+
+        // The parameters are the identifiers from the declaration up to the `)`.
+        interpreter::frame arguments;
+        auto param = parsed.to_iterator(*decl);
+        const std::array<double, sizeof...(Args)> values {static_cast<double>(args)...};
+        for (const double arg : values) {
+            if (parsed.id(*param) != token_id::ident) ct_eval_internal::wrong_number_of_arguments();
+            arguments.locals.emplace_back(parsed.string(*param), arg);
+            ++param;
+        }
+        if (parsed.id(*param) != token_id::rparen) ct_eval_internal::wrong_number_of_arguments();
+
+        return interpreter(std::move(table)).eval_fn(parsed, *decl, std::move(arguments));
+    }
+}
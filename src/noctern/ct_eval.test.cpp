@@ -0,0 +1,43 @@
+#include "./ct_eval.hpp"
+
+#include <catch2/catch.hpp>
+#include <string_view>
+
+#include "noctern/compilation_unit.hpp"
+#include "noctern/interpreter.hpp"
+#include "noctern/parser.hpp"
+#include "noctern/symbol_table.hpp"
+#include "noctern/tokenize.hpp"
+
+namespace noctern {
+    namespace {
+        static_assert(noctern::ct_eval<"def f(x): x * 2 + 1;">("f", 3.0) == 7);
+        static_assert(noctern::ct_eval<"def f(): 0.1 + 0.2;">("f") == 0.1 + 0.2);
+
+        constexpr fixed_string program = R"(
+            def square(x): x * x;
+            def mix(x, y): {
+                let a = x * 2;
+                let a = a - y;
+                let unused = y * y;
+                return a / (y + 1);
+            };
+        )";
+
+        static_assert(noctern::ct_eval<program>("square", 1.5) == 2.25);
+        static_assert(noctern::ct_eval<program>("mix", 4, 1) == 3.5);
+
+        TEST_CASE("ct_eval agrees with the interpreter") {
+            const tokens parsed = noctern::parse(noctern::tokenize_all(program));
+            const compilation_unit unit(parsed);
+            const symbol_table table(parsed, unit);
+            const interpreter interpreter(table);
+
+            constexpr double x = 0.3;
+            constexpr double y = 1e-7;
+            CHECK(noctern::ct_eval<program>("mix", x, y)
+                == interpreter.eval_fn(parsed, *table.find_fn_decl("mix"),
+                    interpreter::frame {.locals = {{"x", x}, {"y", y}}, .expr_stack = {}}));
+        }
+    }
+}
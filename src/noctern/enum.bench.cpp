@@ -0,0 +1,66 @@
+#include "./enum.hpp"
+
+#include <catch2/catch.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <fmt/format.h>
+
+// Generated by cmake/bench_enum.cmake.
+#include "noctern/enum_100.bench.hpp"
+#include "noctern/enum_20.bench.hpp"
+#include "noctern/enum_256.bench.hpp"
+
+namespace noctern {
+    namespace {
+        // A little work which differs by value, so that the cases can't all be folded into one.
+        template <auto V>
+        uint64_t step(uint64_t acc) {
+            constexpr uint64_t value = noctern::to_underlying(V);
+            if constexpr (value % 3 == 0) {
+                return acc * 31 + value;
+            } else if constexpr (value % 3 == 1) {
+                return (acc ^ (acc >> 7)) + value;
+            } else {
+                return acc + value * value;
+            }
+        }
+
+        template <typename Enum>
+        void benchmark_dispatch() {
+            const size_t num_values = enum_count(type<Enum>);
+            // Unpredictable, as the next token or operator is.
+            std::mt19937 rng(1);
+            std::vector<Enum> values(4096);
+            for (Enum& value : values) {
+                value = static_cast<Enum>(rng() % num_values);
+            }
+
+            BENCHMARK(fmt::format("enum_switch, {} values", num_values)) {
+                uint64_t acc = 0;
+                for (Enum value : values) {
+                    acc = noctern::enum_switch(
+                        value, [&]<Enum v>(val_t<v>) { return noctern::step<v>(acc); });
+                }
+                return acc;
+            };
+
+            BENCHMARK(fmt::format("enum_dispatch, {} values", num_values)) {
+                uint64_t acc = 0;
+                for (Enum value : values) {
+                    acc = noctern::enum_dispatch(
+                        value, [&]<Enum v>(val_t<v>) { return noctern::step<v>(acc); });
+                }
+                return acc;
+            };
+        }
+
+        TEST_CASE("enum_switch against enum_dispatch", "[benchmark]") {
+            noctern::benchmark_dispatch<bench::enum_20>();
+            noctern::benchmark_dispatch<bench::enum_100>();
+            noctern::benchmark_dispatch<bench::enum_256>();
+        }
+    }
+}
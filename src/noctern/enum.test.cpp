@@ -0,0 +1,134 @@
+#include "./enum.hpp"
+
+#include <cassert>
+#include <catch2/catch.hpp>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "noctern/tokenize.hpp"
+
+namespace noctern {
+    namespace {
+        struct _sparse_wrapper {
+            // Starts above 0, with a gap, and a sentinel which isn't introspected.
+            enum class sparse : uint8_t {
+                a = 2,
+                b = 3,
+                c = 5,
+                sentinel,
+            };
+
+        private:
+            friend enum_mixin;
+
+            template <typename Fn>
+            friend constexpr decltype(auto) switch_introspect(sparse e, Fn&& fn) {
+                switch (e) {
+                    using enum sparse;
+                    NOCTERN_ENUM_X_INTROSPECT(a)
+                    NOCTERN_ENUM_X_INTROSPECT(b)
+                    NOCTERN_ENUM_X_INTROSPECT(c)
+                case sentinel: assert(false);
+                }
+                assert(false);
+                std::unreachable();
+            }
+
+            template <typename Fn>
+            friend constexpr decltype(auto) introspect(type_t<sparse>, Fn&& fn) {
+                using enum sparse;
+                return std::invoke(std::forward<Fn>(fn), val<a>, val<b>, val<c>);
+            }
+        };
+
+        using sparse = _sparse_wrapper::sparse;
+
+        static_assert(enum_count(type<sparse>) == 3);
+        static_assert(enum_min(type<sparse>) == 2);
+        static_assert(enum_max(type<sparse>) == 5);
+        static_assert(enum_array<sparse, int>::size() == 4);
+
+        static_assert([] {
+            enum_array<sparse, int> counts;
+            ++counts[sparse::a];
+            counts[sparse::c] += 2;
+            return counts[sparse::a] == 1 && counts[sparse::b] == 0 && counts[sparse::c] == 2;
+        }());
+
+        static_assert(enum_bitset<sparse> {sparse::a, sparse::c}.contains(sparse::c));
+        static_assert(!enum_bitset<sparse> {sparse::a, sparse::c}.contains(sparse::b));
+        static_assert(enum_bitset<sparse>::all().size() == 3);
+
+        static_assert(noctern::enum_dispatch(sparse::c, []<sparse e>(val_t<e>) {
+            return noctern::to_underlying(e);
+        }) == 5);
+
+        TEST_CASE("enum_dispatch calls fn with the value, like enum_switch") {
+            for (const sparse e : {sparse::a, sparse::b, sparse::c}) {
+                const auto name = []<sparse v>(val_t<v>) { return stringify(v); };
+                CHECK(noctern::enum_dispatch(e, name) == stringify(e));
+                CHECK(noctern::enum_dispatch(e, name) == noctern::enum_switch(e, name));
+            }
+        }
+
+        TEST_CASE("enum_array holds one value per enum value") {
+            enum_array<sparse, std::string> names(std::string("?"));
+            CHECK(names[sparse::b] == "?");
+
+            names.for_each([&](sparse e, const std::string&) { names[e] = stringify(e); });
+            CHECK(names[sparse::a] == "a");
+            CHECK(names[sparse::b] == "b");
+            CHECK(names[sparse::c] == "c");
+
+            std::string visited;
+            names.for_each([&](sparse, const std::string& name) { visited += name; });
+            CHECK(visited == "abc");
+
+            // Including the gap.
+            CHECK(std::distance(names.begin(), names.end()) == 4);
+        }
+
+        TEST_CASE("enum_array spans every token_id") {
+            const tokens tokens = noctern::tokenize_all("def f(x): x + x * 2;");
+            enum_array<token_id, int> counts;
+            for (token token : tokens) {
+                ++counts[tokens.id(token)];
+            }
+            CHECK(counts[token_id::ident] == 4);
+            CHECK(counts[token_id::int_lit] == 1);
+            CHECK(counts[token_id::return_] == 0);
+        }
+
+        TEST_CASE("enum_bitset holds a set of enum values") {
+            enum_bitset<sparse> set;
+            CHECK(set.empty());
+
+            set.insert(sparse::b);
+            set.insert(sparse::b);
+            CHECK(set.size() == 1);
+            CHECK(set.contains(sparse::b));
+            CHECK(!set.contains(sparse::a));
+
+            set.erase(sparse::b);
+            CHECK(set.empty());
+
+            const enum_bitset<sparse> ab = {sparse::a, sparse::b};
+            const enum_bitset<sparse> bc = {sparse::b, sparse::c};
+            CHECK((ab | bc) == enum_bitset<sparse>::all());
+            CHECK((ab & bc) == enum_bitset<sparse> {sparse::b});
+        }
+
+        TEST_CASE("enum_bitset token classes") {
+            CHECK(literal_tokens == enum_bitset<token_id> {token_id::int_lit, token_id::real_lit});
+            CHECK(tokenize_internal::keyword_tokens
+                == enum_bitset<token_id> {
+                    token_id::fn_intro, token_id::valdef_intro, token_id::return_});
+            CHECK(tokens_with_data
+                == enum_bitset<token_id> {token_id::invalid, token_id::space, token_id::ident,
+                    token_id::int_lit, token_id::real_lit});
+        }
+    }
+}
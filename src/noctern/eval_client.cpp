@@ -0,0 +1,107 @@
+#include "./eval_client.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <string_view>
+#include <utility>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace noctern {
+    namespace {
+        std::error_code last_error() {
+            return std::error_code(errno, std::system_category());
+        }
+
+        constexpr size_t read_chunk_size = 64 * 1024;
+    }
+
+    std::expected<eval_client, std::error_code> eval_client::connect(
+        const std::string& socket_path) {
+        sockaddr_un address {.sun_family = AF_UNIX, .sun_path = {}};
+        if (socket_path.size() >= sizeof(address.sun_path)) {
+            return std::unexpected(std::make_error_code(std::errc::filename_too_long));
+        }
+        std::copy(socket_path.begin(), socket_path.end(), address.sun_path);
+
+        const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd == -1) return std::unexpected(noctern::last_error());
+        if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+            const std::error_code error = noctern::last_error();
+            ::close(fd);
+            return std::unexpected(error);
+        }
+        return eval_client(fd);
+    }
+
+    eval_client::eval_client(eval_client&& rhs) noexcept
+        : fd_(std::exchange(rhs.fd_, -1))
+        , out_(std::move(rhs.out_))
+        , in_(std::move(rhs.in_)) {
+    }
+
+    eval_client& eval_client::operator=(eval_client&& rhs) noexcept {
+        if (this != &rhs) {
+            if (fd_ != -1) ::close(fd_);
+            fd_ = std::exchange(rhs.fd_, -1);
+            out_ = std::move(rhs.out_);
+            in_ = std::move(rhs.in_);
+        }
+        return *this;
+    }
+
+    eval_client::~eval_client() {
+        if (fd_ != -1) ::close(fd_);
+    }
+
+    std::error_code eval_client::send(const eval_protocol::request& request) {
+        out_.clear();
+        if (!eval_protocol::encode(request, out_)) {
+            return std::make_error_code(std::errc::message_size);
+        }
+
+        std::string_view remaining = out_;
+        while (!remaining.empty()) {
+            const ssize_t count = ::send(fd_, remaining.data(), remaining.size(), MSG_NOSIGNAL);
+            if (count == -1) {
+                if (errno == EINTR) continue;
+                return noctern::last_error();
+            }
+            remaining.remove_prefix(static_cast<size_t>(count));
+        }
+        return {};
+    }
+
+    std::error_code eval_client::receive(eval_protocol::response& response) {
+        while (true) {
+            std::string_view buffer = in_;
+            const eval_protocol::decode_result result = eval_protocol::decode(buffer, response);
+            if (result == eval_protocol::decode_result::ok) {
+                in_.erase(0, in_.size() - buffer.size());
+                return {};
+            }
+            if (result == eval_protocol::decode_result::malformed) {
+                return std::make_error_code(std::errc::bad_message);
+            }
+
+            const size_t size = in_.size();
+            in_.resize(size + read_chunk_size);
+            const ssize_t count = ::read(fd_, in_.data() + size, read_chunk_size);
+            const int error = errno;
+            in_.resize(size + static_cast<size_t>(std::max<ssize_t>(count, 0)));
+
+            if (count == 0) return std::make_error_code(std::errc::connection_reset);
+            if (count == -1 && error != EINTR) {
+                return std::error_code(error, std::system_category());
+            }
+        }
+    }
+
+    std::error_code eval_client::call(
+        const eval_protocol::request& request, eval_protocol::response& response) {
+        if (std::error_code error = send(request)) return error;
+        return receive(response);
+    }
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <expected>
+#include <string>
+#include <system_error>
+
+#include "noctern/eval_protocol.hpp"
+
+namespace noctern {
+    // A blocking client for `eval_server`.
+    class eval_client {
+    public:
+        static std::expected<eval_client, std::error_code> connect(const std::string& socket_path);
+
+        eval_client(eval_client&& rhs) noexcept;
+        eval_client& operator=(eval_client&& rhs) noexcept;
+        ~eval_client();
+
+        // Sends `request` without waiting for the response, so that requests can be pipelined.
+        std::error_code send(const eval_protocol::request& request);
+
+        // Waits for the next response.
+        std::error_code receive(eval_protocol::response& response);
+
+        // Sends `request` and waits for its response.
+        std::error_code call(
+            const eval_protocol::request& request, eval_protocol::response& response);
+
+    private:
+        explicit eval_client(int fd)
+            : fd_(fd) {
+        }
+
+        int fd_;
+        std::string out_;
+        std::string in_;
+    };
+}
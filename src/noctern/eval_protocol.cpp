@@ -0,0 +1,188 @@
+#include "./eval_protocol.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <optional>
+
+namespace noctern::eval_protocol {
+    namespace {
+        template <typename T>
+        void put(std::string& out, T value) {
+            char bytes[sizeof(T)];
+            std::memcpy(bytes, &value, sizeof(T));
+            out.append(bytes, sizeof(T));
+        }
+
+        void put_string(std::string& out, std::string_view value) {
+            assert(value.size() <= max_string_size);
+            noctern::eval_protocol::put(out, static_cast<uint16_t>(value.size()));
+            out.append(value);
+        }
+
+        // Writes the payload produced by `fn` with its size in front.
+        template <typename Fn>
+        void put_message(std::string& out, Fn&& fn) {
+            const size_t start = out.size();
+            noctern::eval_protocol::put(out, uint32_t {0});
+            fn();
+            const auto size = static_cast<uint32_t>(out.size() - start - sizeof(uint32_t));
+            std::memcpy(out.data() + start, &size, sizeof(size));
+        }
+
+        // Reads fields from the front of a payload, failing on reads past its end.
+        class reader {
+        public:
+            explicit reader(std::string_view payload)
+                : remaining_(payload) {
+            }
+
+            template <typename T>
+            std::optional<T> get() {
+                if (remaining_.size() < sizeof(T)) return std::nullopt;
+                T value;
+                std::memcpy(&value, remaining_.data(), sizeof(T));
+                remaining_.remove_prefix(sizeof(T));
+                return value;
+            }
+
+            std::optional<std::string_view> get_string() {
+                std::optional<uint16_t> size = get<uint16_t>();
+                if (!size.has_value() || remaining_.size() < *size) return std::nullopt;
+                std::string_view result = remaining_.substr(0, *size);
+                remaining_.remove_prefix(*size);
+                return result;
+            }
+
+            bool done() const {
+                return remaining_.empty();
+            }
+
+        private:
+            std::string_view remaining_;
+        };
+
+        // Splits the next message off the front of `buffer`.
+        decode_result take_payload(std::string_view& buffer, std::string_view& payload) {
+            uint32_t size;
+            if (buffer.size() < sizeof(size)) return decode_result::incomplete;
+            std::memcpy(&size, buffer.data(), sizeof(size));
+            if (size > max_message_size) return decode_result::malformed;
+            if (buffer.size() - sizeof(size) < size) return decode_result::incomplete;
+
+            payload = buffer.substr(sizeof(size), size);
+            buffer.remove_prefix(sizeof(size) + size);
+            return decode_result::ok;
+        }
+    }
+
+    bool encode(const request& request, std::string& out) {
+        if (request.module.size() > max_string_size || request.function.size() > max_string_size
+            || request.args.size() > max_args) {
+            return false;
+        }
+        noctern::eval_protocol::put_message(out, [&] {
+            noctern::eval_protocol::put(out, request.id);
+            noctern::eval_protocol::put_string(out, request.module);
+            noctern::eval_protocol::put_string(out, request.function);
+            noctern::eval_protocol::put(out, static_cast<uint16_t>(request.args.size()));
+            for (double arg : request.args) {
+                noctern::eval_protocol::put(out, arg);
+            }
+        });
+        return true;
+    }
+
+    void encode(const response& response, std::string& out) {
+        noctern::eval_protocol::put_message(out, [&] {
+            noctern::eval_protocol::put(out, response.id);
+            noctern::eval_protocol::put(out, static_cast<uint8_t>(response.status));
+            if (response.status == status::ok) {
+                noctern::eval_protocol::put(out, response.result);
+            } else if (response.error.size() <= max_string_size) {
+                noctern::eval_protocol::put_string(out, response.error);
+            } else {
+                noctern::eval_protocol::put_string(
+                    out, noctern::eval_protocol::elide(response.error, max_string_size));
+            }
+        });
+    }
+
+    std::string elide(std::string_view text, size_t max_size) {
+        constexpr std::string_view ellipsis = "...";
+        assert(max_size >= ellipsis.size());
+        if (text.size() <= max_size) return std::string(text);
+
+        const size_t kept = max_size - ellipsis.size();
+        std::string result(text.substr(0, kept - kept / 2));
+        result += ellipsis;
+        result += text.substr(text.size() - kept / 2);
+        return result;
+    }
+
+    decode_result decode(std::string_view& buffer, request& out) {
+        std::string_view remaining = buffer;
+        std::string_view payload;
+        if (decode_result result = noctern::eval_protocol::take_payload(remaining, payload);
+            result != decode_result::ok) {
+            return result;
+        }
+
+        reader reader(payload);
+        std::optional<uint32_t> id = reader.get<uint32_t>();
+        std::optional<std::string_view> module = reader.get_string();
+        std::optional<std::string_view> function = reader.get_string();
+        std::optional<uint16_t> num_args = reader.get<uint16_t>();
+        if (!num_args.has_value()) return decode_result::malformed;
+
+        out.args.clear();
+        for (uint16_t i = 0; i < *num_args; ++i) {
+            std::optional<double> arg = reader.get<double>();
+            if (!arg.has_value()) return decode_result::malformed;
+            out.args.push_back(*arg);
+        }
+        if (!id.has_value() || !module.has_value() || !function.has_value() || !reader.done()) {
+            return decode_result::malformed;
+        }
+
+        out.id = *id;
+        out.module = *module;
+        out.function = *function;
+        buffer = remaining;
+        return decode_result::ok;
+    }
+
+    decode_result decode(std::string_view& buffer, response& out) {
+        std::string_view remaining = buffer;
+        std::string_view payload;
+        if (decode_result result = noctern::eval_protocol::take_payload(remaining, payload);
+            result != decode_result::ok) {
+            return result;
+        }
+
+        reader reader(payload);
+        std::optional<uint32_t> id = reader.get<uint32_t>();
+        std::optional<uint8_t> status_byte = reader.get<uint8_t>();
+        if (!id.has_value() || !status_byte.has_value()) return decode_result::malformed;
+        if (*status_byte > static_cast<uint8_t>(status::invalid_module)) {
+            return decode_result::malformed;
+        }
+
+        out.id = *id;
+        out.status = static_cast<status>(*status_byte);
+        if (out.status == status::ok) {
+            std::optional<double> result = reader.get<double>();
+            if (!result.has_value()) return decode_result::malformed;
+            out.result = *result;
+            out.error.clear();
+        } else {
+            std::optional<std::string_view> error = reader.get_string();
+            if (!error.has_value()) return decode_result::malformed;
+            out.result = 0;
+            out.error = *error;
+        }
+        if (!reader.done()) return decode_result::malformed;
+
+        buffer = remaining;
+        return decode_result::ok;
+    }
+}
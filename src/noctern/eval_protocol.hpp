@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The binary protocol spoken by `nocternc --serve`.
+//
+// Each message is a `uint32_t` size followed by that many bytes of payload. Integers and doubles
+// are in host byte order, as both ends are on the same machine.
+//
+// Request payload:  uint32 id, uint16 size + module path, uint16 size + function name,
+//                   uint16 count + that many doubles.
+// Response payload: uint32 id, uint8 status, then a double result if the status is `ok`, otherwise
+//                   uint16 size + error message.
+//
+// Requests on one connection are answered in order; the id is only echoed back.
+namespace noctern::eval_protocol {
+    // The largest payload which we accept.
+    inline constexpr uint32_t max_message_size = 1 << 20;
+    // The longest string, and the most arguments, which a message can hold.
+    inline constexpr size_t max_string_size = UINT16_MAX;
+    inline constexpr size_t max_args = UINT16_MAX;
+
+    struct request {
+        uint32_t id = 0;
+        // When decoded, these refer into the buffer which was decoded.
+        std::string_view module;
+        std::string_view function;
+        std::vector<double> args;
+    };
+
+    enum class status : uint8_t {
+        ok,
+        no_such_module,
+        no_such_function,
+        wrong_arity,
+        // The module doesn't compile; the error says why.
+        invalid_module,
+    };
+
+    struct response {
+        uint32_t id = 0;
+        eval_protocol::status status = eval_protocol::status::ok;
+        double result = 0;
+        std::string error;
+    };
+
+    enum class decode_result {
+        ok,
+        // `buffer` doesn't hold a whole message yet.
+        incomplete,
+        // The connection should be dropped.
+        malformed,
+    };
+
+    // Appends the encoded message to `out`. Fails, appending nothing, if the module path or the
+    // function name is longer than `max_string_size`, or there are more than `max_args` arguments.
+    [[nodiscard]] bool encode(const request& request, std::string& out);
+    // An error longer than `max_string_size` is shortened as by `elide`.
+    void encode(const response& response, std::string& out);
+
+    // `text` if it's at most `max_size` bytes long, else its start and end around "...", to make
+    // up `max_size` bytes. E.g. for quoting a client's names in an error.
+    std::string elide(std::string_view text, size_t max_size);
+
+    // Decodes the message at the front of `buffer` into `out` and removes it from `buffer`, if the
+    // whole message is there.
+    //
+    // Reuses the storage of `out`, so decoding a stream of requests doesn't allocate.
+    decode_result decode(std::string_view& buffer, request& out);
+    decode_result decode(std::string_view& buffer, response& out);
+}
@@ -0,0 +1,129 @@
+#include "./eval_protocol.hpp"
+
+#include <catch2/catch.hpp>
+#include <string>
+#include <vector>
+
+namespace noctern {
+    namespace {
+        TEST_CASE("eval_protocol requests round trip") {
+            const eval_protocol::request request {
+                .id = 7,
+                .module = "examples/simple_main.nct",
+                .function = "f",
+                .args = {1.5, -0.25, 1e300},
+            };
+
+            std::string encoded;
+            REQUIRE(eval_protocol::encode(request, encoded));
+            REQUIRE(eval_protocol::encode(request, encoded));
+
+            std::string_view buffer = encoded;
+            eval_protocol::request decoded;
+            for (int i = 0; i < 2; ++i) {
+                REQUIRE(eval_protocol::decode(buffer, decoded) == eval_protocol::decode_result::ok);
+                CHECK(decoded.id == 7);
+                CHECK(decoded.module == request.module);
+                CHECK(decoded.function == request.function);
+                CHECK(decoded.args == request.args);
+            }
+            CHECK(buffer.empty());
+        }
+
+        TEST_CASE("eval_protocol responses round trip") {
+            using eval_protocol::status;
+
+            std::string encoded;
+            eval_protocol::encode(
+                eval_protocol::response {.id = 1, .result = 2.5, .error = {}}, encoded);
+            eval_protocol::encode(
+                eval_protocol::response {.id = 2, .status = status::wrong_arity, .error = "oops"},
+                encoded);
+
+            std::string_view buffer = encoded;
+            eval_protocol::response decoded;
+            REQUIRE(eval_protocol::decode(buffer, decoded) == eval_protocol::decode_result::ok);
+            CHECK(decoded.id == 1);
+            CHECK(decoded.status == status::ok);
+            CHECK(decoded.result == 2.5);
+
+            REQUIRE(eval_protocol::decode(buffer, decoded) == eval_protocol::decode_result::ok);
+            CHECK(decoded.id == 2);
+            CHECK(decoded.status == status::wrong_arity);
+            CHECK(decoded.error == "oops");
+            CHECK(buffer.empty());
+        }
+
+        TEST_CASE("eval_protocol waits for whole messages") {
+            std::string encoded;
+            REQUIRE(eval_protocol::encode(
+                eval_protocol::request {.id = 3, .module = "m", .function = "f", .args = {1}},
+                encoded));
+
+            eval_protocol::request decoded;
+            for (size_t size = 0; size < encoded.size(); ++size) {
+                std::string_view partial = std::string_view(encoded).substr(0, size);
+                CHECK(eval_protocol::decode(partial, decoded)
+                    == eval_protocol::decode_result::incomplete);
+                CHECK(partial.size() == size);
+            }
+        }
+
+        TEST_CASE("eval_protocol rejects malformed messages") {
+            std::string encoded;
+            REQUIRE(eval_protocol::encode(
+                eval_protocol::request {.id = 3, .module = "m", .function = "f", .args = {1}},
+                encoded));
+            // Claim one more argument than the payload holds.
+            encoded[4 + 4 + 3 + 3] = 2;
+
+            std::string_view buffer = encoded;
+            eval_protocol::request decoded;
+            CHECK(eval_protocol::decode(buffer, decoded)
+                == eval_protocol::decode_result::malformed);
+
+            const std::string huge = "\xff\xff\xff\xff";
+            buffer = huge;
+            CHECK(eval_protocol::decode(buffer, decoded)
+                == eval_protocol::decode_result::malformed);
+        }
+
+        TEST_CASE("eval_protocol limits string sizes") {
+            const std::string too_long(eval_protocol::max_string_size + 1, 'm');
+
+            // Requests are the client's to fix.
+            std::string encoded;
+            CHECK_FALSE(eval_protocol::encode(
+                eval_protocol::request {.id = 1, .module = too_long, .function = "f", .args = {}},
+                encoded));
+            CHECK_FALSE(eval_protocol::encode(
+                eval_protocol::request {.id = 1, .module = "m", .function = too_long, .args = {}},
+                encoded));
+            CHECK_FALSE(eval_protocol::encode(
+                eval_protocol::request {.id = 1,
+                    .module = "m",
+                    .function = "f",
+                    .args = std::vector<double>(eval_protocol::max_args + 1)},
+                encoded));
+            CHECK(encoded.empty());
+
+            // Errors are shortened.
+            eval_protocol::encode(
+                eval_protocol::response {
+                    .id = 2, .status = eval_protocol::status::no_such_module, .error = too_long},
+                encoded);
+            std::string_view buffer = encoded;
+            eval_protocol::response decoded;
+            REQUIRE(eval_protocol::decode(buffer, decoded) == eval_protocol::decode_result::ok);
+            CHECK(decoded.error.size() == eval_protocol::max_string_size);
+            CHECK(decoded.error.find("...") != std::string::npos);
+        }
+
+        TEST_CASE("eval_protocol elides the middle of long text") {
+            CHECK(eval_protocol::elide("short", 10) == "short");
+            CHECK(eval_protocol::elide("0123456789", 10) == "0123456789");
+            CHECK(eval_protocol::elide("0123456789a", 10) == "0123...89a");
+            CHECK(eval_protocol::elide("0123456789", 3) == "...");
+        }
+    }
+}
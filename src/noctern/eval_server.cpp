@@ -0,0 +1,446 @@
+#include "./eval_server.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include <fmt/format.h>
+
+#include "noctern/arena.hpp"
+#include "noctern/ir.hpp"
+#include "noctern/parser.hpp"
+#include "noctern/source_file.hpp"
+#include "noctern/tokenize.hpp"
+#include "noctern/validate.hpp"
+#include "noctern/value_numbering.hpp"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace noctern {
+    namespace {
+        std::error_code last_error() {
+            return std::error_code(errno, std::system_category());
+        }
+
+        // Removes what's at `address` only if it's a socket which nothing listens on any more, e.g.
+        // left behind by a server which was killed. Anything else there is an error, so that a
+        // mistyped path can't delete a file.
+        std::error_code remove_stale_socket(const sockaddr_un& address) {
+            struct stat info;
+            if (::lstat(address.sun_path, &info) != 0) {
+                return errno == ENOENT ? std::error_code() : noctern::last_error();
+            }
+            if (!S_ISSOCK(info.st_mode)) return std::make_error_code(std::errc::file_exists);
+
+            const int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (probe == -1) return noctern::last_error();
+            const bool listening
+                = ::connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address))
+                    == 0
+                || errno == EAGAIN;
+            ::close(probe);
+            if (listening) return std::make_error_code(std::errc::address_in_use);
+
+            if (::unlink(address.sun_path) != 0 && errno != ENOENT) return noctern::last_error();
+            return {};
+        }
+
+        void signal_eventfd(int fd) {
+            const uint64_t one = 1;
+            [[maybe_unused]] ssize_t written = ::write(fd, &one, sizeof(one));
+        }
+
+        void drain_eventfd(int fd) {
+            uint64_t count;
+            [[maybe_unused]] ssize_t read = ::read(fd, &count, sizeof(count));
+        }
+
+        // A client's names are quoted in errors at most this long, so that errors stay short.
+        constexpr size_t max_quoted_size = 256;
+
+        std::string quoted(std::string_view name) {
+            return eval_protocol::elide(name, max_quoted_size);
+        }
+
+        constexpr size_t read_chunk_size = 64 * 1024;
+        constexpr int max_events = 64;
+    }
+
+    module_cache::module_cache(std::filesystem::path root)
+        : root_(std::move(root)) {
+        assert(root_.is_absolute());
+    }
+
+    std::optional<std::filesystem::path> module_cache::resolve(std::string_view path) const {
+        // Wouldn't name the same file to the checks below as to `open`.
+        if (path.find('\0') != std::string_view::npos) return std::nullopt;
+
+        std::error_code error;
+        std::filesystem::path resolved = std::filesystem::weakly_canonical(root_ / path, error);
+        if (error) return std::nullopt;
+        if (std::ranges::mismatch(root_, resolved).in1 != root_.end()) return std::nullopt;
+        return resolved;
+    }
+
+    std::expected<const compiled_module*, module_error> module_cache::get(std::string_view path) {
+        {
+            std::shared_lock lock(mutex_);
+            if (auto it = modules_.find(path); it != modules_.end()) return it->second.get();
+        }
+
+        // Compile outside of the lock, so that other modules can still be served meanwhile.
+        const std::optional<std::filesystem::path> resolved = resolve(path);
+        if (!resolved.has_value()) {
+            return std::unexpected(module_error {
+                .status = eval_protocol::status::no_such_module,
+                .message = fmt::format("No module {} under the module root", noctern::quoted(path)),
+            });
+        }
+        // Copied rather than mapped, so that truncating the file while it's compiled can't kill
+        // the server.
+        auto source = source_file::open_copy(resolved->c_str());
+        if (!source.has_value()) {
+            return std::unexpected(module_error {
+                .status = eval_protocol::status::no_such_module,
+                .message = fmt::format("Couldn't read module {}: {}", noctern::quoted(path),
+                    source.error().message()),
+            });
+        }
+
+        arena arena;
+        tokens tokenized = noctern::tokenize_all(source->contents(), &arena);
+        if (auto valid = noctern::validate(tokenized); !valid.has_value()) {
+            return std::unexpected(module_error {
+                .status = eval_protocol::status::invalid_module,
+                .message
+                = fmt::format("Invalid module {}: {}", noctern::quoted(path), valid.error()),
+            });
+        }
+        const tokens parsed = noctern::eliminate_common_subexpressions(
+            noctern::parse(std::move(tokenized)));
+        auto module = std::make_unique<compiled_module>();
+        for (const ir::function& fn : ir::build(parsed).functions) {
+            // The first definition of a name wins, as in `ir::module::find`.
+            if (module->functions.contains(fn.name)) continue;
+            compiled_fn compiled = noctern::lower(fn);
+            module->max_frame_size = std::max(module->max_frame_size, compiled.frame_size());
+            module->functions.emplace(fn.name, std::move(compiled));
+        }
+
+        std::unique_lock lock(mutex_);
+        // Another thread may have compiled it in the meantime; either copy is fine.
+        auto [it, inserted] = modules_.try_emplace(std::string(path), std::move(module));
+        return it->second.get();
+    }
+
+    eval_protocol::response evaluate(
+        module_cache& modules, const eval_protocol::request& request, std::vector<double>& frame) {
+        using eval_protocol::status;
+
+        eval_protocol::response response;
+        response.id = request.id;
+
+        auto module = modules.get(request.module);
+        if (!module.has_value()) {
+            response.status = module.error().status;
+            response.error = std::move(module.error().message);
+            return response;
+        }
+
+        auto fn = (*module)->functions.find(request.function);
+        if (fn == (*module)->functions.end()) {
+            response.status = status::no_such_function;
+            response.error = fmt::format("No function `{}` in {}",
+                noctern::quoted(request.function), noctern::quoted(request.module));
+            return response;
+        }
+
+        if (request.args.size() != static_cast<size_t>(fn->second.num_params())) {
+            response.status = status::wrong_arity;
+            response.error = fmt::format("`{}` takes {} arguments, but got {}",
+                noctern::quoted(request.function), fn->second.num_params(), request.args.size());
+            return response;
+        }
+
+        if (frame.size() < (*module)->max_frame_size) frame.resize((*module)->max_frame_size);
+        response.result = fn->second.call(request.args, frame);
+        return response;
+    }
+
+    class eval_server::worker {
+    public:
+        explicit worker(module_cache& modules)
+            : modules_(modules)
+            , epoll_fd_(::epoll_create1(EPOLL_CLOEXEC))
+            , wake_fd_(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+            epoll_event event {.events = EPOLLIN, .data = {.fd = wake_fd_}};
+            ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event);
+            thread_ = std::thread([this] { run(); });
+        }
+
+        worker(const worker&) = delete;
+        worker& operator=(const worker&) = delete;
+
+        ~worker() {
+            stopping_.store(true);
+            noctern::signal_eventfd(wake_fd_);
+            thread_.join();
+
+            for (auto& [fd, connection] : connections_) {
+                ::close(fd);
+            }
+            for (int fd : pending_) {
+                ::close(fd);
+            }
+            ::close(wake_fd_);
+            ::close(epoll_fd_);
+        }
+
+        // Takes ownership of the connection `fd`.
+        void adopt(int fd) {
+            {
+                std::lock_guard lock(pending_mutex_);
+                pending_.push_back(fd);
+            }
+            noctern::signal_eventfd(wake_fd_);
+        }
+
+    private:
+        struct connection {
+            std::string in;
+            std::string out;
+            // How much of `out` is already written.
+            size_t written = 0;
+            bool waiting_to_write = false;
+        };
+
+        void run() {
+            epoll_event events[max_events];
+            while (!stopping_.load()) {
+                const int count = ::epoll_wait(epoll_fd_, events, max_events, -1);
+                for (int i = 0; i < count; ++i) {
+                    const int fd = events[i].data.fd;
+                    if (fd == wake_fd_) {
+                        noctern::drain_eventfd(wake_fd_);
+                        adopt_pending();
+                    } else {
+                        serve(fd, events[i].events);
+                    }
+                }
+            }
+        }
+
+        void adopt_pending() {
+            std::lock_guard lock(pending_mutex_);
+            for (int fd : pending_) {
+                epoll_event event {.events = EPOLLIN | EPOLLRDHUP, .data = {.fd = fd}};
+                ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+                connections_.try_emplace(fd);
+            }
+            pending_.clear();
+        }
+
+        void serve(int fd, uint32_t events) {
+            connection& conn = connections_.at(fd);
+
+            bool open = true;
+            if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                open = read_requests(fd, conn);
+            }
+            // Even if the client is done sending, it may still want its last responses.
+            if (!write_responses(fd, conn)) open = false;
+
+            if (!open) {
+                ::close(fd);
+                connections_.erase(fd);
+            }
+        }
+
+        // Reads everything available and answers every complete request. Returns whether the
+        // connection is still open.
+        bool read_requests(int fd, connection& conn) {
+            bool open = true;
+            while (true) {
+                const size_t size = conn.in.size();
+                conn.in.resize(size + read_chunk_size);
+                const ssize_t count = ::read(fd, conn.in.data() + size, read_chunk_size);
+                const int error = errno;
+                conn.in.resize(size + static_cast<size_t>(std::max<ssize_t>(count, 0)));
+
+                if (count > 0) continue;
+                if (count == -1 && error == EINTR) continue;
+                // EOF, or an error other than running out of input.
+                if (count == 0 || (error != EAGAIN && error != EWOULDBLOCK)) open = false;
+                break;
+            }
+
+            std::string_view buffer = conn.in;
+            while (true) {
+                const eval_protocol::decode_result result
+                    = eval_protocol::decode(buffer, request_);
+                if (result == eval_protocol::decode_result::malformed) return false;
+                if (result == eval_protocol::decode_result::incomplete) break;
+
+                eval_protocol::encode(noctern::evaluate(modules_, request_, frame_), conn.out);
+            }
+            conn.in.erase(0, conn.in.size() - buffer.size());
+
+            return open;
+        }
+
+        // Writes as much as possible of the pending responses. Returns whether the connection is
+        // still open.
+        bool write_responses(int fd, connection& conn) {
+            while (conn.written < conn.out.size()) {
+                const ssize_t count = ::send(fd, conn.out.data() + conn.written,
+                    conn.out.size() - conn.written, MSG_NOSIGNAL);
+                if (count >= 0) {
+                    conn.written += static_cast<size_t>(count);
+                } else if (errno == EINTR) {
+                    continue;
+                } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;
+                } else {
+                    return false;
+                }
+            }
+
+            const bool blocked = conn.written < conn.out.size();
+            if (!blocked) {
+                conn.out.clear();
+                conn.written = 0;
+            }
+            if (blocked != conn.waiting_to_write) {
+                conn.waiting_to_write = blocked;
+                epoll_event event {
+                    .events = EPOLLIN | EPOLLRDHUP | (blocked ? EPOLLOUT : 0u),
+                    .data = {.fd = fd},
+                };
+                ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event);
+            }
+            return true;
+        }
+
+        module_cache& modules_;
+
+        int epoll_fd_;
+        int wake_fd_;
+        std::atomic<bool> stopping_ = false;
+
+        std::mutex pending_mutex_;
+        std::vector<int> pending_;
+
+        // Only touched by the worker's thread.
+        std::unordered_map<int, connection> connections_;
+        eval_protocol::request request_;
+        std::vector<double> frame_;
+
+        std::thread thread_;
+    };
+
+    std::expected<std::unique_ptr<eval_server>, std::error_code> eval_server::listen(
+        const std::string& socket_path, int num_workers,
+        const std::filesystem::path& module_root) {
+        std::error_code root_error;
+        std::filesystem::path root = std::filesystem::canonical(module_root, root_error);
+        if (root_error) return std::unexpected(root_error);
+
+        sockaddr_un address {.sun_family = AF_UNIX, .sun_path = {}};
+        if (socket_path.size() >= sizeof(address.sun_path)) {
+            return std::unexpected(std::make_error_code(std::errc::filename_too_long));
+        }
+        std::copy(socket_path.begin(), socket_path.end(), address.sun_path);
+
+        const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd == -1) return std::unexpected(noctern::last_error());
+
+        if (const std::error_code error = noctern::remove_stale_socket(address)) {
+            ::close(fd);
+            return std::unexpected(error);
+        }
+        if (::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+            || ::listen(fd, SOMAXCONN) != 0) {
+            const std::error_code error = noctern::last_error();
+            ::close(fd);
+            return std::unexpected(error);
+        }
+
+        const int stop_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (stop_fd == -1) {
+            const std::error_code error = noctern::last_error();
+            ::close(fd);
+            return std::unexpected(error);
+        }
+
+        return std::unique_ptr<eval_server>(
+            new eval_server(fd, stop_fd, socket_path, std::max(num_workers, 1), std::move(root)));
+    }
+
+    eval_server::eval_server(int listen_fd, int stop_fd, std::string socket_path, int num_workers,
+        std::filesystem::path module_root)
+        : listen_fd_(listen_fd)
+        , stop_fd_(stop_fd)
+        , socket_path_(std::move(socket_path))
+        , num_workers_(num_workers)
+        , modules_(std::move(module_root)) {
+    }
+
+    eval_server::~eval_server() {
+        ::close(listen_fd_);
+        ::close(stop_fd_);
+        ::unlink(socket_path_.c_str());
+    }
+
+    void eval_server::run() {
+        std::vector<std::unique_ptr<worker>> workers;
+        for (int i = 0; i < num_workers_; ++i) {
+            workers.push_back(std::make_unique<worker>(modules_));
+        }
+
+        const int epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+        for (int fd : {listen_fd_, stop_fd_}) {
+            epoll_event event {.events = EPOLLIN, .data = {.fd = fd}};
+            ::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+        }
+
+        size_t next_worker = 0;
+        bool stopping = false;
+        while (!stopping) {
+            epoll_event events[2];
+            const int count = ::epoll_wait(epoll_fd, events, 2, -1);
+            for (int i = 0; i < count; ++i) {
+                if (events[i].data.fd == stop_fd_) {
+                    noctern::drain_eventfd(stop_fd_);
+                    stopping = true;
+                    continue;
+                }
+
+                while (true) {
+                    const int connection
+                        = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                    if (connection == -1) break;
+                    workers[next_worker]->adopt(connection);
+                    next_worker = (next_worker + 1) % workers.size();
+                }
+            }
+        }
+
+        ::close(epoll_fd);
+        // Joins the workers and closes their connections.
+        workers.clear();
+    }
+
+    void eval_server::stop() {
+        noctern::signal_eventfd(stop_fd_);
+    }
+}
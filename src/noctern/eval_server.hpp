@@ -0,0 +1,114 @@
+#pragma once
+
+#include <expected>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+
+#include "noctern/compiled_fn.hpp"
+#include "noctern/eval_protocol.hpp"
+
+namespace noctern {
+    // The functions of a source file, compiled for repeated calls.
+    struct compiled_module {
+        struct string_hash {
+            using is_transparent = void;
+
+            size_t operator()(std::string_view value) const {
+                return std::hash<std::string_view> {}(value);
+            }
+        };
+
+        std::unordered_map<std::string, compiled_fn, string_hash, std::equal_to<>> functions;
+
+        // The largest `frame_size()` of `functions`.
+        size_t max_frame_size = 0;
+    };
+
+    // Why `module_cache::get` couldn't load a module.
+    struct module_error {
+        eval_protocol::status status;
+        std::string message;
+    };
+
+    // Compiles each module on first use and keeps it for later requests.
+    //
+    // Only modules under a root directory are served, so that a client can't have any file the
+    // server can read compiled, nor see its contents in the errors.
+    //
+    // Thread safe. Modules are never evicted, so the returned references stay valid.
+    class module_cache {
+    public:
+        // `root` must be canonical, e.g. from `std::filesystem::canonical`.
+        explicit module_cache(std::filesystem::path root);
+
+        // The module at `path`, relative to the root unless it's absolute, or why it couldn't be
+        // loaded. Failures are not cached.
+        //
+        // The module is validated before it's compiled, since it's named by a client and may
+        // not compile: e.g. a half-saved file.
+        std::expected<const compiled_module*, module_error> get(std::string_view path);
+
+    private:
+        // Where `path` leads, after following symlinks, if that's under `root_`.
+        std::optional<std::filesystem::path> resolve(std::string_view path) const;
+
+        std::filesystem::path root_;
+        std::shared_mutex mutex_;
+        std::unordered_map<std::string, std::unique_ptr<const compiled_module>,
+            compiled_module::string_hash, std::equal_to<>>
+            modules_;
+    };
+
+    // Evaluates functions for clients over a Unix domain socket, speaking `eval_protocol`.
+    //
+    // The calling thread of `run()` accepts connections and hands them out round robin to worker
+    // threads. Each worker owns an epoll instance and serves its connections from start to end, so
+    // connections never move between threads.
+    class eval_server {
+    public:
+        // Listens on `socket_path`, replacing a stale socket there, to serve the modules under
+        // `module_root`. Fails with `file_exists` if something other than a socket is there, and
+        // `address_in_use` if a server still listens on it.
+        static std::expected<std::unique_ptr<eval_server>, std::error_code> listen(
+            const std::string& socket_path, int num_workers,
+            const std::filesystem::path& module_root);
+
+        eval_server(const eval_server&) = delete;
+        eval_server& operator=(const eval_server&) = delete;
+        ~eval_server();
+
+        // Serves until `stop()` is called.
+        void run();
+
+        // Makes `run()` return. Callable from any thread, including signal handlers.
+        void stop();
+
+    private:
+        class worker;
+
+        eval_server(int listen_fd, int stop_fd, std::string socket_path, int num_workers,
+            std::filesystem::path module_root);
+
+        int listen_fd_;
+        // An eventfd which is signaled by `stop()`.
+        int stop_fd_;
+        std::string socket_path_;
+        int num_workers_;
+
+        module_cache modules_;
+    };
+
+    // Evaluates `request` against the modules in `modules`.
+    //
+    // `frame` is scratch space for the call, resized as needed.
+    eval_protocol::response evaluate(
+        module_cache& modules, const eval_protocol::request& request, std::vector<double>& frame);
+}
@@ -0,0 +1,192 @@
+#include "./eval_server.hpp"
+
+#include <catch2/catch.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "noctern/eval_client.hpp"
+#include "noctern/temp_dir.test.hpp"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace noctern {
+    namespace {
+        constexpr std::string_view source = R"(
+            def scale(x, by): x * by;
+            def Main(): { let a = 2; return a * a + 1; };
+        )";
+
+        std::string write_module(
+            const std::filesystem::path& path, std::string_view source = noctern::source) {
+            std::FILE* file = std::fopen(path.c_str(), "wb");
+            REQUIRE(file != nullptr);
+            std::fwrite(source.data(), 1, source.size(), file);
+            std::fclose(file);
+            return path.string();
+        }
+
+        TEST_CASE("evaluate reports bad requests") {
+            const temp_dir dir;
+            const std::string module = noctern::write_module(dir / "evaluate.nct");
+            module_cache modules(std::filesystem::canonical(dir.path()));
+            std::vector<double> frame;
+
+            using eval_protocol::status;
+            const auto eval = [&](std::string_view module, std::string_view function,
+                                  std::vector<double> args) {
+                return noctern::evaluate(modules,
+                    eval_protocol::request {
+                        .id = 0, .module = module, .function = function, .args = std::move(args)},
+                    frame);
+            };
+
+            CHECK(eval(module, "scale", {3, 4}).result == 12);
+            CHECK(eval(module, "Main", {}).result == 5);
+            CHECK(eval(module, "scale", {3}).status == status::wrong_arity);
+            CHECK(eval(module, "missing", {}).status == status::no_such_function);
+            CHECK(eval("/nonexistent.nct", "Main", {}).status == status::no_such_module);
+
+            // The first definition of a name wins, as everywhere else.
+            const std::string redefined = noctern::write_module(
+                dir / "redefined.nct", "def f(): 1; def f(x): x; def f(): 3;");
+            CHECK(eval(redefined, "f", {}).result == 1);
+            CHECK(eval(redefined, "f", {2}).status == status::wrong_arity);
+
+            // Names as long as a request can hold are shortened in errors.
+            const std::string long_name(eval_protocol::max_string_size, 'n');
+            const eval_protocol::response missing_module = eval("/" + long_name, "Main", {});
+            CHECK(missing_module.status == status::no_such_module);
+            CHECK(missing_module.error.size() < 1000);
+            const eval_protocol::response missing_function = eval(module, long_name, {});
+            CHECK(missing_function.status == status::no_such_function);
+            CHECK(missing_function.error.size() < 1000);
+        }
+
+        TEST_CASE("evaluate reports invalid modules rather than compiling them") {
+            const temp_dir dir;
+            const std::string_view invalid_source = GENERATE(as<std::string_view> {},
+                "def Main(): { let x = ; return x; };", "def Main(): y + 1;", "def Main(): {");
+            const std::string module
+                = noctern::write_module(dir / "invalid.nct", invalid_source);
+            module_cache modules(std::filesystem::canonical(dir.path()));
+            std::vector<double> frame;
+
+            const eval_protocol::response response = noctern::evaluate(modules,
+                eval_protocol::request {.id = 0, .module = module, .function = "Main", .args = {}},
+                frame);
+            CHECK(response.status == eval_protocol::status::invalid_module);
+            CHECK(response.error.starts_with("Invalid module " + module + ": in `Main`: "));
+
+            // Fixing the module is picked up, since failures aren't cached.
+            noctern::write_module(module);
+            CHECK(noctern::evaluate(modules,
+                      eval_protocol::request {
+                          .id = 1, .module = module, .function = "Main", .args = {}},
+                      frame)
+                      .result
+                == 5);
+        }
+
+        TEST_CASE("evaluate only reads modules under the root") {
+            const temp_dir dir;
+            const temp_dir outside;
+            std::filesystem::create_directory(dir / "root");
+            noctern::write_module(dir / "root" / "module.nct");
+            noctern::write_module(outside / "module.nct");
+            std::filesystem::create_symlink(outside / "module.nct", dir / "root" / "link.nct");
+            module_cache modules(std::filesystem::canonical(dir / "root"));
+            std::vector<double> frame;
+
+            const auto eval = [&](const std::string& module) {
+                return noctern::evaluate(modules,
+                    eval_protocol::request {
+                        .id = 0, .module = module, .function = "Main", .args = {}},
+                    frame);
+            };
+
+            CHECK(eval("module.nct").result == 5);
+            CHECK(eval((dir / "root" / "module.nct").string()).result == 5);
+            CHECK(eval("./sub/../module.nct").result == 5);
+            for (const std::string& module : {(outside / "module.nct").string(),
+                     "../../" + outside.path().filename().string() + "/module.nct",
+                     std::string("link.nct"), std::string("../root2/module.nct")}) {
+                const eval_protocol::response response = eval(module);
+                CHECK(response.status == eval_protocol::status::no_such_module);
+                CHECK(response.error.ends_with("under the module root"));
+            }
+        }
+
+        TEST_CASE("eval_server answers clients") {
+            const temp_dir dir;
+            const std::string module = noctern::write_module(dir / "module.nct");
+            const std::string socket_path = (dir / "server.sock").string();
+
+            auto server = eval_server::listen(socket_path, 2, dir.path());
+            REQUIRE(server.has_value());
+            std::thread serving([&] { (*server)->run(); });
+
+            // Several connections, to reach both workers.
+            for (int connection = 0; connection < 3; ++connection) {
+                auto client = eval_client::connect(socket_path);
+                REQUIRE(client.has_value());
+
+                // Pipelined requests are answered in order.
+                for (uint32_t id = 0; id < 10; ++id) {
+                    REQUIRE_FALSE(client->send(eval_protocol::request {
+                        .id = id,
+                        .module = module,
+                        .function = "scale",
+                        .args = {static_cast<double>(id), 0.5},
+                    }));
+                }
+                for (uint32_t id = 0; id < 10; ++id) {
+                    eval_protocol::response response;
+                    REQUIRE_FALSE(client->receive(response));
+                    CHECK(response.id == id);
+                    CHECK(response.status == eval_protocol::status::ok);
+                    CHECK(response.result == id * 0.5);
+                }
+            }
+
+            (*server)->stop();
+            serving.join();
+            server->reset();
+            CHECK_FALSE(std::filesystem::exists(socket_path));
+        }
+
+        TEST_CASE("eval_server only replaces stale sockets") {
+            const temp_dir dir;
+            const std::string socket_path = (dir / "server.sock").string();
+
+            // E.g. a mistyped module path.
+            noctern::write_module(socket_path);
+            CHECK(eval_server::listen(socket_path, 1, dir.path()).error()
+                == std::make_error_code(std::errc::file_exists));
+            CHECK(std::filesystem::is_regular_file(socket_path));
+            std::filesystem::remove(socket_path);
+
+            auto server = eval_server::listen(socket_path, 1, dir.path());
+            REQUIRE(server.has_value());
+            CHECK(eval_server::listen(socket_path, 1, dir.path()).error()
+                == std::make_error_code(std::errc::address_in_use));
+
+            // A socket left behind once nothing listens on it any more.
+            const int stale = ::socket(AF_UNIX, SOCK_STREAM, 0);
+            REQUIRE(stale != -1);
+            server->reset();
+            sockaddr_un address {.sun_family = AF_UNIX, .sun_path = {}};
+            socket_path.copy(address.sun_path, sizeof(address.sun_path) - 1);
+            REQUIRE(::bind(stale, reinterpret_cast<const sockaddr*>(&address), sizeof(address))
+                == 0);
+            ::close(stale);
+            CHECK(eval_server::listen(socket_path, 1, dir.path()).has_value());
+        }
+    }
+}
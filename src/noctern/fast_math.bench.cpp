@@ -0,0 +1,63 @@
+#include "./fast_math.hpp"
+
+#include <catch2/catch.hpp>
+#include <vector>
+
+#include "noctern/compilation_unit.hpp"
+#include "noctern/compiled_fn.hpp"
+#include "noctern/interpreter.hpp"
+#include "noctern/ir.hpp"
+#include "noctern/parser.hpp"
+#include "noctern/symbol_table.hpp"
+#include "noctern/tokenize.hpp"
+
+namespace noctern {
+    namespace {
+        // Dominated by multiply-adds and division by constants, like our production formulas.
+        constexpr std::string_view source = R"(
+            def formula(x, rate, scale): {
+                let poly = ((((x * 0.5 + 1.25) * x + 3) * x - 7) * x + 2) / 3;
+                let growth = (rate * x + scale) * (rate * scale + 1) / 10;
+                return poly * scale + growth / 4 - x * 2;
+            };
+        )";
+
+        TEST_CASE("optimize_math", "[benchmark]") {
+            const noctern::tokens parsed = noctern::parse(noctern::tokenize_all(source));
+            const ir::function fn = ir::build(parsed).functions[0];
+
+            const compiled_fn strict = noctern::lower(noctern::optimize_math(fn, math_mode::strict));
+            const compiled_fn contract
+                = noctern::lower(noctern::optimize_math(fn, math_mode::contract));
+            const compiled_fn fast = noctern::lower(noctern::optimize_math(fn, math_mode::fast));
+
+            const std::vector<double> args = {1.5, 0.03, 12.0};
+            std::vector<double> frame(strict.frame_size());
+
+            noctern::compilation_unit cu(parsed);
+            noctern::symbol_table st(parsed, cu);
+            noctern::interpreter interpreter(st);
+            const token decl = *st.find_fn_decl("formula");
+
+            BENCHMARK("interpreter") {
+                return interpreter.eval_fn(parsed, decl,
+                    noctern::interpreter::frame {
+                        .locals = {{"x", args[0]}, {"rate", args[1]}, {"scale", args[2]}},
+                        .expr_stack = {},
+                    });
+            };
+
+            BENCHMARK("strict") {
+                return strict.call(args, frame);
+            };
+
+            BENCHMARK("contract") {
+                return contract.call(args, frame);
+            };
+
+            BENCHMARK("fast") {
+                return fast.call(args, frame);
+            };
+        }
+    }
+}
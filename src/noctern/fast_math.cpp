@@ -0,0 +1,175 @@
+#include "./fast_math.hpp"
+
+#include <cassert>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "noctern/ir.hpp"
+
+namespace noctern {
+    namespace {
+        using ir::opcode;
+        using ir::value_id;
+
+        // If `id` is `op %x, <constant>`, returns the constant.
+        const double* constant_rhs(const ir::rewriter& rewriter, value_id id, opcode op) {
+            const ir::instruction& inst = rewriter.at(id);
+            if (inst.op != op) return nullptr;
+            return rewriter.constant_value(inst.args[1]);
+        }
+
+        // Adds `lhs op rhs` to `rewriter`, or something cheaper which `mode` considers equivalent.
+        value_id simplify(ir::rewriter& rewriter, math_mode mode, opcode op, value_id lhs,
+            value_id rhs) {
+            const double* lhs_constant = rewriter.constant_value(lhs);
+            const double* rhs_constant = rewriter.constant_value(rhs);
+
+            // Folding is exact: the compiler rounds just like the operation would at runtime.
+            if (lhs_constant != nullptr && rhs_constant != nullptr) {
+                return rewriter.add_constant(ir::apply(op, *lhs_constant, *rhs_constant));
+            }
+
+            if (mode != math_mode::fast) {
+                return rewriter.add(op, lhs, rhs);
+            }
+
+            // Put constants on the right of commutative operations, so that chains like
+            // `(x + 1) + 2` have a single shape to match.
+            if ((op == opcode::add || op == opcode::mul) && lhs_constant != nullptr) {
+                std::swap(lhs, rhs);
+                std::swap(lhs_constant, rhs_constant);
+            }
+
+            if (op == opcode::sub && lhs == rhs) {
+                return rewriter.add_constant(0);
+            }
+
+            if (rhs_constant != nullptr) {
+                const double constant = *rhs_constant;
+
+                switch (op) {
+                case opcode::add: {
+                    if (constant == 0) return lhs;
+                    if (const double* inner = constant_rhs(rewriter, lhs, opcode::add)) {
+                        return simplify(rewriter, mode, opcode::add, rewriter.at(lhs).args[0],
+                            rewriter.add_constant(*inner + constant));
+                    }
+                    break;
+                }
+                case opcode::sub:
+                    return simplify(
+                        rewriter, mode, opcode::add, lhs, rewriter.add_constant(-constant));
+                case opcode::mul: {
+                    if (constant == 1) return lhs;
+                    if (constant == 0) return rewriter.add_constant(0);
+                    if (constant == 2) return rewriter.add(opcode::add, lhs, lhs);
+                    if (const double* inner = constant_rhs(rewriter, lhs, opcode::mul)) {
+                        return simplify(rewriter, mode, opcode::mul, rewriter.at(lhs).args[0],
+                            rewriter.add_constant(*inner * constant));
+                    }
+                    break;
+                }
+                case opcode::div: {
+                    const double reciprocal = 1 / constant;
+                    if (std::isfinite(reciprocal) && reciprocal != 0) {
+                        return simplify(
+                            rewriter, mode, opcode::mul, lhs, rewriter.add_constant(reciprocal));
+                    }
+                    break;
+                }
+                default: break;
+                }
+            }
+
+            return rewriter.add(op, lhs, rhs);
+        }
+
+        ir::function simplify_all(const ir::function& fn, math_mode mode) {
+            ir::rewriter rewriter(fn);
+
+            for (value_id id = fn.num_params(); id < static_cast<value_id>(fn.instructions.size());
+                ++id) {
+                const ir::instruction& inst = fn.instructions[id];
+                if (ir::num_operands(inst.op) != 2) {
+                    rewriter.set_mapping(id, rewriter.copy(id));
+                    continue;
+                }
+
+                rewriter.set_mapping(id,
+                    simplify(rewriter, mode, inst.op, rewriter.map(inst.args[0]),
+                        rewriter.map(inst.args[1])));
+            }
+
+            return std::move(rewriter).finish();
+        }
+
+        // Fuses each multiplication which only feeds an addition or subtraction into it.
+        ir::function contract(const ir::function& fn) {
+            const auto num_values = static_cast<value_id>(fn.instructions.size());
+
+            std::vector<int> uses(num_values, 0);
+            ++uses[fn.result];
+            for (const ir::instruction& inst : fn.instructions) {
+                for (int i = 0; i < ir::num_operands(inst.op); ++i) {
+                    ++uses[inst.args[i]];
+                }
+            }
+
+            const auto is_fusable = [&](value_id id) {
+                return fn.instructions[id].op == opcode::mul && uses[id] == 1;
+            };
+
+            ir::rewriter rewriter(fn);
+            for (value_id id = fn.num_params(); id < num_values; ++id) {
+                const ir::instruction& inst = fn.instructions[id];
+                const value_id lhs = inst.args[0];
+                const value_id rhs = inst.args[1];
+
+                // `product` is the multiplication to fuse, `other` the remaining operand.
+                opcode fused;
+                value_id product;
+                value_id other;
+                if (inst.op == opcode::add && is_fusable(lhs)) {
+                    fused = opcode::fma, product = lhs, other = rhs;
+                } else if (inst.op == opcode::add && is_fusable(rhs)) {
+                    fused = opcode::fma, product = rhs, other = lhs;
+                } else if (inst.op == opcode::sub && is_fusable(lhs)) {
+                    fused = opcode::fms, product = lhs, other = rhs;
+                } else if (inst.op == opcode::sub && is_fusable(rhs)) {
+                    fused = opcode::fnma, product = rhs, other = lhs;
+                } else {
+                    rewriter.set_mapping(id, rewriter.copy(id));
+                    continue;
+                }
+
+                const ir::instruction& mul = fn.instructions[product];
+                rewriter.set_mapping(id,
+                    rewriter.add(fused, rewriter.map(mul.args[0]), rewriter.map(mul.args[1]),
+                        rewriter.map(other)));
+            }
+
+            // The fused multiplications are now dead.
+            return ir::eliminate_dead_code(std::move(rewriter).finish());
+        }
+    }
+
+    std::optional<math_mode> parse_math_mode(std::string_view name) {
+        if (name == "strict") return math_mode::strict;
+        if (name == "contract") return math_mode::contract;
+        if (name == "fast") return math_mode::fast;
+        return std::nullopt;
+    }
+
+    ir::function optimize_math(const ir::function& fn, math_mode mode) {
+        if (mode == math_mode::strict) return fn;
+
+        return contract(ir::eliminate_dead_code(simplify_all(fn, mode)));
+    }
+
+    void optimize_math(ir::module& module, math_mode mode) {
+        for (ir::function& fn : module.functions) {
+            fn = optimize_math(fn, mode);
+        }
+    }
+}
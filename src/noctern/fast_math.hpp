@@ -0,0 +1,29 @@
+#pragma once
+
+#include <optional>
+#include <string_view>
+
+#include "noctern/ir.hpp"
+
+namespace noctern {
+    // How much freedom optimizations have to change floating-point results.
+    enum class math_mode {
+        // Every operation is rounded exactly as written.
+        strict,
+        // Additionally folds constant operations and fuses `a * b + c` (and `a * b - c`,
+        // `c - a * b`) into a single rounding via `std::fma`. Results may differ in the last bit.
+        contract,
+        // Additionally reassociates constants, replaces division by a constant with multiplication
+        // by its reciprocal, and applies identities such as `x * 2 -> x + x` and `x + 0 -> x` which
+        // ignore signed zeros, infinities and NaNs.
+        fast,
+    };
+
+    // Parses "strict", "contract" or "fast".
+    std::optional<math_mode> parse_math_mode(std::string_view name);
+
+    // Rewrites `fn` using the optimizations which `mode` allows. `strict` returns `fn` unchanged.
+    ir::function optimize_math(const ir::function& fn, math_mode mode);
+
+    void optimize_math(ir::module& module, math_mode mode);
+}
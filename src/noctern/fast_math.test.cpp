@@ -0,0 +1,120 @@
+#include "./fast_math.hpp"
+
+#include <catch2/catch.hpp>
+#include <cmath>
+#include <string_view>
+#include <vector>
+
+#include "noctern/compiled_fn.hpp"
+#include "noctern/ir.hpp"
+#include "noctern/parser.hpp"
+#include "noctern/tokenize.hpp"
+
+namespace noctern {
+    namespace {
+        ir::function build_one(std::string_view source) {
+            return ir::build(noctern::parse(noctern::tokenize_all(source))).functions[0];
+        }
+
+        TEST_CASE("optimize_math strict leaves functions alone") {
+            ir::function fn = build_one("def f(x, y): x * y + 2 * 3;");
+
+            CHECK(ir::dump(noctern::optimize_math(fn, math_mode::strict)) == ir::dump(fn));
+        }
+
+        TEST_CASE("optimize_math contract fuses multiply-adds") {
+            ir::function fn = build_one(R"(
+                def f(a, b, c): {
+                    let sum = a * b + c;
+                    let difference = a * c - b;
+                    let negated = c - b * 2 * 3;
+                    return sum / difference / negated;
+                };
+            )");
+            ir::function result = noctern::optimize_math(fn, math_mode::contract);
+
+            CHECK(ir::verify(result).empty());
+            // Note the parser is right associative, so `b * 2 * 3` is `b * (2 * 3)`.
+            CHECK(ir::dump(result)
+                == "fn f(%0 a, %1 b, %2 c) {\n"
+                   "  %3 = fma %0, %1, %2\n"
+                   "  %4 = fms %0, %2, %1\n"
+                   "  %5 = constant 6\n"
+                   "  %6 = fnma %1, %5, %2\n"
+                   "  %7 = div %4, %6\n"
+                   "  %8 = div %3, %7\n"
+                   "  return %8\n"
+                   "}\n");
+
+            compiled_fn compiled = noctern::lower(result);
+            const double a = 1.25, b = -3.5, c = 0.1;
+            CHECK(compiled.call(std::vector<double> {a, b, c})
+                == std::fma(a, b, c) / (std::fma(a, c, -b) / std::fma(-b, 6, c)));
+        }
+
+        TEST_CASE("optimize_math contract keeps shared products") {
+            ir::function fn = build_one("def f(a, b): a * b + a * b;");
+            ir::function result = noctern::optimize_math(fn, math_mode::contract);
+
+            // The first product is also read by the fused operation, so it must stay.
+            CHECK(ir::dump(result)
+                == "fn f(%0 a, %1 b) {\n"
+                   "  %2 = mul %0, %1\n"
+                   "  %3 = fma %0, %1, %2\n"
+                   "  return %3\n"
+                   "}\n");
+        }
+
+        TEST_CASE("optimize_math fast applies algebraic identities") {
+            SECTION("division by a constant") {
+                ir::function fn = build_one("def f(x): x / 4;");
+                CHECK(ir::dump(noctern::optimize_math(fn, math_mode::fast))
+                    == "fn f(%0 x) {\n"
+                       "  %1 = constant 0.25\n"
+                       "  %2 = mul %0, %1\n"
+                       "  return %2\n"
+                       "}\n");
+            }
+            SECTION("multiplication by two") {
+                ir::function fn = build_one("def f(x): 2 * x;");
+                CHECK(ir::dump(noctern::optimize_math(fn, math_mode::fast))
+                    == "fn f(%0 x) {\n"
+                       "  %1 = add %0, %0\n"
+                       "  return %1\n"
+                       "}\n");
+            }
+            SECTION("reassociation of constants") {
+                ir::function fn = build_one("def f(x): { let y = x + 1; let z = y - 3; return z; };");
+                CHECK(ir::dump(noctern::optimize_math(fn, math_mode::fast))
+                    == "fn f(%0 x) {\n"
+                       "  %1 = constant -2\n"
+                       "  %2 = add %0, %1\n"
+                       "  return %2\n"
+                       "}\n");
+            }
+            SECTION("identities") {
+                ir::function fn = build_one("def f(x, y): (x * 1 + 0) / 1 + (y - y);");
+                CHECK(ir::dump(noctern::optimize_math(fn, math_mode::fast))
+                    == "fn f(%0 x, %1 y) {\n"
+                       "  return %0\n"
+                       "}\n");
+            }
+            SECTION("fused after simplifying") {
+                ir::function fn = build_one("def f(x, y): x / 2 + y;");
+                CHECK(ir::dump(noctern::optimize_math(fn, math_mode::fast))
+                    == "fn f(%0 x, %1 y) {\n"
+                       "  %2 = constant 0.5\n"
+                       "  %3 = fma %0, %2, %1\n"
+                       "  return %3\n"
+                       "}\n");
+            }
+        }
+
+        TEST_CASE("parse_math_mode") {
+            CHECK(noctern::parse_math_mode("strict") == math_mode::strict);
+            CHECK(noctern::parse_math_mode("contract") == math_mode::contract);
+            CHECK(noctern::parse_math_mode("fast") == math_mode::fast);
+            CHECK(noctern::parse_math_mode("fastest") == std::nullopt);
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#include "./file_watcher.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <utility>
+
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace noctern {
+    namespace {
+        std::error_code last_error() {
+            return std::error_code(errno, std::system_category());
+        }
+
+        // Editors often save in several steps; wait this long for them to finish.
+        constexpr int settle_ms = 20;
+    }
+
+    std::expected<file_watcher, std::error_code> file_watcher::watch(
+        const std::filesystem::path& path) {
+        const int fd = ::inotify_init1(IN_CLOEXEC);
+        if (fd == -1) return std::unexpected(noctern::last_error());
+
+        std::filesystem::path dir = path.parent_path();
+        if (dir.empty()) dir = ".";
+        if (::inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) == -1) {
+            const std::error_code error = noctern::last_error();
+            ::close(fd);
+            return std::unexpected(error);
+        }
+        return file_watcher(fd, path.filename().string());
+    }
+
+    file_watcher::file_watcher(file_watcher&& rhs) noexcept
+        : fd_(std::exchange(rhs.fd_, -1))
+        , name_(std::move(rhs.name_)) {
+    }
+
+    file_watcher& file_watcher::operator=(file_watcher&& rhs) noexcept {
+        if (this != &rhs) {
+            if (fd_ != -1) ::close(fd_);
+            fd_ = std::exchange(rhs.fd_, -1);
+            name_ = std::move(rhs.name_);
+        }
+        return *this;
+    }
+
+    file_watcher::~file_watcher() {
+        if (fd_ != -1) ::close(fd_);
+    }
+
+    std::error_code file_watcher::wait() {
+        alignas(inotify_event) char buffer[4096];
+        bool changed = false;
+        while (true) {
+            // Once the file has changed, only drain what follows closely behind.
+            if (changed) {
+                pollfd poll_fd {.fd = fd_, .events = POLLIN, .revents = 0};
+                const int ready = ::poll(&poll_fd, 1, settle_ms);
+                if (ready == 0) return {};
+                if (ready == -1) {
+                    if (errno == EINTR) continue;
+                    return noctern::last_error();
+                }
+            }
+
+            const ssize_t size = ::read(fd_, buffer, sizeof(buffer));
+            if (size == -1) {
+                if (errno == EINTR) continue;
+                return noctern::last_error();
+            }
+
+            for (ssize_t offset = 0; offset < size;) {
+                inotify_event event;
+                std::memcpy(&event, buffer + offset, sizeof(event));
+                const char* name = buffer + offset + sizeof(event);
+                if (event.len != 0 && name_ == name) changed = true;
+                offset += static_cast<ssize_t>(sizeof(event) + event.len);
+            }
+        }
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <expected>
+#include <filesystem>
+#include <string>
+#include <system_error>
+
+namespace noctern {
+    // Waits for a file to be changed, through inotify.
+    //
+    // Watches the file's directory rather than the file itself, so that edits which replace the
+    // file (as many editors save) are seen too.
+    class file_watcher {
+    public:
+        static std::expected<file_watcher, std::error_code> watch(
+            const std::filesystem::path& path);
+
+        file_watcher(file_watcher&& rhs) noexcept;
+        file_watcher& operator=(file_watcher&& rhs) noexcept;
+        ~file_watcher();
+
+        // Blocks until the file has been written and closed, or replaced. Several changes in
+        // quick succession may be reported as one.
+        std::error_code wait();
+
+    private:
+        file_watcher(int fd, std::string name)
+            : fd_(fd)
+            , name_(std::move(name)) {
+        }
+
+        int fd_;
+        // The file's name within the watched directory.
+        std::string name_;
+    };
+}
@@ -0,0 +1,46 @@
+#include "./file_watcher.hpp"
+
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+
+#include "noctern/temp_dir.test.hpp"
+
+namespace noctern {
+    namespace {
+        void write_file(const std::filesystem::path& path, const char* contents) {
+            std::FILE* file = std::fopen(path.c_str(), "wb");
+            if (file == nullptr) return;
+            std::fputs(contents, file);
+            std::fclose(file);
+        }
+
+        TEST_CASE("file_watcher sees writes and replacements") {
+            const temp_dir dir;
+            const std::filesystem::path path = dir / "watched.nct";
+            write_file(path, "def Main(): 1;");
+
+            auto watcher = file_watcher::watch(path);
+            REQUIRE(watcher.has_value());
+
+            const bool replace = GENERATE(false, true);
+            std::thread editor([&] {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                // Changes to other files in the directory are ignored.
+                write_file(dir / "other.nct", "def Main(): 3;");
+                if (replace) {
+                    write_file(dir / "watched.nct.tmp", "def Main(): 2;");
+                    std::filesystem::rename(dir / "watched.nct.tmp", path);
+                } else {
+                    write_file(path, "def Main(): 2;");
+                }
+            });
+
+            const std::error_code error = watcher->wait();
+            editor.join();
+            CHECK(!error);
+        }
+    }
+}
@@ -0,0 +1,89 @@
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include <fmt/core.h>
+
+#include "noctern/fuzz_driver.hpp"
+#include "noctern/parser.hpp"
+#include "noctern/perf_fuzz.hpp"
+#include "noctern/tokenize.hpp"
+
+// Fuzzes the front end for inputs whose work grows faster than linearly in their size.
+//
+// The work per byte of an input is measured at two sizes, a factor of `growth_factor` apart. Any
+// input is tokenized, grown by repeating it. Only valid programs can be parsed, so the parser is
+// given `generate_program(input)` instead, grown by scaling the program. Nesting is capped, so it
+// only grows at small scales, which are measured separately.
+//
+// An input taking over `max_growth` times the work per byte at the larger size fails.
+
+namespace noctern {
+    namespace {
+        // Large enough to time reliably where instructions can't be counted.
+        constexpr size_t min_bytes = 4096;
+        constexpr size_t growth_factor = 4;
+        // Linear work stays near 1, give or take cache effects; quadratic work is near
+        // `growth_factor`.
+        constexpr double max_growth = 2;
+        // The largest scale whose growth stays below `generate_program`'s cap on nesting. Such
+        // programs are small, which is fine where instructions are counted.
+        constexpr size_t nesting_scale = std::bit_floor(max_unclamped_scale / growth_factor);
+
+        std::optional<std::string> check_growth(
+            std::string_view what, const std::optional<cost_growth>& growth, work_meter& meter) {
+            if (!growth.has_value() || growth->per_byte_growth() <= max_growth) {
+                return std::nullopt;
+            }
+            return fmt::format("{} is super-linear: {}", what,
+                noctern::format_cost_growth(*growth, meter.unit()));
+        }
+
+        std::optional<std::string> check_front_end(std::span<const uint8_t> input) {
+            static work_meter meter;
+
+            const std::string_view text(reinterpret_cast<const char*>(input.data()), input.size());
+            std::optional<std::string> failure = noctern::check_growth("tokenize_all",
+                noctern::measure_growth(
+                    meter,
+                    [&](size_t scale) {
+                        std::string result;
+                        for (size_t i = 0; i < scale; ++i) {
+                            result += text;
+                        }
+                        return result;
+                    },
+                    [](std::string_view source) { noctern::tokenize_all(source); }, min_bytes,
+                    growth_factor),
+                meter);
+            if (failure.has_value()) return failure;
+
+            // Tokenizing is linear, or it would have failed above, so this is down to parsing.
+            const auto parse = [](std::string_view source) {
+                noctern::parse(noctern::tokenize_all(source));
+            };
+            failure = noctern::check_growth("parse",
+                noctern::measure_growth(
+                    meter, [&](size_t scale) { return noctern::generate_program(input, scale); },
+                    parse, min_bytes, growth_factor),
+                meter);
+            if (failure.has_value()) return failure;
+
+            // At `min_bytes`, nested functions may be as deep as the cap at both sizes.
+            return noctern::check_growth("parse of nesting",
+                noctern::measure_growth(
+                    meter,
+                    [&](size_t scale) {
+                        return noctern::generate_program(input, nesting_scale * scale);
+                    },
+                    parse, 1, growth_factor),
+                meter);
+        }
+    }
+}
+
+NOCTERN_FUZZ_TARGET(noctern::check_front_end)
@@ -0,0 +1,139 @@
+#include "./fuzz_driver.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "noctern/source_file.hpp"
+
+namespace noctern {
+    namespace {
+        std::span<const uint8_t> as_bytes(std::string_view str) {
+            return std::span(reinterpret_cast<const uint8_t*>(str.data()), str.size());
+        }
+
+        bool write_file(const char* path, std::string_view contents) {
+            std::FILE* file = std::fopen(path, "wb");
+            if (file == nullptr) return false;
+            const bool written
+                = std::fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+            return std::fclose(file) == 0 && written;
+        }
+
+        int minimize_main(int argc, char** argv, fuzz_check check) {
+            if (argc != 4) {
+                fmt::println(stderr, "Usage: {} --minimize <input> <output>", argv[0]);
+                return 2;
+            }
+            const char* input_path = argv[2];
+            const char* output_path = argv[3];
+
+            auto input = source_file::open(input_path);
+            if (!input.has_value()) {
+                fmt::println(stderr, "Couldn't read {}: {}", input_path, input.error().message());
+                return 1;
+            }
+            if (!check(noctern::as_bytes(input->contents())).has_value()) {
+                fmt::println(stderr, "{} doesn't fail, so there's nothing to minimize", input_path);
+                return 1;
+            }
+
+            const std::string minimized
+                = noctern::minimize_failure(std::string(input->contents()), check);
+            if (!noctern::write_file(output_path, minimized)) {
+                fmt::println(stderr, "Couldn't write {}", output_path);
+                return 1;
+            }
+            // The check may be noisy, so say why the minimized input failed, if it still does.
+            const std::optional<std::string> failure = check(noctern::as_bytes(minimized));
+            fmt::println(stderr, "Minimized {} bytes to {}: {}", input->contents().size(),
+                minimized.size(), failure.value_or("passes when run again"));
+            return 0;
+        }
+    }
+
+    std::string minimize_failure(std::string input, fuzz_check check) {
+        const auto fails = [&](std::string_view candidate) {
+            return check(noctern::as_bytes(candidate)).has_value();
+        };
+        if (!fails(input)) return input;
+
+        size_t chunk = std::bit_floor(std::max<size_t>(input.size(), 1));
+        while (chunk != 0) {
+            bool removed_any = false;
+            for (size_t start = 0; start < input.size();) {
+                std::string candidate = input;
+                candidate.erase(start, chunk);
+                if (fails(candidate)) {
+                    input = std::move(candidate);
+                    removed_any = true;
+                } else {
+                    start += chunk;
+                }
+            }
+            // Removing one chunk can let another go, so only move on once none can.
+            if (!removed_any) chunk /= 2;
+        }
+        return input;
+    }
+
+    int fuzz_initialize(int* argc, char*** argv, fuzz_check check) {
+        if (*argc < 2 || std::string_view((*argv)[1]) != "--minimize") return 0;
+        std::exit(noctern::minimize_main(*argc, *argv, check));
+    }
+
+    int fuzz_one_input(std::span<const uint8_t> input, fuzz_check check) {
+        if (const std::optional<std::string> failure = check(input)) {
+            fmt::println(stderr, "{}", *failure);
+            std::abort();
+        }
+        return 0;
+    }
+
+    int replay_fuzz_inputs(
+        int argc, char** argv, int (*test_one_input)(const uint8_t* data, size_t size)) {
+        std::vector<std::filesystem::path> paths;
+        for (int i = 1; i < argc; ++i) {
+            const std::string_view arg = argv[i];
+            if (arg.starts_with('-')) continue;
+
+            std::error_code error;
+            if (!std::filesystem::is_directory(arg, error)) {
+                paths.emplace_back(arg);
+                continue;
+            }
+            std::vector<std::filesystem::path> found;
+            for (auto it = std::filesystem::directory_iterator(arg, error);
+                 !error && it != std::filesystem::directory_iterator(); it.increment(error)) {
+                if (it->is_regular_file(error)) found.push_back(it->path());
+            }
+            if (error) {
+                fmt::println(stderr, "Couldn't search directory {}: {}", arg, error.message());
+                return 1;
+            }
+            std::sort(found.begin(), found.end());
+            paths.insert(paths.end(), found.begin(), found.end());
+        }
+
+        for (const std::filesystem::path& path : paths) {
+            fmt::println(stderr, "Running {}", path.string());
+            auto input = source_file::open(path.c_str());
+            if (!input.has_value()) {
+                fmt::println(
+                    stderr, "Couldn't read {}: {}", path.string(), input.error().message());
+                return 1;
+            }
+            const std::span<const uint8_t> bytes = noctern::as_bytes(input->contents());
+            test_one_input(bytes.data(), bytes.size());
+        }
+        fmt::println(stderr, "Ran {} inputs", paths.size());
+        return 0;
+    }
+}
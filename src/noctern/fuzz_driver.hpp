@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+
+namespace noctern {
+    // A fuzz target's check: why `input` fails it, or nothing if it passes.
+    using fuzz_check = std::optional<std::string> (*)(std::span<const uint8_t> input);
+
+    // Removes as much of `input` as it can while `check` still fails on it: chunks of halving
+    // size, down to single bytes, until no more can go.
+    std::string minimize_failure(std::string input, fuzz_check check);
+
+    // libFuzzer's `LLVMFuzzerInitialize`. Adds a mode to the fuzz target,
+    //
+    //     noctern.fuzz.<name> --minimize <input> <output>
+    //
+    // which writes the smallest input it can find which still fails to `output`, e.g. into the
+    // target's regression corpus, then exits. Otherwise leaves the arguments to libFuzzer.
+    int fuzz_initialize(int* argc, char*** argv, fuzz_check check);
+
+    // libFuzzer's `LLVMFuzzerTestOneInput`: aborts with the reason the input fails, so that
+    // libFuzzer saves it.
+    int fuzz_one_input(std::span<const uint8_t> input, fuzz_check check);
+
+    // A `main` for fuzz targets where libFuzzer isn't available. Runs each file given, and each
+    // file in each directory given, through `test_one_input`; arguments starting with '-' are
+    // libFuzzer flags, and are ignored. Enough to test the corpus without fuzzing.
+    int replay_fuzz_inputs(
+        int argc, char** argv, int (*test_one_input)(const uint8_t* data, size_t size));
+}
+
+// Defines the libFuzzer entry points for a fuzz target made of `check`.
+#define NOCTERN_FUZZ_TARGET(check)                                                                 \
+    extern "C" int LLVMFuzzerInitialize(int* argc, char*** argv) {                                 \
+        return ::noctern::fuzz_initialize(argc, argv, check);                                      \
+    }                                                                                              \
+    extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {                      \
+        return ::noctern::fuzz_one_input(std::span<const uint8_t>(data, size), check);             \
+    }
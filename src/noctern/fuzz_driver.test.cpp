@@ -0,0 +1,28 @@
+#include "./fuzz_driver.hpp"
+
+#include <algorithm>
+#include <catch2/catch.hpp>
+#include <string>
+
+namespace noctern {
+    namespace {
+        // Fails on anything with both an 'x' and a 'y'.
+        std::optional<std::string> has_x_and_y(std::span<const uint8_t> input) {
+            if (std::ranges::find(input, 'x') != input.end()
+                && std::ranges::find(input, 'y') != input.end()) {
+                return "has an x and a y";
+            }
+            return std::nullopt;
+        }
+
+        TEST_CASE("minimize_failure removes everything it can") {
+            CHECK(noctern::minimize_failure("aaxbbbbbbbyccc", has_x_and_y) == "xy");
+            CHECK(noctern::minimize_failure("yyyyyyyxxxxxxx", has_x_and_y) == "yx");
+        }
+
+        TEST_CASE("minimize_failure leaves inputs which pass alone") {
+            CHECK(noctern::minimize_failure("abc", has_x_and_y) == "abc");
+            CHECK(noctern::minimize_failure("", has_x_and_y) == "");
+        }
+    }
+}
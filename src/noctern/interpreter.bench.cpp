@@ -0,0 +1,54 @@
+#include "./interpreter.hpp"
+
+#include <catch2/catch.hpp>
+#include <string>
+
+#include <fmt/format.h>
+
+#include "noctern/compilation_unit.hpp"
+#include "noctern/parser.hpp"
+#include "noctern/symbol_table.hpp"
+#include "noctern/tokenize.hpp"
+
+namespace noctern {
+    namespace {
+        // A function with `num_lets` speculative bindings, of which the result only reads one.
+        std::string speculative_fn(int num_lets) {
+            std::string source = "def f(x, y): {\n";
+            for (int i = 0; i < num_lets; ++i) {
+                source += fmt::format("    let v{} = (x * {} + y) / (y - {}) * x;\n", i, i, i);
+            }
+            source += "    return v0 + x;\n};\n";
+            return source;
+        }
+
+        TEST_CASE("lazy lets", "[benchmark]") {
+            using enum noctern::interpreter::let_evaluation;
+
+            const int num_lets = GENERATE(1, 8, 64);
+            const std::string source = noctern::speculative_fn(num_lets);
+            const noctern::tokens parsed = noctern::parse(noctern::tokenize_all(source));
+
+            noctern::compilation_unit cu(parsed);
+            noctern::symbol_table st(parsed, cu);
+            const token decl = *st.find_fn_decl("f");
+
+            const noctern::interpreter eager_interpreter(st, eager);
+            const noctern::interpreter lazy_interpreter(st, lazy);
+            const auto arguments = [] {
+                return noctern::interpreter::frame {
+                    .locals = {{"x", 1.5}, {"y", 0.25}},
+                    .expr_stack = {},
+                };
+            };
+
+            BENCHMARK(fmt::format("eager, {} lets", num_lets)) {
+                return eager_interpreter.eval_fn(parsed, decl, arguments());
+            };
+
+            BENCHMARK(fmt::format("lazy, {} lets", num_lets)) {
+                return lazy_interpreter.eval_fn(parsed, decl, arguments());
+            };
+        }
+    }
+}
@@ -1,11 +1,17 @@
 #pragma once
 
-#include <optional>
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
 #include <string_view>
-#include <unordered_map>
 #include <utility>
-#include <vector>
 
+#include "noctern/arena.hpp"
+#include "noctern/enum.hpp"
+#include "noctern/number.hpp"
 #include "noctern/symbol_table.hpp"
 #include "noctern/tokenize.hpp"
 
@@ -13,21 +19,343 @@ namespace noctern {
     class interpreter {
     public:
         struct frame {
-            std::unordered_map<std::string_view, double> locals;
-            std::vector<double> expr_stack;
+            // Searched from the back, so a later `let` shadows an earlier one of the same name.
+            // Functions have few enough locals that this beats hashing.
+            arena_vector<std::pair<std::string_view, double>> locals;
+            arena_vector<double> expr_stack;
+
+            constexpr size_t memory_usage() const {
+                return locals.capacity() * sizeof(std::pair<std::string_view, double>)
+                    + expr_stack.capacity() * sizeof(double);
+            }
+        };
+
+        // When the initializer of a `let` is evaluated.
+        enum class let_evaluation {
+            // In order, on entering the block.
+            eager,
+            // On the first read of the `let`, if any; the value is cached for later reads.
+            //
+            // Needs the subtree sizes recorded by `parse` to skip initializers. Without them (e.g.
+            // on the output of an optimization pass), this is the same as `eager`.
+            lazy,
         };
 
-        explicit interpreter(symbol_table table)
-            : table_(std::move(table)) {
+        explicit constexpr interpreter(
+            symbol_table table, let_evaluation lets = let_evaluation::eager)
+            : table_(std::move(table))
+            , lets_(lets) {
         }
 
-        double eval_fn(const tokens& source, token from, frame arguments) const;
+        // Everything the evaluation allocates comes out of a buffer on the stack, unless it's
+        // unusually large.
+        constexpr double eval_fn(const tokens& source, token from, frame arguments) const;
+
+        // Allocates everything from `arena` instead, e.g. to account for the frames' memory.
+        double eval_fn(const tokens& source, token from, frame arguments, arena& arena) const;
+
+        // The bytes allocated, not counting any evaluation in progress.
+        constexpr size_t memory_usage() const {
+            return table_.memory_usage();
+        }
 
     private:
-        double eval_block(const tokens& source, frame& frame, tokens::const_iterator& pos) const;
+        class lazy_lets;
+
+        constexpr double eval_fn_body(
+            const tokens& source, frame& frame, tokens::const_iterator pos) const;
+
+        constexpr double eval_block(
+            const tokens& source, frame& frame, tokens::const_iterator& pos) const;
+
+        constexpr double eval_expr(
+            const tokens& source, frame& frame, tokens::const_iterator& pos) const;
 
-        double eval_expr(const tokens& source, frame& frame, tokens::const_iterator& pos) const;
+        constexpr double eval_lazy_expr(const tokens& source, frame& frame,
+            tokens::const_iterator& pos, lazy_lets& lazy) const;
+
+        // Pushes a literal onto `frame.expr_stack`, or applies an operator to the top of it.
+        static constexpr void eval_operand_or_operator(
+            const tokens& source, frame& frame, token next, token_id id);
+
+        // The latest local named `name`, or null.
+        static constexpr const double* find_local(const frame& frame, std::string_view name) {
+            for (size_t i = frame.locals.size(); i-- > 0;) {
+                if (frame.locals[i].first == name) return &frame.locals[i].second;
+            }
+            return nullptr;
+        }
+
+        static constexpr double read_local(const frame& frame, std::string_view name) {
+            const double* local = interpreter::find_local(frame, name);
+            assert(local != nullptr && "Unknown identifier");
+            return *local;
+        }
 
         symbol_table table_;
+        let_evaluation lets_;
     };
+
+    // The `let`s of a block evaluated under `let_evaluation::lazy`.
+    //
+    // A read resolves to the latest `let` of that name which ends before the read: exactly the one
+    // which eager evaluation would have bound at that point. Thus shadowing (e.g.
+    // `let x = x + 1;`) behaves the same in both modes.
+    //
+    // The `let`s are indexed by name, so that a read costs a binary search rather than a scan of
+    // every `let` before it.
+    class interpreter::lazy_lets {
+    public:
+        explicit constexpr lazy_lets(arena_allocator<std::byte> allocator)
+            : bindings_(allocator)
+            , by_name_(allocator) {
+        }
+
+        struct binding {
+            std::string_view name;
+            // The first token of the initializer.
+            tokens::const_iterator init;
+            // The initializer's `statement_end`, i.e. where the `let` takes effect.
+            tokens::const_iterator end;
+            bool evaluated = false;
+            double value = 0;
+        };
+
+        // In source order.
+        constexpr void add(
+            std::string_view name, tokens::const_iterator init, tokens::const_iterator end) {
+            bindings_.push_back(binding {.name = name, .init = init, .end = end});
+        }
+
+        // Indexes the `let`s by name. Called once they've all been added, before any `find`.
+        constexpr void index() {
+            by_name_.resize(bindings_.size());
+            for (size_t i = 0; i < by_name_.size(); ++i) {
+                by_name_[i] = static_cast<int32_t>(i);
+            }
+            // Within a name, the bindings stay in source order, as does their `end`.
+            std::ranges::sort(by_name_, [&](int32_t lhs, int32_t rhs) {
+                return std::pair(bindings_[lhs].name, lhs) < std::pair(bindings_[rhs].name, rhs);
+            });
+        }
+
+        // The `let` named `name` which is visible at `at`, or -1 if there is none (e.g. because
+        // `name` is a parameter).
+        constexpr int32_t find(std::string_view name, tokens::const_iterator at) const {
+            // The first binding past those of `name` visible at `at`.
+            const auto past = std::ranges::partition_point(by_name_, [&](int32_t i) {
+                return bindings_[i].name < name
+                    || (bindings_[i].name == name && bindings_[i].end < at);
+            });
+            if (past == by_name_.begin()) return -1;
+            const int32_t latest = *std::prev(past);
+            return bindings_[latest].name == name ? latest : -1;
+        }
+
+        constexpr binding& operator[](int32_t index) {
+            return bindings_[index];
+        }
+
+    private:
+        arena_vector<binding> bindings_;
+        // Indices into `bindings_`, sorted by name and then source order.
+        arena_vector<int32_t> by_name_;
+    };
+
+    constexpr double interpreter::eval_fn(
+        const tokens& source, token from, frame arguments) const {
+        if consteval {
+            return eval_fn_body(source, arguments, source.to_iterator(from));
+        } else {
+            std::array<std::byte, 4096> buffer;
+            arena arena(buffer);
+            return eval_fn(source, from, std::move(arguments), arena);
+        }
+    }
+
+    inline double interpreter::eval_fn(
+        const tokens& source, token from, frame arguments, arena& arena) const {
+        const arena_allocator<std::byte> allocator(&arena);
+        frame frame {
+            .locals = decltype(interpreter::frame::locals)(
+                arguments.locals.begin(), arguments.locals.end(), allocator),
+            .expr_stack = decltype(interpreter::frame::expr_stack)(allocator),
+        };
+        return eval_fn_body(source, frame, source.to_iterator(from));
+    }
+
+    constexpr double interpreter::eval_fn_body(
+        const tokens& source, frame& frame, tokens::const_iterator pos) const {
+        while (source.id(*pos) != token_id::rparen) {
+            assert(source.id(*pos) == token_id::ident);
+            assert(interpreter::find_local(frame, source.string(*pos)) != nullptr);
+            ++pos;
+        }
+        ++pos;
+
+        token_id id = source.id(*pos);
+        if (id == token_id::lbrace) {
+            return eval_block(source, frame, pos);
+        } else {
+            return eval_expr(source, frame, pos);
+        }
+    }
+
+    constexpr double interpreter::eval_block(
+        const tokens& source, frame& frame, tokens::const_iterator& pos) const {
+        assert(source.id(*pos) == token_id::lbrace);
+        ++pos;
+
+        if (lets_ == let_evaluation::lazy && source.has_subtree_sizes()) {
+            lazy_lets lazy(frame.expr_stack.get_allocator());
+            while (source.id(*pos) == token_id::valdef_intro) {
+                const token intro = *pos;
+                ++pos;
+                assert(source.id(*pos) == token_id::ident);
+                const token ident = *pos;
+                ++pos;
+
+                const tokens::const_iterator init = pos;
+                pos += source.subtree_size(intro);
+                assert(source.id(*pos) == token_id::statement_end);
+                lazy.add(source.string(ident), init, pos);
+                ++pos;
+            }
+            lazy.index();
+
+            assert(source.id(*pos) == token_id::return_);
+            ++pos;
+            double result = eval_lazy_expr(source, frame, pos, lazy);
+            assert(source.id(*pos) == token_id::rbrace);
+            ++pos;
+            return result;
+        }
+
+        while (source.id(*pos) == token_id::valdef_intro) {
+            ++pos;
+            assert(source.id(*pos) == token_id::ident);
+            const token ident = *pos;
+            ++pos;
+
+            double result = eval_expr(source, frame, pos);
+            // Only insert after `eval_expr`, to avoid reading an undefined variable.
+            frame.locals.emplace_back(source.string(ident), result);
+        }
+
+        assert(source.id(*pos) == token_id::return_);
+        ++pos;
+        double result = eval_expr(source, frame, pos);
+        assert(source.id(*pos) == token_id::rbrace);
+        ++pos;
+        return result;
+    }
+
+    constexpr double interpreter::eval_expr(
+        const tokens& source, frame& frame, tokens::const_iterator& pos) const {
+        [[maybe_unused]] const size_t base = frame.expr_stack.size();
+
+        while (source.id(*pos) != token_id::statement_end) {
+            token next = *pos;
+            token_id id = source.id(next);
+            ++pos;
+
+            if (id == token_id::ident) {
+                frame.expr_stack.push_back(interpreter::read_local(frame, source.string(next)));
+            } else {
+                interpreter::eval_operand_or_operator(source, frame, next, id);
+            }
+        }
+        ++pos;
+
+        assert(frame.expr_stack.size() == base + 1);
+        double result = frame.expr_stack.back();
+        frame.expr_stack.pop_back();
+        return result;
+    }
+
+    constexpr double interpreter::eval_lazy_expr(const tokens& source, frame& frame,
+        tokens::const_iterator& pos, lazy_lets& lazy) const {
+        // A read of a `let` which hasn't been evaluated yet suspends the expression reading it,
+        // and evaluates the `let`'s initializer on top of the same `expr_stack`. Its value is left
+        // there, as the read's value, once the expression resumes.
+        //
+        // The suspended expressions are kept here rather than on the native stack, since a chain
+        // of `let`s each reading the one before can be as long as the function.
+        struct suspended {
+            // The `let` being evaluated.
+            int32_t binding;
+            // Where the expression which read it resumes.
+            tokens::const_iterator resume;
+        };
+        arena_vector<suspended> suspended_exprs(frame.expr_stack.get_allocator());
+
+        [[maybe_unused]] const size_t base = frame.expr_stack.size();
+        while (true) {
+            if (source.id(*pos) == token_id::statement_end) {
+                ++pos;
+                if (suspended_exprs.empty()) break;
+
+                const suspended done = suspended_exprs.back();
+                suspended_exprs.pop_back();
+                lazy[done.binding].value = frame.expr_stack.back();
+                lazy[done.binding].evaluated = true;
+                pos = done.resume;
+                continue;
+            }
+
+            token next = *pos;
+            token_id id = source.id(next);
+            ++pos;
+
+            if (id != token_id::ident) {
+                interpreter::eval_operand_or_operator(source, frame, next, id);
+                continue;
+            }
+
+            const int32_t index = lazy.find(source.string(next), source.to_iterator(next));
+            if (index == -1) {
+                frame.expr_stack.push_back(interpreter::read_local(frame, source.string(next)));
+            } else if (lazy[index].evaluated) {
+                frame.expr_stack.push_back(lazy[index].value);
+            } else {
+                suspended_exprs.push_back(suspended {.binding = index, .resume = pos});
+                pos = lazy[index].init;
+            }
+        }
+
+        assert(frame.expr_stack.size() == base + 1);
+        double result = frame.expr_stack.back();
+        frame.expr_stack.pop_back();
+        return result;
+    }
+
+    constexpr void interpreter::eval_operand_or_operator(
+        const tokens& source, frame& frame, token next, token_id id) {
+        if (literal_tokens.contains(id)) {
+            frame.expr_stack.push_back(noctern::parse_number(source.string(next)));
+        } else if (operator_tokens.contains(id)) {
+            assert(frame.expr_stack.size() >= 2);
+            double second = frame.expr_stack.back();
+            frame.expr_stack.pop_back();
+            double first = frame.expr_stack.back();
+            frame.expr_stack.pop_back();
+
+            double result = enum_switch(id, [first, second]<token_id id>(val_t<id>) -> double {
+                if constexpr (id == token_id::plus) {
+                    return first + second;
+                } else if constexpr (id == token_id::minus) {
+                    return first - second;
+                } else if constexpr (id == token_id::mult) {
+                    return first * second;
+                } else if constexpr (id == token_id::div) {
+                    return first / second;
+                } else {
+                    assert(false && "not an operation");
+                    return 0;
+                }
+            });
+
+            frame.expr_stack.push_back(result);
+        }
+    }
 }
@@ -2,8 +2,13 @@
 
 #include <catch2/catch.hpp>
 #include <ostream>
+#include <string>
 #include <vector>
 
+#include "noctern/compilation_unit.hpp"
+#include "noctern/count_allocations.test.hpp"
+#include "noctern/parser.hpp"
+#include "noctern/symbol_table.hpp"
 #include "noctern/tokenize.test.hpp"
 
 namespace noctern {
@@ -117,5 +122,110 @@ namespace noctern {
                 .expr_stack = {},
             }) == y + (y - 0.2) + x * 2. - 2 + .1);
         }
+
+        double eval_parsed(std::string_view source, noctern::interpreter::let_evaluation lets,
+            noctern::interpreter::frame arguments) {
+            const noctern::tokens parsed = noctern::parse(noctern::tokenize_all(source));
+            noctern::compilation_unit cu(parsed);
+            noctern::symbol_table st(parsed, cu);
+            noctern::interpreter interpreter(st, lets);
+            return interpreter.eval_fn(parsed, *st.find_fn_decl("f"), std::move(arguments));
+        }
+
+        TEST_CASE("lazy lets evaluate like eager lets") {
+            using enum noctern::interpreter::let_evaluation;
+
+            const std::string_view source = GENERATE(as<std::string_view> {},
+                // Unread `let`s.
+                R"(def f(x, y): {
+                    let unused = x / 0;
+                    let a = x * 2;
+                    let also_unused = a + y;
+                    return a - 1;
+                };)",
+                // `let`s which read other `let`s, some more than once.
+                R"(def f(x, y): {
+                    let a = x - y;
+                    let b = a * a;
+                    let c = b + a / 2;
+                    return c - b * a;
+                };)",
+                // Shadowing, including of parameters.
+                R"(def f(x, y): {
+                    let a = x;
+                    let x = y * 3;
+                    let y = a + x;
+                    let x = x - y;
+                    return x / a + y;
+                };)",
+                // No `let`s at all.
+                R"(def f(x, y): x * y - 1;)");
+
+            const auto arguments = [] {
+                return noctern::interpreter::frame {
+                    .locals = {{"x", 4.5}, {"y", -0.75}},
+                    .expr_stack = {},
+                };
+            };
+
+            CHECK(noctern::eval_parsed(source, lazy, arguments())
+                == noctern::eval_parsed(source, eager, arguments()));
+        }
+
+        TEST_CASE("lazy lets evaluate long chains like eager lets") {
+            using enum noctern::interpreter::let_evaluation;
+
+            // Each `let` reads the one before, so the first read evaluates the whole chain: deeper
+            // than the native stack, were each `let` evaluated by recursing.
+            constexpr int num_lets = 100'000;
+            std::string source = "def f(x, y): {\n    let a = x;\n";
+            for (int i = 0; i < num_lets; ++i) {
+                source += "    let a = a + 1;\n";
+            }
+            source += "    return a * y;\n};";
+
+            const auto arguments = [] {
+                return noctern::interpreter::frame {
+                    .locals = {{"x", 2}, {"y", 0.5}},
+                    .expr_stack = {},
+                };
+            };
+
+            CHECK(noctern::eval_parsed(source, eager, arguments()) == (num_lets + 2) * 0.5);
+            CHECK(noctern::eval_parsed(source, lazy, arguments()) == (num_lets + 2) * 0.5);
+        }
+
+        TEST_CASE("eval_fn doesn't allocate once its arguments are built") {
+            using enum noctern::interpreter::let_evaluation;
+
+            const noctern::tokens parsed = noctern::parse(noctern::tokenize_all(R"(
+                def f(x, y): {
+                    let a = x * 2;
+                    let b = a - y / 3;
+                    let a = a + b;
+                    return a + b * (x - y);
+                };)"));
+            const noctern::compilation_unit cu(parsed);
+            const noctern::symbol_table st(parsed, cu);
+            const noctern::token f = *st.find_fn_decl("f");
+            const noctern::interpreter interpreter(st, GENERATE(eager, lazy));
+
+            constexpr int num_calls = 100;
+            std::vector<noctern::interpreter::frame> arguments;
+            for (int i = 0; i < num_calls; ++i) {
+                arguments.push_back(noctern::interpreter::frame {
+                    .locals = {{"x", i * 0.5}, {"y", 2}},
+                    .expr_stack = {},
+                });
+            }
+
+            double sum = 0;
+            CHECK(noctern::count_allocations([&] {
+                for (noctern::interpreter::frame& frame : arguments) {
+                    sum += interpreter.eval_fn(parsed, f, std::move(frame));
+                }
+            }) == 0);
+            CHECK(sum != 0);
+        }
     }
 }
@@ -0,0 +1,350 @@
+#include "./ir.hpp"
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+
+#include <fmt/format.h>
+
+#include "noctern/number.hpp"
+#include "noctern/tokenize.hpp"
+
+namespace noctern::ir {
+    namespace {
+        opcode opcode_for(token_id id) {
+            switch (id) {
+            case token_id::plus: return opcode::add;
+            case token_id::minus: return opcode::sub;
+            case token_id::mult: return opcode::mul;
+            case token_id::div: return opcode::div;
+            default: assert(false && "not an operation");
+            }
+            return opcode::add;
+        }
+
+        class function_builder {
+        public:
+            explicit function_builder(const tokens& input)
+                : input_(input) {
+            }
+
+            // Builds the function whose `fn_intro` is at `pos`, leaving `pos` after the function.
+            function build(tokens::const_iterator& pos) {
+                assert(input_.id(*pos) == token_id::fn_intro);
+                ++pos;
+                assert(input_.id(*pos) == token_id::ident);
+                fn_.name = input_.string(*pos);
+                ++pos;
+
+                while (input_.id(*pos) != token_id::rparen) {
+                    assert(input_.id(*pos) == token_id::ident);
+                    bindings_[input_.string(*pos)] = add(instruction {
+                        .op = opcode::param,
+                        .args = {fn_.num_params(), -1},
+                    });
+                    fn_.param_names.emplace_back(input_.string(*pos));
+                    ++pos;
+                }
+                ++pos;
+
+                // An expression body's `;` also ends the function; a block is followed by one.
+                if (input_.id(*pos) == token_id::lbrace) {
+                    fn_.result = build_block(pos);
+                    assert(input_.id(*pos) == token_id::statement_end);
+                    ++pos;
+                } else {
+                    fn_.result = build_expr(pos);
+                }
+
+                return std::move(fn_);
+            }
+
+        private:
+            value_id add(instruction instruction) {
+                fn_.instructions.push_back(instruction);
+                return static_cast<value_id>(fn_.instructions.size() - 1);
+            }
+
+            value_id add_constant(double value) {
+                auto [it, inserted] = constants_.try_emplace(std::bit_cast<uint64_t>(value), 0);
+                if (inserted) {
+                    fn_.constants.push_back(value);
+                    it->second = add(instruction {
+                        .op = opcode::constant,
+                        .args = {static_cast<value_id>(fn_.constants.size() - 1), -1},
+                    });
+                }
+                return it->second;
+            }
+
+            value_id build_block(tokens::const_iterator& pos) {
+                assert(input_.id(*pos) == token_id::lbrace);
+                ++pos;
+
+                while (input_.id(*pos) == token_id::valdef_intro) {
+                    ++pos;
+                    assert(input_.id(*pos) == token_id::ident);
+                    const token ident = *pos;
+                    ++pos;
+
+                    value_id result = build_expr(pos);
+                    // Only bind after `build_expr`, so that `let x = x + 1;` reads the outer `x`.
+                    bindings_[input_.string(ident)] = result;
+                }
+
+                assert(input_.id(*pos) == token_id::return_);
+                ++pos;
+                value_id result = build_expr(pos);
+                assert(input_.id(*pos) == token_id::rbrace);
+                ++pos;
+                return result;
+            }
+
+            value_id build_expr(tokens::const_iterator& pos) {
+                assert(expr_stack_.empty());
+
+                while (input_.id(*pos) != token_id::statement_end) {
+                    token next = *pos;
+                    token_id id = input_.id(next);
+                    ++pos;
+
+                    if (id == token_id::ident) {
+                        auto binding = bindings_.find(input_.string(next));
+                        assert(binding != bindings_.end() && "Unknown identifier");
+                        expr_stack_.push_back(binding->second);
+                    } else if (literal_tokens.contains(id)) {
+                        const double literal = noctern::parse_number(input_.string(next));
+                        expr_stack_.push_back(add_constant(literal));
+                    } else {
+                        assert(expr_stack_.size() >= 2);
+                        value_id rhs = expr_stack_.back();
+                        expr_stack_.pop_back();
+                        value_id lhs = expr_stack_.back();
+                        expr_stack_.pop_back();
+
+                        expr_stack_.push_back(add(instruction {
+                            .op = opcode_for(id),
+                            .args = {lhs, rhs},
+                        }));
+                    }
+                }
+                ++pos;
+
+                assert(expr_stack_.size() == 1);
+                value_id result = expr_stack_.back();
+                expr_stack_.pop_back();
+                return result;
+            }
+
+            const tokens& input_;
+
+            function fn_;
+            std::unordered_map<uint64_t, value_id> constants_;
+            std::unordered_map<std::string_view, value_id> bindings_;
+            std::vector<value_id> expr_stack_;
+        };
+    }
+
+    const function* module::find(std::string_view name) const {
+        assert(num_indexed_ == functions.size() && "Call index_functions() after adding functions");
+        if (fn_table_.empty()) return nullptr;
+        const function& fn = functions[fn_table_[(*fn_hash_)(name)]];
+        if (fn.name != name) return nullptr;
+        return &fn;
+    }
+
+    void module::index_functions() {
+        std::vector<std::string_view> names;
+        names.reserve(functions.size());
+        for (const function& fn : functions) {
+            names.push_back(fn.name);
+        }
+        fn_hash_.emplace(names);
+
+        // Duplicates share their index, and only the first is stored there.
+        constexpr uint32_t unset = std::numeric_limits<uint32_t>::max();
+        fn_table_.assign(fn_hash_->size(), unset);
+        for (size_t i = 0; i < functions.size(); ++i) {
+            uint32_t& entry = fn_table_[(*fn_hash_)(functions[i].name)];
+            if (entry == unset) entry = static_cast<uint32_t>(i);
+        }
+        num_indexed_ = functions.size();
+    }
+
+    module build(const tokens& parsed) {
+        module result;
+
+        auto pos = parsed.begin();
+        while (pos != parsed.end()) {
+            result.functions.push_back(function_builder(parsed).build(pos));
+        }
+
+        result.index_functions();
+        return result;
+    }
+
+    double apply(opcode op, double a, double b, double c) {
+        switch (op) {
+        case opcode::add: return a + b;
+        case opcode::sub: return a - b;
+        case opcode::mul: return a * b;
+        case opcode::div: return a / b;
+        case opcode::fma: return std::fma(a, b, c);
+        case opcode::fms: return std::fma(a, b, -c);
+        case opcode::fnma: return std::fma(-a, b, c);
+        default: assert(false && "not an operation");
+        }
+        return 0;
+    }
+
+    rewriter::rewriter(const function& source)
+        : rewriter(source, {}) {
+    }
+
+    rewriter::rewriter(const function& source, std::span<const std::optional<double>> bound)
+        : source_(source)
+        , mapping_(source.instructions.size(), -1) {
+        assert(bound.empty() || bound.size() == static_cast<size_t>(source.num_params()));
+
+        fn_.name = source.name;
+        for (value_id id = 0; id < source.num_params(); ++id) {
+            if (bound.empty() || !bound[id].has_value()) {
+                set_mapping(id, add(opcode::param, fn_.num_params(), -1));
+                fn_.param_names.push_back(source.param_names[id]);
+            }
+        }
+        // Constants come after every parameter, keeping the parameters first.
+        for (value_id id = 0; id < static_cast<value_id>(bound.size()); ++id) {
+            if (bound[id].has_value()) set_mapping(id, add_constant(*bound[id]));
+        }
+    }
+
+    value_id rewriter::copy(value_id source_id) {
+        const instruction& inst = source_.instructions[source_id];
+        switch (inst.op) {
+        case opcode::param: return map(source_id);
+        case opcode::constant: return add_constant(source_.constants[inst.args[0]]);
+        default: break;
+        }
+
+        std::array<value_id, 3> args = {-1, -1, -1};
+        for (int i = 0; i < num_operands(inst.op); ++i) {
+            args[i] = map(inst.args[i]);
+        }
+        return add(inst.op, args[0], args[1], args[2]);
+    }
+
+    value_id rewriter::add(opcode op, value_id a, value_id b, value_id c) {
+        fn_.instructions.push_back(instruction {.op = op, .args = {a, b, c}});
+        return static_cast<value_id>(fn_.instructions.size() - 1);
+    }
+
+    value_id rewriter::add_constant(double value) {
+        auto [it, inserted] = constants_.try_emplace(std::bit_cast<uint64_t>(value), 0);
+        if (inserted) {
+            fn_.constants.push_back(value);
+            it->second
+                = add(opcode::constant, static_cast<value_id>(fn_.constants.size() - 1), -1);
+        }
+        return it->second;
+    }
+
+    function rewriter::finish() && {
+        fn_.result = map(source_.result);
+        return std::move(fn_);
+    }
+
+    function eliminate_dead_code(const function& fn) {
+        const auto num_values = static_cast<value_id>(fn.instructions.size());
+
+        std::vector<bool> live(num_values, false);
+        live[fn.result] = true;
+        for (value_id id = num_values - 1; id >= 0; --id) {
+            if (!live[id]) continue;
+            const instruction& inst = fn.instructions[id];
+            for (int i = 0; i < num_operands(inst.op); ++i) {
+                live[inst.args[i]] = true;
+            }
+        }
+
+        rewriter rewriter(fn);
+        for (value_id id = fn.num_params(); id < num_values; ++id) {
+            if (live[id]) rewriter.set_mapping(id, rewriter.copy(id));
+        }
+        return std::move(rewriter).finish();
+    }
+
+    std::vector<std::string> verify(const function& fn) {
+        std::vector<std::string> errors;
+        const auto num_values = static_cast<value_id>(fn.instructions.size());
+
+        for (value_id id = 0; id < num_values; ++id) {
+            const instruction& inst = fn.instructions[id];
+            const bool is_param_slot = id < fn.num_params();
+
+            if (is_param_slot != (inst.op == opcode::param)) {
+                errors.push_back(fmt::format(
+                    "%{}: parameters must be exactly the first {} instructions", id, fn.num_params()));
+            }
+
+            if (inst.op == opcode::param && inst.args[0] != id) {
+                errors.push_back(fmt::format("%{}: expected `param {}`", id, id));
+            } else if (inst.op == opcode::constant
+                && (inst.args[0] < 0
+                    || inst.args[0] >= static_cast<value_id>(fn.constants.size()))) {
+                errors.push_back(fmt::format("%{}: constant index out of range", id));
+            }
+
+            for (int i = 0; i < num_operands(inst.op); ++i) {
+                if (inst.args[i] < 0 || inst.args[i] >= id) {
+                    errors.push_back(fmt::format(
+                        "%{}: operand %{} is not defined before its use", id, inst.args[i]));
+                }
+            }
+        }
+
+        if (fn.result < 0 || fn.result >= num_values) {
+            errors.push_back(fmt::format("result %{} is not defined", fn.result));
+        }
+
+        return errors;
+    }
+
+    std::string dump(const function& fn) {
+        std::string result = fmt::format("fn {}(", fn.name);
+        for (value_id id = 0; id < fn.num_params(); ++id) {
+            result += fmt::format("{}%{} {}", id == 0 ? "" : ", ", id, fn.param_names[id]);
+        }
+        result += ") {\n";
+
+        for (value_id id = fn.num_params(); id < static_cast<value_id>(fn.instructions.size());
+            ++id) {
+            const instruction& inst = fn.instructions[id];
+
+            result += fmt::format("  %{} = {}", id, stringify(inst.op));
+            if (inst.op == opcode::constant) {
+                result += fmt::format(" {}", fn.constants[inst.args[0]]);
+            } else if (inst.op == opcode::param) {
+                result += fmt::format(" {}", inst.args[0]);
+            }
+            for (int i = 0; i < num_operands(inst.op); ++i) {
+                result += fmt::format("{}%{}", i == 0 ? " " : ", ", inst.args[i]);
+            }
+            result += '\n';
+        }
+
+        result += fmt::format("  return %{}\n}}\n", fn.result);
+        return result;
+    }
+
+    std::string dump(const module& module) {
+        std::string result;
+        for (const function& fn : module.functions) {
+            if (!result.empty()) result += '\n';
+            result += dump(fn);
+        }
+        return result;
+    }
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "noctern/enum.hpp"
+#include "noctern/meta.hpp"
+#include "noctern/perfect_hash.hpp"
+#include "noctern/tokenize.hpp"
+
+// A mid-level SSA representation of Noctern functions.
+//
+// Each function is a flat array of instructions. The value an instruction produces is identified by
+// the instruction's index, so value ids are dense and an instruction's operands always have smaller
+// ids than the instruction itself (Noctern functions are straight-line code).
+namespace noctern::ir {
+    using value_id = int32_t;
+
+    struct _opcode_wrapper {
+        enum class opcode : uint8_t {
+#define NOCTERN_X_OPCODE(X)                                                                        \
+    X(param) /*    %r = param <index> */                                                           \
+    X(constant) /* %r = constant <index into function::constants> */                               \
+    X(add) /*      %r = add %a, %b */                                                              \
+    X(sub) /*      %r = sub %a, %b */                                                              \
+    X(mul) /*      %r = mul %a, %b */                                                              \
+    X(div) /*      %r = div %a, %b */                                                              \
+    X(fma) /*      %r = fma %a, %b, %c  (a * b + c, rounded once) */                               \
+    X(fms) /*      %r = fms %a, %b, %c  (a * b - c, rounded once) */                               \
+    X(fnma) /*     %r = fnma %a, %b, %c (c - a * b, rounded once) */
+#define NOCTERN_MAKE_ENUM_VALUE(name) name,
+            NOCTERN_X_OPCODE(NOCTERN_MAKE_ENUM_VALUE)
+#undef NOCTERN_MAKE_ENUM_VALUE
+        };
+
+    private:
+        friend enum_mixin;
+
+        template <typename Fn>
+        friend constexpr decltype(auto) switch_introspect(opcode op, Fn&& fn) {
+            switch (op) {
+                using enum opcode;
+                NOCTERN_X_OPCODE(NOCTERN_ENUM_X_INTROSPECT)
+            }
+            assert(false);
+            std::unreachable();
+        }
+
+        template <typename Fn>
+        friend constexpr decltype(auto) introspect(type_t<opcode>, Fn&& fn) {
+            using enum opcode;
+            return std::invoke(std::forward<Fn>(fn)
+#define NOCTERN_OPCODE_TYPE(name) , val<name>
+                    NOCTERN_X_OPCODE(NOCTERN_OPCODE_TYPE)
+#undef NOCTERN_OPCODE_TYPE
+            );
+        }
+#undef NOCTERN_X_OPCODE
+    };
+
+    using opcode = _opcode_wrapper::opcode;
+
+    // The number of values which `op` reads.
+    constexpr int num_operands(opcode op) {
+        switch (op) {
+        case opcode::param:
+        case opcode::constant: return 0;
+        case opcode::add:
+        case opcode::sub:
+        case opcode::mul:
+        case opcode::div: return 2;
+        case opcode::fma:
+        case opcode::fms:
+        case opcode::fnma: return 3;
+        }
+        assert(false);
+        std::unreachable();
+    }
+
+    // Computes `op` on constant operands, rounding exactly as evaluation would.
+    double apply(opcode op, double a, double b, double c = 0);
+
+    struct instruction {
+        opcode op;
+        // For `param` and `constant`, `args[0]` is an index rather than a value.
+        std::array<value_id, 3> args = {-1, -1, -1};
+    };
+
+    struct function {
+        std::string name;
+        std::vector<std::string> param_names;
+
+        // The first `param_names.size()` instructions are the parameters, in order.
+        std::vector<instruction> instructions;
+        std::vector<double> constants;
+
+        value_id result = -1;
+
+        int32_t num_params() const {
+            return static_cast<int32_t>(param_names.size());
+        }
+    };
+
+    struct module {
+        std::vector<function> functions;
+
+        // The first function named `name`, or `nullptr`. Looked up in the index which `build`
+        // makes, a perfect hash over the names as in `symbol_table`: after adding or renaming
+        // functions, call `index_functions()` again.
+        const function* find(std::string_view name) const;
+
+        // Indexes `functions` by name, for `find`.
+        void index_functions();
+
+    private:
+        std::optional<perfect_hash> fn_hash_;
+        // Indexed by `fn_hash_`. Holds the index in `functions` of the first function of each
+        // name.
+        std::vector<uint32_t> fn_table_;
+        size_t num_indexed_ = 0;
+    };
+
+    // Builds the IR for every function in the output of `parse`.
+    module build(const tokens& parsed);
+
+    // Builds a new function out of an existing one, for passes which replace instructions.
+    //
+    // Instructions are added in order, so operands stay defined before their uses. Constants are
+    // deduplicated and placed right before their first use.
+    class rewriter {
+    public:
+        // Starts the new function with the same parameters as `source`.
+        explicit rewriter(const function& source);
+
+        // Starts the new function with the parameters of `source` which aren't `bound`; the bound
+        // ones become constants. `bound` has one entry per parameter of `source`.
+        rewriter(const function& source, std::span<const std::optional<double>> bound);
+
+        const function& source() const {
+            return source_;
+        }
+
+        // The new value which replaces `source_id`.
+        value_id map(value_id source_id) const {
+            assert(mapping_[source_id] != -1);
+            return mapping_[source_id];
+        }
+
+        void set_mapping(value_id source_id, value_id new_id) {
+            mapping_[source_id] = new_id;
+        }
+
+        // Copies the source instruction `source_id`, mapping its operands.
+        value_id copy(value_id source_id);
+
+        value_id add(opcode op, value_id a, value_id b, value_id c = -1);
+
+        value_id add_constant(double value);
+
+        const instruction& at(value_id new_id) const {
+            return fn_.instructions[new_id];
+        }
+
+        const double* constant_value(value_id new_id) const {
+            const instruction& inst = at(new_id);
+            if (inst.op != opcode::constant) return nullptr;
+            return &fn_.constants[inst.args[0]];
+        }
+
+        // Finishes the new function, whose result replaces the source's result.
+        function finish() &&;
+
+    private:
+        const function& source_;
+        function fn_;
+        std::vector<value_id> mapping_;
+        std::unordered_map<uint64_t, value_id> constants_;
+    };
+
+    // Removes instructions which don't contribute to the result, renumbering the rest.
+    function eliminate_dead_code(const function& fn);
+
+    // Checks the structural invariants of `fn`. Returns a description of each violation.
+    std::vector<std::string> verify(const function& fn);
+
+    // A human readable listing of the function, e.g.:
+    //
+    //   fn f(%0 x, %1 y) {
+    //     %2 = constant 2
+    //     %3 = mul %0, %2
+    //     %4 = add %3, %1
+    //     return %4
+    //   }
+    std::string dump(const function& fn);
+
+    std::string dump(const module& module);
+}
@@ -0,0 +1,110 @@
+#include "./ir.hpp"
+
+#include <catch2/catch.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "noctern/parser.hpp"
+#include "noctern/tokenize.hpp"
+
+namespace noctern {
+    namespace {
+        TEST_CASE("ir::build produces SSA for blocks") {
+            noctern::tokens parsed = noctern::parse(noctern::tokenize_all(R"(
+                def f(x, y): {
+                    let z = y - 0.2;
+                    let x = x * 2;
+                    return z / x + 2.;
+                };
+            )"));
+            ir::module module = ir::build(parsed);
+
+            REQUIRE(module.functions.size() == 1);
+            const ir::function& fn = module.functions[0];
+
+            CHECK(ir::verify(fn).empty());
+            CHECK(ir::dump(fn)
+                == "fn f(%0 x, %1 y) {\n"
+                   "  %2 = constant 0.2\n"
+                   "  %3 = sub %1, %2\n"
+                   "  %4 = constant 2\n"
+                   "  %5 = mul %0, %4\n"
+                   "  %6 = div %3, %5\n"
+                   "  %7 = add %6, %4\n"
+                   "  return %7\n"
+                   "}\n");
+        }
+
+        TEST_CASE("ir::build handles expression bodies and multiple functions") {
+            noctern::tokens parsed = noctern::parse(noctern::tokenize_all(R"(
+                def one(): 1;
+                def twice(x): x + x;
+            )"));
+            ir::module module = ir::build(parsed);
+
+            REQUIRE(module.functions.size() == 2);
+            CHECK(ir::dump(module)
+                == "fn one() {\n"
+                   "  %0 = constant 1\n"
+                   "  return %0\n"
+                   "}\n"
+                   "\n"
+                   "fn twice(%0 x) {\n"
+                   "  %1 = add %0, %0\n"
+                   "  return %1\n"
+                   "}\n");
+
+            REQUIRE(module.find("twice") != nullptr);
+            CHECK(module.find("twice")->num_params() == 1);
+            CHECK(module.find("missing") == nullptr);
+        }
+
+        TEST_CASE("ir::module finds the first function of each name") {
+            std::string source = "def f(): 1; def f(x): x;";
+            for (int i = 0; i < 1000; ++i) {
+                source += fmt::format(" def g{}(): {};", i, i);
+            }
+            ir::module module = ir::build(noctern::parse(noctern::tokenize_all(source)));
+
+            REQUIRE(module.find("f") != nullptr);
+            CHECK(module.find("f")->num_params() == 0);
+            for (int i = 0; i < 1000; ++i) {
+                const ir::function* fn = module.find(fmt::format("g{}", i));
+                REQUIRE(fn != nullptr);
+                CHECK(fn->name == fmt::format("g{}", i));
+            }
+            CHECK(module.find("g1000") == nullptr);
+
+            ir::function added;
+            added.name = "h";
+            module.functions.push_back(std::move(added));
+            module.index_functions();
+            CHECK(module.find("h") == &module.functions.back());
+        }
+
+        TEST_CASE("ir::verify reports malformed functions") {
+            ir::function fn {
+                .name = "broken",
+                .param_names = {"x"},
+                .instructions = {
+                    {.op = ir::opcode::param, .args = {0, -1}},
+                    {.op = ir::opcode::add, .args = {0, 2}},
+                    {.op = ir::opcode::constant, .args = {3, -1}},
+                },
+                .constants = {1.0},
+                .result = 5,
+            };
+
+            std::vector<std::string> errors = ir::verify(fn);
+            CHECK_THAT(errors,
+                Catch::Matchers::Equals(std::vector<std::string>({
+                    "%1: operand %2 is not defined before its use",
+                    "%2: constant index out of range",
+                    "result %5 is not defined",
+                })));
+        }
+    }
+}
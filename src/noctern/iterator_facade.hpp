@@ -44,37 +44,37 @@ namespace noctern {
     template <typename Derived>
     class iterator_facade {
     public:
-        decltype(auto) operator*() const {
+        constexpr decltype(auto) operator*() const {
             return self().read();
         }
 
         template <typename Diff>
-        decltype(auto) operator[](Diff offset) const
+        constexpr decltype(auto) operator[](Diff offset) const
             requires(iterator_facade_internal::is_diff_type<Derived, Diff>
                 && iterator_facade_internal::can_advance<Derived>)
         {
             return *(self() + iterator_facade_internal::diff_type<Derived> {offset});
         }
 
-        auto operator->() const
+        constexpr auto operator->() const
             requires(std::is_reference_v<decltype(**this)>)
         {
             return std::addressof(**this);
         }
 
-        Derived& operator++() {
+        constexpr Derived& operator++() {
             self().advance(val<iterator_facade_internal::diff_type<Derived> {1}>);
             return self();
         }
 
-        Derived operator++(int) {
+        constexpr Derived operator++(int) {
             Derived cpy = self();
             ++self();
             return cpy;
         }
 
         template <typename Diff>
-        Derived& operator+=(Diff diff)
+        constexpr Derived& operator+=(Diff diff)
             requires(iterator_facade_internal::is_diff_type<Derived, Diff>
                 && iterator_facade_internal::can_advance<Derived>)
         {
@@ -83,7 +83,7 @@ namespace noctern {
         }
 
         template <typename Diff>
-        friend Derived operator+(const Derived& self, Diff diff)
+        friend constexpr Derived operator+(const Derived& self, Diff diff)
             requires(iterator_facade_internal::is_diff_type<Derived, Diff>
                 && iterator_facade_internal::can_advance<Derived>)
         {
@@ -93,21 +93,21 @@ namespace noctern {
         }
 
         template <typename Diff>
-        friend Derived operator+(Diff diff, const Derived& self)
+        friend constexpr Derived operator+(Diff diff, const Derived& self)
             requires(iterator_facade_internal::is_diff_type<Derived, Diff>
                 && iterator_facade_internal::can_advance<Derived>)
         {
             return self + diff;
         }
 
-        Derived& operator--()
+        constexpr Derived& operator--()
             requires iterator_facade_internal::can_decrement<Derived>
         {
             self().advance(val<iterator_facade_internal::diff_type<Derived> {-1}>);
             return self();
         }
 
-        Derived operator--(int)
+        constexpr Derived operator--(int)
             requires iterator_facade_internal::can_decrement<Derived>
         {
             Derived cpy = self();
@@ -116,7 +116,7 @@ namespace noctern {
         }
 
         template <typename Diff>
-        Derived& operator-=(Diff diff)
+        constexpr Derived& operator-=(Diff diff)
             requires(iterator_facade_internal::is_diff_type<Derived, Diff>
                 && iterator_facade_internal::can_advance<Derived>)
         {
@@ -124,7 +124,7 @@ namespace noctern {
         }
 
         template <typename Diff>
-        friend Derived operator-(const Derived& self, Diff diff)
+        friend constexpr Derived operator-(const Derived& self, Diff diff)
             requires(iterator_facade_internal::is_diff_type<Derived, Diff>
                 && iterator_facade_internal::can_advance<Derived>)
         {
@@ -133,37 +133,37 @@ namespace noctern {
             return cpy;
         }
 
-        friend auto operator-(const Derived& lhs, const Derived& rhs)
+        friend constexpr auto operator-(const Derived& lhs, const Derived& rhs)
             requires(iterator_facade_internal::can_compute_distance<Derived>)
         {
-            return lhs.distance(rhs);
+            return rhs.distance(lhs);
         }
 
-        friend bool operator==(const Derived& lhs, const Derived& rhs)
+        friend constexpr bool operator==(const Derived& lhs, const Derived& rhs)
             requires(iterator_facade_internal::can_compute_equal_to<Derived>)
         {
             return lhs.equal_to(rhs);
         }
 
-        friend bool operator==(const Derived& lhs, const Derived& rhs)
+        friend constexpr bool operator==(const Derived& lhs, const Derived& rhs)
             requires(iterator_facade_internal::can_compute_distance<Derived>
                 && !iterator_facade_internal::can_compute_equal_to<Derived>)
         {
             return lhs.distance(rhs) == 0;
         }
 
-        friend auto operator<=>(const Derived& lhs, const Derived& rhs)
+        friend constexpr auto operator<=>(const Derived& lhs, const Derived& rhs)
             requires(iterator_facade_internal::can_compute_distance<Derived>)
         {
             return rhs.distance(lhs) <=> 0;
         }
 
     private:
-        Derived& self() {
+        constexpr Derived& self() {
             return static_cast<Derived&>(*this);
         }
 
-        const Derived& self() const {
+        constexpr const Derived& self() const {
             return static_cast<const Derived&>(*this);
         }
     };
@@ -145,6 +145,10 @@ namespace noctern {
                 CHECK_FALSE(rand_ints(1) < rand_ints(1));
                 CHECK(rand_ints(1) < rand_ints(2));
             }
+            SECTION("difference") {
+                CHECK(rand_ints(5) - rand_ints(2) == 3);
+                CHECK(rand_ints(2) - rand_ints(5) == -3);
+            }
         }
 
         TEST_CASE("std::iterator_traits<iterator_facade>") {
@@ -0,0 +1,51 @@
+#include "./lazy_module.hpp"
+
+#include <catch2/catch.hpp>
+#include <string>
+
+#include <fmt/format.h>
+
+#include "noctern/compilation_unit.hpp"
+#include "noctern/interpreter.hpp"
+#include "noctern/parser.hpp"
+#include "noctern/symbol_table.hpp"
+#include "noctern/tokenize.hpp"
+#include "noctern/value_numbering.hpp"
+
+namespace noctern {
+    namespace {
+        // A large generated module, of which `Main` is the only function used.
+        std::string generated_module(int num_fns) {
+            std::string source;
+            for (int i = 0; i < num_fns; ++i) {
+                source += fmt::format(
+                    "def f{}(x, y): {{ let a = x * {}; let b = a - y / 3; return a + b * 2; }};\n",
+                    i, i);
+            }
+            source += "def Main(): { let q = 2; return q * 3; };\n";
+            return source;
+        }
+
+        TEST_CASE("startup latency of evaluating Main", "[benchmark]") {
+            const int num_fns = GENERATE(100, 10000);
+            const std::string source = noctern::generated_module(num_fns);
+
+            BENCHMARK(fmt::format("eager, {} functions", num_fns)) {
+                const tokens parsed = noctern::eliminate_common_subexpressions(
+                    noctern::parse(noctern::tokenize_all(source)));
+                const compilation_unit unit(parsed);
+                symbol_table symbols(parsed, unit);
+                const token main = *symbols.find_fn_decl("Main");
+                return interpreter(std::move(symbols))
+                    .eval_fn(parsed, main, interpreter::frame {});
+            };
+
+            BENCHMARK(fmt::format("lazy, {} functions", num_fns)) {
+                lazy_module module(source);
+                const auto main = *module.find_fn_decl("Main");
+                return interpreter(main.symbols)
+                    .eval_fn(main.tokens, main.decl, interpreter::frame {});
+            };
+        }
+    }
+}
@@ -0,0 +1,123 @@
+#include "./lazy_module.hpp"
+
+#include <cassert>
+#include <utility>
+
+#include "noctern/compilation_unit.hpp"
+#include "noctern/parser.hpp"
+#include "noctern/value_numbering.hpp"
+
+namespace noctern {
+    namespace {
+        // Matches the tokenizer's identifiers.
+        constexpr bool is_ident_char(char c) {
+            return ('0' <= c && c <= '9') || ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z')
+                || c == '_';
+        }
+
+        constexpr bool is_space(char c) {
+            return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+        }
+
+        constexpr std::string_view def_keyword = spelling(token_id::fn_intro);
+
+        // The offset of the next `def` keyword at or after `from`, or `npos`.
+        //
+        // The language has no comments or string literals, so any `def` which isn't part of a
+        // longer identifier is the keyword.
+        size_t find_def(std::string_view source, size_t from) {
+            while (true) {
+                const size_t at = source.find(def_keyword, from);
+                if (at == std::string_view::npos) return at;
+
+                const size_t end = at + def_keyword.size();
+                if ((at == 0 || !noctern::is_ident_char(source[at - 1]))
+                    && (end == source.size() || !noctern::is_ident_char(source[end]))) {
+                    return at;
+                }
+                from = end;
+            }
+        }
+
+        // The name following the `def` at the start of `fn`.
+        std::string_view fn_name(std::string_view fn) {
+            size_t begin = def_keyword.size();
+            while (begin < fn.size() && noctern::is_space(fn[begin])) {
+                ++begin;
+            }
+            size_t end = begin;
+            while (end < fn.size() && noctern::is_ident_char(fn[end])) {
+                ++end;
+            }
+            return fn.substr(begin, end - begin);
+        }
+    }
+
+    lazy_module::parsed_function::parsed_function(std::string_view source)
+        : text(source)
+        , tokens(noctern::eliminate_common_subexpressions(
+              noctern::parse(noctern::tokenize_all(text, &arena))))
+        , symbols(tokens, compilation_unit(tokens)) {
+    }
+
+    lazy_module::lazy_module(std::string_view source) {
+        prescan(source);
+    }
+
+    void lazy_module::prescan(std::string_view source) {
+        size_t begin = noctern::find_def(source, 0);
+        while (begin != std::string_view::npos) {
+            const size_t end = noctern::find_def(source, begin + def_keyword.size());
+            std::string_view fn = source.substr(
+                begin, end == std::string_view::npos ? std::string_view::npos : end - begin);
+            // So that a function doesn't change with the spacing before the next one.
+            while (noctern::is_space(fn.back())) {
+                fn.remove_suffix(1);
+            }
+            functions_.try_emplace(noctern::fn_name(fn), entry {.source = fn, .parsed = nullptr});
+            begin = end;
+        }
+    }
+
+    size_t lazy_module::reload(std::string_view source) {
+        // Keyed by names from the parsed functions' own copies, as the old source may be gone.
+        std::unordered_map<std::string_view, std::unique_ptr<const parsed_function>> parsed;
+        for (auto& [name, entry] : functions_) {
+            if (entry.parsed == nullptr) continue;
+            const std::string_view own_name = noctern::fn_name(entry.parsed->text);
+            parsed.try_emplace(own_name, std::move(entry.parsed));
+        }
+        functions_.clear();
+        prescan(source);
+
+        num_parsed_ = 0;
+        for (auto& [name, entry] : functions_) {
+            auto old = parsed.find(name);
+            if (old == parsed.end() || old->second->text != entry.source) continue;
+
+            entry.parsed = std::move(old->second);
+            parsed.erase(old);
+            ++num_parsed_;
+        }
+        return parsed.size();
+    }
+
+    std::optional<lazy_module::function> lazy_module::find_fn_decl(std::string_view name) {
+        auto it = functions_.find(name);
+        if (it == functions_.end()) return std::nullopt;
+
+        entry& entry = it->second;
+        if (entry.parsed == nullptr) {
+            entry.parsed = std::make_unique<const parsed_function>(entry.source);
+            ++num_parsed_;
+        }
+
+        std::optional<token> decl = entry.parsed->symbols.find_fn_decl(name);
+        assert(decl.has_value());
+        return function {
+            .tokens = entry.parsed->tokens,
+            .symbols = entry.parsed->symbols,
+            .decl = *decl,
+        };
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "noctern/arena.hpp"
+#include "noctern/symbol_table.hpp"
+#include "noctern/tokenize.hpp"
+
+namespace noctern {
+    // A module whose functions are only tokenized and parsed when first looked up.
+    //
+    // Construction only prescans the source text for the `def` of each function, which is much
+    // cheaper than tokenizing it. A function extends from its `def` to the next one, since
+    // functions don't nest. So a program which only calls a few functions of a large module only
+    // pays for those.
+    //
+    // Not thread safe.
+    class lazy_module {
+    public:
+        // `source` must outlive the module, or until the next `reload`.
+        explicit lazy_module(std::string_view source);
+
+        lazy_module(const lazy_module&) = delete;
+        lazy_module& operator=(const lazy_module&) = delete;
+        lazy_module(lazy_module&&) = default;
+        lazy_module& operator=(lazy_module&&) = default;
+
+        // A parsed function, which stays valid for the lifetime of the module.
+        struct function {
+            // Only the function itself, parsed and optimized.
+            const noctern::tokens& tokens;
+            const symbol_table& symbols;
+            token decl;
+        };
+
+        // Parses the function the first time it's looked up. If there are several functions of
+        // the same name, finds the first.
+        std::optional<function> find_fn_decl(std::string_view name);
+
+        // Replaces the source, e.g. after the file was edited.
+        //
+        // Parsed functions whose text is unchanged are kept; the rest are parsed again on their
+        // next lookup. So the work after an edit is proportional to the functions which changed,
+        // besides one prescan of the new source. Returns the number of parsed functions which were
+        // discarded.
+        //
+        // Invalidates the `function`s handed out so far.
+        size_t reload(std::string_view source);
+
+        size_t num_functions() const {
+            return functions_.size();
+        }
+
+        size_t num_parsed() const {
+            return num_parsed_;
+        }
+
+    private:
+        void prescan(std::string_view source);
+
+        struct parsed_function {
+            explicit parsed_function(std::string_view source);
+
+            // A copy of the function's source, which `tokens` refers into. Lets the parse outlive
+            // the source it came from, and tells `reload` whether the function changed.
+            std::string text;
+            // Sized for a typical function, which then needs only the one allocation.
+            noctern::arena arena {4096};
+            noctern::tokens tokens;
+            symbol_table symbols;
+        };
+
+        struct entry {
+            // From the `def` up to the next `def`, less trailing spaces.
+            std::string_view source;
+            // Allocated separately, so that it doesn't move as `functions_` grows.
+            std::unique_ptr<const parsed_function> parsed;
+        };
+
+        std::unordered_map<std::string_view, entry> functions_;
+        size_t num_parsed_ = 0;
+    };
+}
@@ -0,0 +1,93 @@
+#include "./lazy_module.hpp"
+
+#include <catch2/catch.hpp>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "noctern/compilation_unit.hpp"
+#include "noctern/interpreter.hpp"
+#include "noctern/parser.hpp"
+#include "noctern/symbol_table.hpp"
+#include "noctern/tokenize.test.hpp"
+
+namespace noctern {
+    namespace {
+        // Functions whose names contain `def`, or are split over lines, mustn't confuse the
+        // prescan.
+        constexpr std::string_view source = R"(def f(x, y): x * y - 1;
+def   undefined(x): { let define = x + 2; return define * x; };
+def
+    g_def(x, y): {
+        let a = x - y;
+        return a / 2;
+    };
+def f(x): x;
+def h(): 4.5;)";
+
+        double eval(const tokens& tokens, const symbol_table& symbols, token decl) {
+            return interpreter(symbols).eval_fn(tokens, decl,
+                interpreter::frame {.locals = {{"x", 3}, {"y", 0.5}}, .expr_stack = {}});
+        }
+
+        TEST_CASE("lazy_module only parses what's looked up") {
+            lazy_module module(source);
+            CHECK(module.num_functions() == 4);
+            CHECK(module.num_parsed() == 0);
+
+            REQUIRE(module.find_fn_decl("undefined").has_value());
+            CHECK(module.num_parsed() == 1);
+            REQUIRE(module.find_fn_decl("undefined").has_value());
+            CHECK(module.num_parsed() == 1);
+
+            CHECK_FALSE(module.find_fn_decl("define").has_value());
+            CHECK_FALSE(module.find_fn_decl("def").has_value());
+            CHECK_FALSE(module.find_fn_decl("missing").has_value());
+            CHECK(module.num_parsed() == 1);
+        }
+
+        TEST_CASE("lazy_module evaluates like the whole module") {
+            const tokens parsed = noctern::parse(noctern::tokenize_all(source));
+            const compilation_unit unit(parsed);
+            const symbol_table symbols(parsed, unit);
+
+            lazy_module module(source);
+            for (std::string_view name : {"f", "undefined", "g_def", "h"}) {
+                INFO(name);
+                std::optional<lazy_module::function> fn = module.find_fn_decl(name);
+                REQUIRE(fn.has_value());
+                CHECK(noctern::eval(fn->tokens, fn->symbols, fn->decl)
+                    == noctern::eval(parsed, symbols, *symbols.find_fn_decl(name)));
+            }
+        }
+
+        TEST_CASE("lazy_module::reload keeps unchanged functions parsed") {
+            std::string original(source);
+            lazy_module module(original);
+            for (std::string_view name : {"f", "undefined", "g_def", "h"}) {
+                REQUIRE(module.find_fn_decl(name).has_value());
+            }
+            CHECK(module.num_parsed() == 4);
+
+            // Only `g_def` changes; the old source is gone by the time it's reloaded.
+            std::string edited = original;
+            edited.replace(edited.find("a / 2"), 5, "a / 4");
+            original.assign(original.size(), '#');
+            CHECK(module.reload(edited) == 1);
+            CHECK(module.num_parsed() == 3);
+            CHECK(module.num_functions() == 4);
+
+            std::optional<lazy_module::function> g = module.find_fn_decl("g_def");
+            REQUIRE(g.has_value());
+            CHECK(module.num_parsed() == 4);
+            CHECK(noctern::eval(g->tokens, g->symbols, g->decl) == 2.5 / 4);
+
+            // Removed and added functions.
+            const std::string replaced = "def h(): 4.5;\ndef k(x): x;";
+            CHECK(module.reload(replaced) == 3);
+            CHECK(module.num_parsed() == 1);
+            CHECK_FALSE(module.find_fn_decl("f").has_value());
+            CHECK(module.find_fn_decl("k").has_value());
+        }
+    }
+}
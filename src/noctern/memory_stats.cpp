@@ -0,0 +1,42 @@
+#include "./memory_stats.hpp"
+
+#include <fmt/format.h>
+
+#include <sys/resource.h>
+
+namespace noctern {
+    namespace {
+        // Bytes per source byte and per token, e.g. "2.31 B/source byte, 17.0 B/token".
+        std::string ratios(size_t bytes, size_t source_bytes, size_t num_tokens) {
+            const auto per = [&](size_t count) {
+                return count == 0 ? 0.0 : static_cast<double>(bytes) / static_cast<double>(count);
+            };
+            return fmt::format(
+                "{:.2f} B/source byte, {:.1f} B/token", per(source_bytes), per(num_tokens));
+        }
+    }
+
+    size_t peak_rss() {
+        rusage usage;
+        if (::getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+        // In KiB on Linux.
+        return static_cast<size_t>(usage.ru_maxrss) * 1024;
+    }
+
+    std::string format_bytes(size_t bytes) {
+        const auto value = static_cast<double>(bytes);
+        if (bytes < 1024) return fmt::format("{} B", bytes);
+        if (bytes < 1024 * 1024) return fmt::format("{:.1f} KiB", value / 1024);
+        if (bytes < 1024 * 1024 * 1024) return fmt::format("{:.1f} MiB", value / (1024 * 1024));
+        return fmt::format("{:.2f} GiB", value / (1024 * 1024 * 1024));
+    }
+
+    std::string format_memory_sample(
+        const memory_sample& sample, size_t source_bytes, size_t num_tokens) {
+        return fmt::format("retained {} ({}), allocated {} in {} allocations ({})",
+            noctern::format_bytes(sample.retained),
+            noctern::ratios(sample.retained, source_bytes, num_tokens),
+            noctern::format_bytes(sample.allocated), sample.num_allocations,
+            noctern::ratios(sample.allocated, source_bytes, num_tokens));
+    }
+}
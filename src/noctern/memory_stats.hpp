@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+#include "noctern/arena.hpp"
+
+namespace noctern {
+    // The memory of one phase of a compilation, e.g. tokenizing.
+    struct memory_sample {
+        // What the phase's results hold on to, from their `memory_usage()`.
+        size_t retained = 0;
+        // What the phase allocated from its arena, including space which containers outgrew.
+        size_t allocated = 0;
+        size_t num_allocations = 0;
+    };
+
+    // What `fn` allocates from `arena`. `retained` is left for the caller, who knows the results.
+    template <typename Fn>
+    memory_sample measure_allocations(const arena& arena, Fn&& fn) {
+        const size_t allocated = arena.bytes_allocated();
+        const size_t num_allocations = arena.num_allocations();
+        std::forward<Fn>(fn)();
+        return memory_sample {
+            .allocated = arena.bytes_allocated() - allocated,
+            .num_allocations = arena.num_allocations() - num_allocations,
+        };
+    }
+
+    // The most memory this process has had resident at once, in bytes.
+    size_t peak_rss();
+
+    // E.g. "1.5 MiB".
+    std::string format_bytes(size_t bytes);
+
+    // The sample, and per byte of source and per token, e.g.
+    // "retained 1.1 MiB (2.31 B/source byte, 17.0 B/token), allocated ...".
+    std::string format_memory_sample(
+        const memory_sample& sample, size_t source_bytes, size_t num_tokens);
+}
@@ -0,0 +1,61 @@
+#include "./memory_stats.hpp"
+
+#include <catch2/catch.hpp>
+#include <optional>
+#include <string_view>
+#include <utility>
+
+#include "noctern/arena.hpp"
+#include "noctern/compilation_unit.hpp"
+#include "noctern/parser.hpp"
+#include "noctern/symbol_table.hpp"
+#include "noctern/tokenize.hpp"
+
+namespace noctern {
+    namespace {
+        TEST_CASE("measure_allocations counts what the phase allocated from the arena") {
+            const std::string_view source = "def f(x): { let y = x * 2; return y + 1; };";
+            arena arena;
+
+            std::optional<tokens> lexed;
+            memory_sample lex = noctern::measure_allocations(
+                arena, [&] { lexed.emplace(noctern::tokenize_all(source, &arena)); });
+            lex.retained = lexed->memory_usage();
+            CHECK(lex.num_allocations > 0);
+            CHECK(lex.retained >= lexed->num_tokens() * (1 + sizeof(std::string_view)));
+            // Vectors leave their outgrown storage behind in the arena.
+            CHECK(lex.allocated >= lex.retained);
+
+            std::optional<tokens> parsed;
+            memory_sample parse = noctern::measure_allocations(
+                arena, [&] { parsed.emplace(noctern::parse(std::move(*lexed))); });
+            parse.retained = parsed->memory_usage();
+            // The `let` records its subtree size, so the parse needs a table of them.
+            CHECK(parse.allocated > 0);
+            CHECK(parse.retained > lex.retained);
+
+            const compilation_unit unit(*parsed);
+            const symbol_table symbols(*parsed, unit);
+            CHECK(unit.memory_usage() >= sizeof(token));
+            CHECK(symbols.memory_usage() > 0);
+
+            // Nothing else touches the arena.
+            CHECK(noctern::measure_allocations(arena, [] {}).allocated == 0);
+        }
+
+        TEST_CASE("peak_rss is at least what's resident") {
+            CHECK(noctern::peak_rss() > 0);
+        }
+
+        TEST_CASE("format_memory_sample reports per source byte and per token") {
+            CHECK(noctern::format_bytes(512) == "512 B");
+            CHECK(noctern::format_bytes(1536) == "1.5 KiB");
+            CHECK(noctern::format_bytes(3 * 1024 * 1024) == "3.0 MiB");
+
+            const memory_sample sample {.retained = 1000, .allocated = 2048, .num_allocations = 4};
+            CHECK(noctern::format_memory_sample(sample, 500, 100)
+                == "retained 1000 B (2.00 B/source byte, 10.0 B/token), allocated 2.0 KiB in 4 "
+                   "allocations (4.10 B/source byte, 20.5 B/token)");
+        }
+    }
+}
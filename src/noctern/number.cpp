@@ -0,0 +1 @@
+#include "./number.hpp"
\ No newline at end of file
@@ -0,0 +1,252 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace noctern {
+    namespace number_internal {
+        // Exactly representable powers of ten.
+        constexpr std::array<double, 23> exact_powers_of_10 = [] {
+            std::array<double, 23> result;
+            double power = 1;
+            for (double& p : result) {
+                p = power;
+                power *= 10;
+            }
+            return result;
+        }();
+
+        // An unsigned integer of any size, little endian in 32-bit limbs. Just enough for
+        // `parse_number`'s slow path.
+        class big_uint {
+        public:
+            constexpr explicit big_uint(uint32_t value = 0) {
+                if (value != 0) limbs_.push_back(value);
+            }
+
+            constexpr bool is_zero() const {
+                return limbs_.empty();
+            }
+
+            constexpr size_t bit_width() const {
+                if (limbs_.empty()) return 0;
+                return (limbs_.size() - 1) * 32 + std::bit_width(limbs_.back());
+            }
+
+            constexpr void multiply_add(uint32_t factor, uint32_t addend) {
+                uint64_t carry = addend;
+                for (uint32_t& limb : limbs_) {
+                    const uint64_t product = static_cast<uint64_t>(limb) * factor + carry;
+                    limb = static_cast<uint32_t>(product);
+                    carry = product >> 32;
+                }
+                if (carry != 0) limbs_.push_back(static_cast<uint32_t>(carry));
+            }
+
+            constexpr void shift_left(size_t bits) {
+                if (limbs_.empty()) return;
+                const size_t limb_shift = bits / 32;
+                const unsigned bit_shift = bits % 32;
+                if (bit_shift != 0) {
+                    uint32_t carry = 0;
+                    for (uint32_t& limb : limbs_) {
+                        const uint32_t next_carry = limb >> (32 - bit_shift);
+                        limb = (limb << bit_shift) | carry;
+                        carry = next_carry;
+                    }
+                    if (carry != 0) limbs_.push_back(carry);
+                }
+                limbs_.insert(limbs_.begin(), limb_shift, 0);
+            }
+
+            friend constexpr int compare(const big_uint& lhs, const big_uint& rhs) {
+                if (lhs.limbs_.size() != rhs.limbs_.size()) {
+                    return lhs.limbs_.size() < rhs.limbs_.size() ? -1 : 1;
+                }
+                for (size_t i = lhs.limbs_.size(); i-- > 0;) {
+                    if (lhs.limbs_[i] != rhs.limbs_[i]) {
+                        return lhs.limbs_[i] < rhs.limbs_[i] ? -1 : 1;
+                    }
+                }
+                return 0;
+            }
+
+            // Requires `*this >= rhs`.
+            constexpr void subtract(const big_uint& rhs) {
+                int64_t borrow = 0;
+                for (size_t i = 0; i < limbs_.size(); ++i) {
+                    int64_t difference = static_cast<int64_t>(limbs_[i]) - borrow
+                        - (i < rhs.limbs_.size() ? rhs.limbs_[i] : 0);
+                    borrow = difference < 0;
+                    limbs_[i] = static_cast<uint32_t>(difference + (borrow << 32));
+                }
+                assert(borrow == 0);
+                while (!limbs_.empty() && limbs_.back() == 0) {
+                    limbs_.pop_back();
+                }
+            }
+
+        private:
+            std::vector<uint32_t> limbs_;
+        };
+
+        constexpr void multiply_by_power_of_10(big_uint& value, size_t exponent) {
+            for (; exponent >= 9; exponent -= 9) {
+                value.multiply_add(1'000'000'000, 0);
+            }
+            value.multiply_add(static_cast<uint32_t>(exact_powers_of_10[exponent]), 0);
+        }
+
+        // Enough significant digits to round any literal correctly: the halfway points between
+        // doubles have at most 767.
+        constexpr size_t max_significant_digits = 800;
+
+        // Correctly rounds the literal's digits over its power of ten by long division.
+        constexpr double parse_slow(std::string_view literal) {
+            // The literal is `significand * 10^exponent`, keeping only the first
+            // `max_significant_digits` digits so that the work is linear in its length. If any
+            // dropped digit isn't 0, a 1 is appended instead: that lies between the same two
+            // halfway points as the literal, since they have fewer digits.
+            big_uint significand;
+            uint32_t chunk = 0;
+            size_t chunk_digits = 0;
+            size_t num_digits = 0;
+            int64_t exponent = 0;
+            bool in_fraction = false;
+            bool dropped_nonzero = false;
+            const auto append_digit = [&](uint32_t digit) {
+                chunk = chunk * 10 + digit;
+                ++num_digits;
+                if (++chunk_digits == 9) {
+                    significand.multiply_add(1'000'000'000, chunk);
+                    chunk = 0;
+                    chunk_digits = 0;
+                }
+            };
+            for (char c : literal) {
+                if (c == '.') {
+                    in_fraction = true;
+                } else if (num_digits == 0 && c == '0') {
+                    exponent -= in_fraction;
+                } else if (num_digits < max_significant_digits) {
+                    append_digit(static_cast<uint32_t>(c - '0'));
+                    exponent -= in_fraction;
+                } else {
+                    dropped_nonzero |= c != '0';
+                    exponent += !in_fraction;
+                }
+            }
+            if (num_digits == 0) return 0;
+            if (dropped_nonzero) {
+                append_digit(1);
+                --exponent;
+            }
+            significand.multiply_add(
+                static_cast<uint32_t>(exact_powers_of_10[chunk_digits]), chunk);
+
+            // The literal is at least 10^(num_digits - 1 + exponent) and below 10^(num_digits +
+            // exponent), so these are out of range whatever the digits. This also bounds the
+            // powers of ten below.
+            const int64_t magnitude = static_cast<int64_t>(num_digits) + exponent;
+            if (magnitude <= -324) return 0;
+            if (magnitude > 309) return std::bit_cast<double>(uint64_t(0x7ff) << 52);
+
+            big_uint numerator = std::move(significand);
+            big_uint denominator(1);
+            if (exponent > 0) {
+                number_internal::multiply_by_power_of_10(numerator, static_cast<size_t>(exponent));
+            } else {
+                number_internal::multiply_by_power_of_10(
+                    denominator, static_cast<size_t>(-exponent));
+            }
+
+            // Scale so that the quotient has 54 or 55 bits: 53 for the mantissa, and the rest to
+            // round with.
+            const int scale = 54
+                - (static_cast<int>(numerator.bit_width())
+                    - static_cast<int>(denominator.bit_width()));
+            if (scale > 0) {
+                numerator.shift_left(static_cast<size_t>(scale));
+            } else {
+                denominator.shift_left(static_cast<size_t>(-scale));
+            }
+
+            uint64_t quotient = 0;
+            for (int bit = 54; bit >= 0; --bit) {
+                big_uint shifted = denominator;
+                shifted.shift_left(static_cast<size_t>(bit));
+                if (compare(numerator, shifted) >= 0) {
+                    numerator.subtract(shifted);
+                    quotient |= uint64_t(1) << bit;
+                }
+            }
+            const bool inexact = !numerator.is_zero();
+
+            // The literal is in [2^binary_exponent, 2^(binary_exponent + 1)). Below 2^-1022, it's
+            // subnormal, with fewer bits of mantissa.
+            const int binary_exponent = std::bit_width(quotient) - 1 - scale;
+            int extra_bits = std::bit_width(quotient) - 53;
+            assert(extra_bits == 1 || extra_bits == 2);
+            if (binary_exponent < -1022) extra_bits += -1022 - binary_exponent;
+            // Less than half of the smallest subnormal.
+            if (extra_bits >= 64) return 0;
+
+            // Round half to even, once.
+            uint64_t mantissa = quotient >> extra_bits;
+            const uint64_t rest = quotient & ((uint64_t(1) << extra_bits) - 1);
+            const uint64_t half = uint64_t(1) << (extra_bits - 1);
+            if (rest > half || (rest == half && (inexact || (mantissa & 1) != 0))) {
+                ++mantissa;
+            }
+
+            // Assemble the bits, rather than scaling `mantissa`, which would round subnormals
+            // again. A subnormal's exponent field is 0, and rounding up into the smallest normal
+            // carries into it.
+            if (binary_exponent < -1022) return std::bit_cast<double>(mantissa);
+            int biased_exponent = extra_bits - scale + 52 + 1023;
+            if (mantissa == uint64_t(1) << 53) {
+                mantissa >>= 1;
+                ++biased_exponent;
+            }
+            if (biased_exponent >= 0x7ff) return std::bit_cast<double>(uint64_t(0x7ff) << 52);
+            return std::bit_cast<double>((static_cast<uint64_t>(biased_exponent) << 52)
+                | (mantissa & ((uint64_t(1) << 52) - 1)));
+        }
+    }
+
+    // Parses a number literal, as the tokenizer accepts: digits, with at most one `.` among them.
+    //
+    // Correctly rounded, like `std::from_chars`, but also usable in constant expressions.
+    constexpr double parse_number(std::string_view literal) {
+        // Most literals have few enough digits that they and the power of ten are exact. Then a
+        // single division is correctly rounded.
+        uint64_t digits = 0;
+        size_t num_digits = 0;
+        size_t fraction_digits = 0;
+        bool in_fraction = false;
+        for (char c : literal) {
+            if (c == '.') {
+                assert(!in_fraction);
+                in_fraction = true;
+                continue;
+            }
+            assert('0' <= c && c <= '9');
+            if (num_digits == 0 && c == '0' && !in_fraction) continue;
+            if (num_digits < 15) digits = digits * 10 + static_cast<uint64_t>(c - '0');
+            ++num_digits;
+            fraction_digits += in_fraction;
+        }
+
+        if (num_digits <= 15 && fraction_digits < number_internal::exact_powers_of_10.size()) {
+            return static_cast<double>(digits)
+                / number_internal::exact_powers_of_10[fraction_digits];
+        }
+        return number_internal::parse_slow(literal);
+    }
+}
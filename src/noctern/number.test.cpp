@@ -0,0 +1,117 @@
+#include "./number.hpp"
+
+#include <catch2/catch.hpp>
+#include <charconv>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <string>
+
+namespace noctern {
+    namespace {
+        double from_chars(const std::string& literal) {
+            double result;
+            const auto [ptr, ec]
+                = std::from_chars(literal.data(), literal.data() + literal.size(), result);
+            // Which leaves `result` alone if it rounds to 0 or infinity, where `strtod` doesn't.
+            if (ec == std::errc::result_out_of_range) return std::strtod(literal.c_str(), nullptr);
+            return result;
+        }
+
+        static_assert(noctern::parse_number("0") == 0);
+        static_assert(noctern::parse_number("42") == 42);
+        static_assert(noctern::parse_number("2.5") == 2.5);
+        static_assert(noctern::parse_number(".5") == 0.5);
+        static_assert(noctern::parse_number("5.") == 5);
+        static_assert(noctern::parse_number("0.1") == 0.1);
+        static_assert(
+            noctern::parse_number("123456789012345678901234567890") == 1.2345678901234568e29);
+
+        TEST_CASE("parse_number rounds like std::from_chars") {
+            const std::string literal = GENERATE(as<std::string> {}, "0", "1", "0.1", "0.3",
+                "3.14159265358979323846264338327950288", "9007199254740993",
+                "9007199254740992.5", "0.000000000000000000000000000001",
+                // The largest double.
+                "17976931348623157" + std::string(292, '0'),
+                "1.00000000000000011102230246251565404236316680908203125",
+                "1.00000000000000011102230246251565404236316680908203124",
+                "1.00000000000000011102230246251565404236316680908203126", "00012.500");
+
+            CHECK(noctern::parse_number(literal) == noctern::from_chars(literal));
+        }
+
+        TEST_CASE("parse_number rounds subnormals once") {
+            const std::string literal = GENERATE(as<std::string> {},
+                // The smallest subnormal, and just above and below halfway to it.
+                "0." + std::string(323, '0') + "49406564584124654",
+                "0." + std::string(323, '0') + "24703282292062328",
+                "0." + std::string(323, '0') + "24703282292062327",
+                // The largest subnormal, and the smallest normal.
+                "0." + std::string(307, '0') + "22250738585072009",
+                "0." + std::string(307, '0') + "22250738585072014",
+                "0." + std::string(307, '0') + "2225073858507201136057409796709131975934819546351",
+                "0." + std::string(315, '0') + "123456789012345678901234567890");
+            CHECK(noctern::parse_number(literal) == noctern::from_chars(literal));
+        }
+
+        TEST_CASE("parse_number rounds random subnormals like std::from_chars") {
+            std::mt19937_64 rng(54321);
+            std::uniform_int_distribution<int> digit('0', '9');
+            std::uniform_int_distribution<int> length(1, 40);
+            std::uniform_int_distribution<int> zeros(300, 323);
+            for (int i = 0; i < 20000; ++i) {
+                std::string literal = "0." + std::string(zeros(rng), '0');
+                const int num_digits = length(rng);
+                for (int d = 0; d < num_digits; ++d) {
+                    literal += static_cast<char>(digit(rng));
+                }
+                INFO(literal);
+                REQUIRE(noctern::parse_number(literal) == noctern::from_chars(literal));
+            }
+        }
+
+        TEST_CASE("parse_number rounds literals out of range to 0 and infinity") {
+            CHECK(noctern::parse_number("0." + std::string(330, '0') + "9") == 0);
+            CHECK(noctern::parse_number("0." + std::string(323, '0') + "2") == 0);
+            CHECK(noctern::parse_number("1" + std::string(309, '0'))
+                == std::numeric_limits<double>::infinity());
+            CHECK(noctern::parse_number("1" + std::string(100000, '0'))
+                == std::numeric_limits<double>::infinity());
+            // Above and below halfway between the largest double and 2^1024.
+            CHECK(noctern::parse_number("17976931348623159" + std::string(292, '0'))
+                == std::numeric_limits<double>::infinity());
+            CHECK(noctern::parse_number("17976931348623158" + std::string(292, '0'))
+                == std::numeric_limits<double>::max());
+        }
+
+        TEST_CASE("parse_number rounds very long literals") {
+            // Halfway between two doubles, then far beyond the digits kept: only whether the rest
+            // are all 0 decides the rounding.
+            const std::string halfway = "9007199254740993.";
+            const std::string zeros(1'000'000, '0');
+            CHECK(noctern::parse_number(halfway + zeros) == 9007199254740992);
+            CHECK(noctern::parse_number(halfway + zeros + "1") == 9007199254740994);
+            CHECK(noctern::parse_number(zeros + halfway + zeros) == 9007199254740992);
+            CHECK(noctern::parse_number("0." + zeros + "1") == 0);
+            const std::string thirds = "0." + std::string(1'000'000, '3');
+            CHECK(noctern::parse_number(thirds) == noctern::from_chars(thirds));
+        }
+
+        TEST_CASE("parse_number rounds random literals like std::from_chars") {
+            std::mt19937_64 rng(12345);
+            std::uniform_int_distribution<int> digit('0', '9');
+            std::uniform_int_distribution<int> length(1, 40);
+            for (int i = 0; i < 20000; ++i) {
+                std::string literal;
+                const int num_digits = length(rng);
+                const int point = std::uniform_int_distribution<int>(-1, num_digits)(rng);
+                for (int d = 0; d < num_digits; ++d) {
+                    if (d == point) literal += '.';
+                    literal += static_cast<char>(digit(rng));
+                }
+                INFO(literal);
+                REQUIRE(noctern::parse_number(literal) == noctern::from_chars(literal));
+            }
+        }
+    }
+}
@@ -148,5 +148,23 @@ namespace noctern {
                     statement_end,
                 })));
         }
+
+        TEST_CASE("parse records the size of each let initializer") {
+            const noctern::tokens parsed = noctern::parse(noctern::tokenize_all(R"(
+                def f(x): {
+                    let a = x;
+                    let b = (x + 1) * a;
+                    return a - b;
+                };
+            )"));
+
+            std::vector<token_index_t> sizes;
+            for (const token token : parsed) {
+                if (parsed.id(token) == token_id::valdef_intro) {
+                    sizes.push_back(parsed.subtree_size(token));
+                }
+            }
+            CHECK(sizes == std::vector<token_index_t> {1, 5});
+        }
     }
 }
@@ -0,0 +1,94 @@
+#include "./perf_counters.hpp"
+
+#include <catch2/catch.hpp>
+#include <optional>
+#include <string>
+
+#include <fmt/format.h>
+
+#include "noctern/arena.hpp"
+#include "noctern/compilation_unit.hpp"
+#include "noctern/interpreter.hpp"
+#include "noctern/parser.hpp"
+#include "noctern/symbol_table.hpp"
+#include "noctern/tokenize.hpp"
+
+namespace noctern {
+    namespace {
+        std::string generated_module(int num_fns) {
+            std::string source;
+            for (int i = 0; i < num_fns; ++i) {
+                source += fmt::format(
+                    "def f{}(x, y): {{ let a = x * {}; let b = a - y / 3; return a + b * 2; }};\n",
+                    i, i);
+            }
+            return source;
+        }
+
+        void accumulate(std::optional<perf_sample>& total, const perf_sample& sample) {
+            if (total.has_value()) {
+                *total += sample;
+            } else {
+                total = sample;
+            }
+        }
+
+        // Not a timing benchmark: reports what limits each phase, e.g. branch misses in the
+        // tokenizer, per token of the module.
+        TEST_CASE("front end phases under hardware counters", "[benchmark]") {
+            const std::string source = noctern::generated_module(10000);
+            constexpr int repetitions = 20;
+
+            perf_counters counters;
+            if (!counters.available()) {
+                WARN("No hardware counters (" << counters.error().message()
+                                               << "); only reporting time");
+            }
+
+            std::optional<perf_sample> lex;
+            std::optional<perf_sample> parse;
+            std::optional<perf_sample> symbols;
+            std::optional<perf_sample> eval;
+            size_t num_tokens = 0;
+            double sum = 0;
+            for (int i = 0; i < repetitions; ++i) {
+                arena arena;
+                std::optional<tokens> lexed;
+                noctern::accumulate(lex, counters.measure([&] {
+                    lexed.emplace(noctern::tokenize_all(source, &arena));
+                }));
+                num_tokens += lexed->num_tokens();
+
+                std::optional<tokens> parsed;
+                noctern::accumulate(parse,
+                    counters.measure([&] { parsed.emplace(noctern::parse(std::move(*lexed))); }));
+
+                std::optional<compilation_unit> unit;
+                std::optional<symbol_table> table;
+                noctern::accumulate(symbols, counters.measure([&] {
+                    unit.emplace(*parsed);
+                    table.emplace(*parsed, *unit);
+                }));
+
+                const interpreter interpreter(*table);
+                noctern::accumulate(eval, counters.measure([&] {
+                    for (const token fn : unit->fn_defs()) {
+                        // The declaration, as `symbol_table` finds it, is two tokens on.
+                        sum += interpreter.eval_fn(*parsed, parsed->to_iterator(fn)[2],
+                            interpreter::frame {
+                                .locals = {{"x", 1.5}, {"y", 0.25}},
+                                .expr_stack = {},
+                            });
+                    }
+                }));
+            }
+            CHECK(sum != 0);
+
+            for (const auto& [name, sample] : {std::pair("lex", lex), std::pair("parse", parse),
+                     std::pair("symbol table", symbols), std::pair("eval", eval)}) {
+                fmt::println(
+                    "{:<14}{}", name, noctern::format_perf_sample(*sample, num_tokens, "token"));
+            }
+        }
+    }
+}
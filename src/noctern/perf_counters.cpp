@@ -0,0 +1,210 @@
+#include "./perf_counters.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fmt/format.h>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace noctern {
+    namespace {
+        std::error_code last_error() {
+            return std::error_code(errno, std::system_category());
+        }
+
+        constexpr uint64_t cache_event(uint64_t cache) {
+            return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        }
+
+        perf_event_attr attributes(perf_event event) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            switch (event) {
+            case perf_event::cycles:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                break;
+            case perf_event::instructions:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                break;
+            case perf_event::branch_misses:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+                break;
+            case perf_event::l1d_misses:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = noctern::cache_event(PERF_COUNT_HW_CACHE_L1D);
+                break;
+            case perf_event::llc_misses:
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = PERF_COUNT_HW_CACHE_MISSES;
+                break;
+            }
+            // Counted from `start`, and only in user space; the kernel is often off limits.
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED
+                | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            return attr;
+        }
+
+        // Opens `event` for the calling thread, or returns -1.
+        int open_event(perf_event event, int group_fd) {
+            perf_event_attr attr = noctern::attributes(event);
+            return static_cast<int>(
+                ::syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC));
+        }
+
+        constexpr std::string_view event_name(perf_event event) {
+            switch (event) {
+            case perf_event::cycles: return "cycles";
+            case perf_event::instructions: return "instructions";
+            case perf_event::branch_misses: return "branch misses";
+            case perf_event::l1d_misses: return "L1d misses";
+            case perf_event::llc_misses: return "LLC misses";
+            }
+            std::unreachable();
+        }
+
+        // E.g. 1234567 -> "1.2M".
+        std::string abbreviate(double value) {
+            if (value < 1e3) return fmt::format("{:.0f}", value);
+            if (value < 1e6) return fmt::format("{:.1f}k", value / 1e3);
+            if (value < 1e9) return fmt::format("{:.1f}M", value / 1e6);
+            return fmt::format("{:.1f}G", value / 1e9);
+        }
+    }
+
+    std::optional<double> perf_sample::ipc() const {
+        const std::optional<uint64_t> cycles = (*this)[perf_event::cycles];
+        const std::optional<uint64_t> instructions = (*this)[perf_event::instructions];
+        if (!cycles.has_value() || !instructions.has_value() || *cycles == 0) return std::nullopt;
+        return static_cast<double>(*instructions) / static_cast<double>(*cycles);
+    }
+
+    perf_sample& perf_sample::operator+=(const perf_sample& rhs) {
+        elapsed += rhs.elapsed;
+        for (size_t i = 0; i < num_perf_events; ++i) {
+            if (counts[i].has_value() && rhs.counts[i].has_value()) {
+                *counts[i] += *rhs.counts[i];
+            } else {
+                counts[i].reset();
+            }
+        }
+        return *this;
+    }
+
+    perf_counters::perf_counters() {
+        for (size_t i = 0; i < num_perf_events; ++i) {
+            const auto event = static_cast<perf_event>(i);
+            const int fd = noctern::open_event(event, num_events_ == 0 ? -1 : fds_[0]);
+            if (fd == -1) {
+                // Only the first reason is interesting; the rest are usually the same.
+                if (!error_) error_ = noctern::last_error();
+                continue;
+            }
+            fds_[num_events_] = fd;
+            events_[num_events_] = event;
+            ++num_events_;
+        }
+        if (num_events_ != 0) error_.clear();
+    }
+
+    perf_counters::perf_counters(perf_counters&& rhs) noexcept
+        : fds_(rhs.fds_)
+        , events_(rhs.events_)
+        , num_events_(std::exchange(rhs.num_events_, 0))
+        , error_(rhs.error_)
+        , start_(rhs.start_) {
+    }
+
+    perf_counters& perf_counters::operator=(perf_counters&& rhs) noexcept {
+        if (this != &rhs) {
+            for (size_t i = 0; i < num_events_; ++i) {
+                ::close(fds_[i]);
+            }
+            fds_ = rhs.fds_;
+            events_ = rhs.events_;
+            num_events_ = std::exchange(rhs.num_events_, 0);
+            error_ = rhs.error_;
+            start_ = rhs.start_;
+        }
+        return *this;
+    }
+
+    perf_counters::~perf_counters() {
+        for (size_t i = 0; i < num_events_; ++i) {
+            ::close(fds_[i]);
+        }
+    }
+
+    void perf_counters::start() {
+        if (available()) {
+            ::ioctl(fds_[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+            ::ioctl(fds_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        }
+        start_ = std::chrono::steady_clock::now();
+    }
+
+    perf_sample perf_counters::stop() {
+        perf_sample result;
+        result.elapsed = std::chrono::steady_clock::now() - start_;
+        if (!available()) return result;
+        ::ioctl(fds_[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+        struct {
+            uint64_t num_events;
+            uint64_t time_enabled;
+            uint64_t time_running;
+            std::array<uint64_t, num_perf_events> values;
+        } group;
+        const ssize_t size = ::read(fds_[0], &group, sizeof(group));
+        if (size < static_cast<ssize_t>(3 + num_events_) * 8 || group.num_events != num_events_) {
+            return result;
+        }
+        // Never scheduled, e.g. because another process holds the counters.
+        if (group.time_running == 0) return result;
+
+        // Scale up for the time the group wasn't scheduled, if the counters were shared.
+        const double scale = static_cast<double>(group.time_enabled)
+            / static_cast<double>(group.time_running);
+        for (size_t i = 0; i < num_events_; ++i) {
+            result.counts[static_cast<size_t>(events_[i])]
+                = static_cast<uint64_t>(static_cast<double>(group.values[i]) * scale);
+        }
+        return result;
+    }
+
+    std::string format_perf_sample(
+        const perf_sample& sample, size_t num_units, std::string_view unit) {
+        const std::chrono::duration<double, std::milli> elapsed = sample.elapsed;
+        std::string result = fmt::format("{:.3f} ms", elapsed.count());
+        for (size_t i = 0; i < num_perf_events; ++i) {
+            if (!sample.counts[i].has_value()) continue;
+            result += fmt::format(", {} {}", noctern::abbreviate(static_cast<double>(*sample.counts[i])),
+                noctern::event_name(static_cast<perf_event>(i)));
+        }
+        if (const std::optional<double> ipc = sample.ipc()) {
+            result += fmt::format(", IPC {:.2f}", *ipc);
+        }
+        if (num_units == 0) return result;
+
+        result += fmt::format(" | per {}: {:.1f} ns", unit,
+            elapsed.count() * 1e6 / static_cast<double>(num_units));
+        for (size_t i = 0; i < num_perf_events; ++i) {
+            if (!sample.counts[i].has_value()) continue;
+            result += fmt::format(", {:.2f} {}",
+                static_cast<double>(*sample.counts[i]) / static_cast<double>(num_units),
+                noctern::event_name(static_cast<perf_event>(i)));
+        }
+        return result;
+    }
+}
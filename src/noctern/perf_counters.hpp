@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+namespace noctern {
+    // A hardware event counted by `perf_counters`.
+    enum class perf_event : uint8_t {
+        cycles,
+        instructions,
+        branch_misses,
+        // Level 1 data cache read misses.
+        l1d_misses,
+        // Last level cache misses, i.e. accesses which went to memory.
+        llc_misses,
+    };
+
+    inline constexpr size_t num_perf_events = 5;
+
+    // What `perf_counters` measured of one region.
+    struct perf_sample {
+        std::chrono::nanoseconds elapsed {};
+        // Indexed by `perf_event`. Absent where the event couldn't be counted.
+        std::array<std::optional<uint64_t>, num_perf_events> counts {};
+
+        std::optional<uint64_t> operator[](perf_event event) const {
+            return counts[static_cast<size_t>(event)];
+        }
+
+        // Instructions per cycle.
+        std::optional<double> ipc() const;
+
+        // Counts missing from either side are missing from the sum.
+        perf_sample& operator+=(const perf_sample& rhs);
+    };
+
+    // Counts hardware events (cycles, instructions, branch and cache misses) of the calling thread
+    // over a region of code, through `perf_event_open`.
+    //
+    // The events are opened as one group, so they're all counted over exactly the same
+    // instructions. Events which the CPU or kernel doesn't support are left out. Where none can
+    // be counted at all, e.g. in most virtual machines or with a restrictive
+    // `perf_event_paranoid`, only the elapsed time is measured.
+    class perf_counters {
+    public:
+        perf_counters();
+
+        perf_counters(perf_counters&& rhs) noexcept;
+        perf_counters& operator=(perf_counters&& rhs) noexcept;
+        ~perf_counters();
+
+        // Whether any hardware event is counted.
+        bool available() const {
+            return num_events_ != 0;
+        }
+
+        // Why no hardware event is counted, if none is.
+        std::error_code error() const {
+            return error_;
+        }
+
+        void start();
+        perf_sample stop();
+
+        template <typename Fn>
+        perf_sample measure(Fn&& fn) {
+            start();
+            std::forward<Fn>(fn)();
+            return stop();
+        }
+
+    private:
+        // The group, led by the first. In the order which reading the group reports them.
+        std::array<int, num_perf_events> fds_ {};
+        std::array<perf_event, num_perf_events> events_ {};
+        size_t num_events_ = 0;
+        std::error_code error_;
+
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    // E.g. "1.20 ms, 3.1M cycles, IPC 2.45 | per token: 12.3 cycles, 0.02 branch misses, ...".
+    //
+    // The per-unit figures are left out when `num_units` is 0.
+    std::string format_perf_sample(
+        const perf_sample& sample, size_t num_units, std::string_view unit);
+}
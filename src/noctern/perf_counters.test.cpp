@@ -0,0 +1,61 @@
+#include "./perf_counters.hpp"
+
+#include <catch2/catch.hpp>
+#include <cstdint>
+
+namespace noctern {
+    namespace {
+        TEST_CASE("perf_counters measures with or without hardware counters") {
+            perf_counters counters;
+            // Either some event is counted, or there's a reason none is.
+            CHECK(counters.available() != static_cast<bool>(counters.error()));
+
+            volatile uint64_t sum = 0;
+            const perf_sample sample = counters.measure([&] {
+                for (uint64_t i = 0; i < 1'000'000; ++i) {
+                    sum = sum + i;
+                }
+            });
+            CHECK(sample.elapsed.count() > 0);
+
+            if (const std::optional<uint64_t> instructions = sample[perf_event::instructions]) {
+                CHECK(*instructions >= 1'000'000);
+            }
+            if (!counters.available()) {
+                for (const std::optional<uint64_t>& count : sample.counts) {
+                    CHECK(!count.has_value());
+                }
+            }
+        }
+
+        TEST_CASE("format_perf_sample reports what was counted") {
+            perf_sample sample;
+            sample.elapsed = std::chrono::milliseconds(2);
+            CHECK(noctern::format_perf_sample(sample, 0, "token") == "2.000 ms");
+            CHECK(noctern::format_perf_sample(sample, 1000, "token")
+                == "2.000 ms | per token: 2000.0 ns");
+
+            sample.counts[static_cast<size_t>(perf_event::cycles)] = 4'000'000;
+            sample.counts[static_cast<size_t>(perf_event::instructions)] = 10'000'000;
+            CHECK(sample.ipc() == 2.5);
+            CHECK(noctern::format_perf_sample(sample, 1000, "token")
+                == "2.000 ms, 4.0M cycles, 10.0M instructions, IPC 2.50 | per token: 2000.0 ns, "
+                   "4000.00 cycles, 10000.00 instructions");
+        }
+
+        TEST_CASE("perf_sample sums only what both sides counted") {
+            perf_sample lhs;
+            lhs.elapsed = std::chrono::nanoseconds(5);
+            lhs.counts[static_cast<size_t>(perf_event::cycles)] = 10;
+            lhs.counts[static_cast<size_t>(perf_event::instructions)] = 20;
+            perf_sample rhs;
+            rhs.elapsed = std::chrono::nanoseconds(7);
+            rhs.counts[static_cast<size_t>(perf_event::cycles)] = 1;
+
+            lhs += rhs;
+            CHECK(lhs.elapsed.count() == 12);
+            CHECK(lhs[perf_event::cycles] == 11);
+            CHECK(!lhs[perf_event::instructions].has_value());
+        }
+    }
+}
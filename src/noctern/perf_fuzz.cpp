@@ -0,0 +1,112 @@
+#include "./perf_fuzz.hpp"
+
+#include <iterator>
+
+#include <fmt/format.h>
+
+namespace noctern {
+    namespace {
+        enum class shape : uint8_t {
+            // def f(x): ((((x))));
+            nested_parens,
+            // def f(x): { return { return x; }; };
+            nested_blocks,
+            // def f(x): x + x * x - x / x;
+            operator_chain,
+            // def aaaa(x): x;
+            long_identifier,
+            // def f(x): x + 1234.5678;
+            long_literal,
+            // def f(p0, p1, p2): p0;
+            many_params,
+            // def f(x): { let a = x; let a = a + 1; return a; };
+            many_lets,
+        };
+
+        constexpr size_t num_shapes = 7;
+
+        void append_repeated(std::string& out, std::string_view str, size_t times) {
+            for (size_t i = 0; i < times; ++i) {
+                out += str;
+            }
+        }
+    }
+
+    std::string format_cost_growth(const cost_growth& growth, std::string_view unit) {
+        return fmt::format("{:.2f} times the work per byte at {} bytes ({} {}) as at {} ({} {})",
+            growth.per_byte_growth(), growth.large_size, growth.large_work, unit,
+            growth.small_size, growth.small_work, unit);
+    }
+
+    std::string generate_program(std::span<const uint8_t> input, size_t scale) {
+        std::string result;
+        auto out = std::back_inserter(result);
+        for (size_t i = 0; i < input.size(); i += 2) {
+            const size_t fn = i / 2;
+            const uint8_t choice = input[i];
+            // 1 to 16, so that a single byte can't make a huge program.
+            const size_t size = ((i + 1 < input.size() ? input[i + 1] : 0) % 16 + 1) * scale;
+            const size_t depth = std::min(size, max_nesting);
+
+            switch (static_cast<shape>(choice % num_shapes)) {
+            case shape::nested_parens:
+                fmt::format_to(out, "def f{}(x): ", fn);
+                noctern::append_repeated(result, "(", depth);
+                result += "x";
+                noctern::append_repeated(result, ")", depth);
+                result += ";\n";
+                break;
+            case shape::nested_blocks:
+                fmt::format_to(out, "def f{}(x): ", fn);
+                noctern::append_repeated(result, "{ return ", depth);
+                result += "x";
+                noctern::append_repeated(result, "; }", depth);
+                result += ";\n";
+                break;
+            case shape::operator_chain: {
+                // The rest of the byte picks where in the cycle of operators to start.
+                constexpr std::string_view operators = "+*-/";
+                fmt::format_to(out, "def f{}(x): x", fn);
+                for (size_t j = 0; j < depth; ++j) {
+                    result += ' ';
+                    result += operators[(choice / num_shapes + j) % operators.size()];
+                    result += " x";
+                }
+                result += ";\n";
+                break;
+            }
+            case shape::long_identifier:
+                result += "def f";
+                result.append(size, 'a');
+                result += "(x): x;\n";
+                break;
+            case shape::long_literal:
+                fmt::format_to(out, "def f{}(x): x + ", fn);
+                for (size_t j = 0; j < size; ++j) {
+                    result += static_cast<char>('0' + j % 10);
+                }
+                result += '.';
+                for (size_t j = 0; j < size; ++j) {
+                    result += static_cast<char>('9' - j % 10);
+                }
+                result += ";\n";
+                break;
+            case shape::many_params:
+                fmt::format_to(out, "def f{}(p0", fn);
+                for (size_t j = 1; j < size; ++j) {
+                    fmt::format_to(out, ", p{}", j);
+                }
+                result += "): p0;\n";
+                break;
+            case shape::many_lets:
+                fmt::format_to(out, "def f{}(x): {{ let a = x;", fn);
+                for (size_t j = 1; j < size; ++j) {
+                    fmt::format_to(out, " let a = a + {};", j);
+                }
+                result += " return a; };\n";
+                break;
+            }
+        }
+        return result;
+    }
+}
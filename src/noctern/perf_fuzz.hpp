@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "noctern/perf_counters.hpp"
+
+namespace noctern {
+    // Measures how much work a piece of code does: instructions retired where hardware counters
+    // are available, else nanoseconds.
+    //
+    // Instructions are all but deterministic, so they're what catches a slow input reliably.
+    class work_meter {
+    public:
+        template <typename Fn>
+        uint64_t measure(Fn&& fn) {
+            const perf_sample sample = counters_.measure(std::forward<Fn>(fn));
+            const std::optional<uint64_t> instructions = sample[perf_event::instructions];
+            counts_instructions_ = instructions.has_value();
+            return instructions.value_or(static_cast<uint64_t>(sample.elapsed.count()));
+        }
+
+        // The unit of the last measurement: "instructions" or "ns".
+        std::string_view unit() const {
+            return counts_instructions_ ? "instructions" : "ns";
+        }
+
+    private:
+        perf_counters counters_;
+        bool counts_instructions_ = false;
+    };
+
+    // The work done on a small and a large input of the same shape.
+    struct cost_growth {
+        size_t small_size = 0;
+        uint64_t small_work = 0;
+        size_t large_size = 0;
+        uint64_t large_work = 0;
+
+        // How many times more work per byte the large input takes than the small one. Near 1 when
+        // the work is linear, and near `large_size / small_size` when it's quadratic.
+        double per_byte_growth() const {
+            if (small_work == 0 || large_size == 0) return 1;
+            return (static_cast<double>(large_work) / static_cast<double>(large_size))
+                / (static_cast<double>(small_work) / static_cast<double>(small_size));
+        }
+    };
+
+    // Measures `fn(make_input(scale))` at the smallest power of two `scale` whose input has at
+    // least `min_bytes`, and at `factor` times that scale. `make_input` is not measured.
+    //
+    // Each size takes the least of `num_runs` runs, to leave out interruptions. The runs of the two
+    // sizes alternate, so that both see the same conditions, e.g. the CPU's clock speeding up.
+    //
+    // `meter` is a `work_meter`, or anything else with its `measure`.
+    //
+    // Nothing is measured if `make_input` doesn't grow with `scale`, e.g. for an empty input.
+    template <typename Meter, typename MakeInput, typename Fn>
+    std::optional<cost_growth> measure_growth(Meter& meter, MakeInput&& make_input, Fn&& fn,
+        size_t min_bytes, size_t factor, int num_runs = 5) {
+        // Past this, an input too small to measure isn't going to get there.
+        constexpr size_t max_scale = size_t(1) << 20;
+
+        size_t scale = 1;
+        std::string small = make_input(scale);
+        while (small.size() < min_bytes && scale < max_scale) {
+            scale *= 2;
+            small = make_input(scale);
+        }
+        std::string large = make_input(scale * factor);
+        if (small.empty() || large.size() <= small.size()) return std::nullopt;
+
+        cost_growth result {
+            .small_size = small.size(),
+            .small_work = std::numeric_limits<uint64_t>::max(),
+            .large_size = large.size(),
+            .large_work = std::numeric_limits<uint64_t>::max(),
+        };
+        for (int run = 0; run < num_runs; ++run) {
+            result.small_work = std::min(
+                result.small_work, meter.measure([&] { fn(std::string_view(small)); }));
+            result.large_work = std::min(
+                result.large_work, meter.measure([&] { fn(std::string_view(large)); }));
+        }
+        return result;
+    }
+
+    // E.g. "4.1 times the work per byte at 16384 bytes (81920 instructions) as at 4096 (5000
+    // instructions)".
+    std::string format_cost_growth(const cost_growth& growth, std::string_view unit);
+
+    // Builds a program which `parse` accepts out of arbitrary bytes, so that the parser can be
+    // fuzzed with more than parse errors.
+    //
+    // Each pair of bytes adds a function of some shape which is hard on a parser: deeply nested
+    // parentheses or blocks, a long chain of operators, a long identifier or literal, many
+    // parameters or `let`s. The second byte picks its size, which is multiplied by `scale`, so
+    // that a larger `scale` grows the same program in every direction.
+    //
+    // Nesting is capped at `max_nesting` levels, since the parser recurses for each. Up to a
+    // `scale` of `max_unclamped_scale`, no function reaches the cap, so nesting grows with `scale`.
+    std::string generate_program(std::span<const uint8_t> input, size_t scale);
+
+    inline constexpr size_t max_nesting = 1000;
+    // The largest size is 16 times `scale`.
+    inline constexpr size_t max_unclamped_scale = max_nesting / 16;
+}
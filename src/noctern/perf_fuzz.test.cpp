@@ -0,0 +1,108 @@
+#include "./perf_fuzz.hpp"
+
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "noctern/parser.hpp"
+#include "noctern/tokenize.hpp"
+
+namespace noctern {
+    namespace {
+        TEST_CASE("generate_program builds programs which parse") {
+            std::mt19937 rng(GENERATE(1, 2, 3, 4, 5));
+            std::vector<uint8_t> input(GENERATE(1, 2, 31, 200));
+            for (uint8_t& byte : input) {
+                byte = static_cast<uint8_t>(rng());
+            }
+
+            const std::string small = noctern::generate_program(input, 1);
+            const std::string large = noctern::generate_program(input, 3);
+            CHECK(large.size() > small.size());
+
+            // Parse errors are asserts.
+            CHECK(noctern::parse(noctern::tokenize_all(small)).num_tokens() > 0);
+            CHECK(noctern::parse(noctern::tokenize_all(large)).num_tokens() > 0);
+        }
+
+        TEST_CASE("generate_program caps nesting") {
+            const std::vector<uint8_t> nested_parens = {0, 15};
+            const std::string program = noctern::generate_program(nested_parens, 1000);
+            CHECK(program.find(std::string(max_nesting, '(')) != std::string::npos);
+            CHECK(program.find(std::string(max_nesting + 1, '(')) == std::string::npos);
+            noctern::parse(noctern::tokenize_all(program));
+
+            // Below the cap, nesting still grows with the scale.
+            const std::string unclamped
+                = noctern::generate_program(nested_parens, max_unclamped_scale);
+            CHECK(unclamped.find(std::string(16 * max_unclamped_scale, '('))
+                != std::string::npos);
+        }
+
+        // Counts the steps the measured code takes, so that its growth is exact, unlike time.
+        struct step_meter {
+            uint64_t steps = 0;
+
+            template <typename Fn>
+            uint64_t measure(Fn&& fn) {
+                steps = 0;
+                fn();
+                return steps;
+            }
+        };
+
+        TEST_CASE("measure_growth tells linear from quadratic work") {
+            step_meter meter;
+            const auto repeat = [](size_t scale) { return std::string(scale, 'x'); };
+
+            const std::optional<cost_growth> linear = noctern::measure_growth(
+                meter, repeat, [&](std::string_view input) { meter.steps += input.size(); },
+                1 << 16, 4);
+            REQUIRE(linear.has_value());
+            CHECK(linear->small_size == 1 << 16);
+            CHECK(linear->large_size == 1 << 18);
+            CHECK(linear->per_byte_growth() == 1);
+
+            const std::optional<cost_growth> quadratic = noctern::measure_growth(
+                meter, repeat,
+                [&](std::string_view input) { meter.steps += input.size() * input.size(); },
+                1000, 4);
+            REQUIRE(quadratic.has_value());
+            CHECK(quadratic->small_size == 1024);
+            CHECK(quadratic->per_byte_growth() == 4);
+        }
+
+        TEST_CASE("work_meter measures some work") {
+            work_meter meter;
+            volatile uint64_t sum = 0;
+            CHECK(meter.measure([&] {
+                for (int i = 0; i < 1000; ++i) {
+                    sum = sum + 1;
+                }
+            }) > 0);
+        }
+
+        TEST_CASE("measure_growth measures nothing of an input which doesn't grow") {
+            work_meter meter;
+            CHECK(!noctern::measure_growth(
+                meter, [](size_t) { return std::string(); }, [](std::string_view) { }, 10, 4)
+                       .has_value());
+        }
+
+        TEST_CASE("format_cost_growth compares per byte") {
+            const cost_growth growth {
+                .small_size = 100,
+                .small_work = 1000,
+                .large_size = 400,
+                .large_work = 16000,
+            };
+            CHECK(growth.per_byte_growth() == 4);
+            CHECK(noctern::format_cost_growth(growth, "ns")
+                == "4.00 times the work per byte at 400 bytes (16000 ns) as at 100 (1000 ns)");
+        }
+    }
+}
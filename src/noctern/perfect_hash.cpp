@@ -0,0 +1 @@
+#include "./perfect_hash.hpp"
\ No newline at end of file
@@ -0,0 +1,299 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "noctern/arena.hpp"
+
+namespace noctern {
+    // A minimal perfect hash over a fixed set of strings: maps each of the `size()` distinct keys
+    // to its own index in `[0, size())`.
+    //
+    // Built CHD style ("hash, displace and compress"): keys are hashed once into buckets of a few
+    // keys each, then the largest buckets first, each bucket searches for a displacement which
+    // moves all its keys onto free indices. A lookup is one hash of the key plus a multiply to
+    // apply its bucket's displacement.
+    //
+    // As in PTHash, the displacements target a slightly larger range than `size()`, since
+    // finding the last few free indices of an exactly full range dominates the build otherwise.
+    // The few keys past the end are then moved into the holes left below it.
+    //
+    // Strings which aren't keys map to an arbitrary index, so the caller must compare against
+    // the key stored there.
+    class perfect_hash {
+    public:
+        // Keys equal to an earlier key are ignored; they map to the same index as it.
+        //
+        // The tables are allocated with `allocator`; the temporaries used to build them aren't.
+        explicit constexpr perfect_hash(
+            std::span<const std::string_view> keys, arena_allocator<uint32_t> allocator = {})
+            : displacements_(allocator)
+            , overflow_(allocator) {
+            assert(keys.size() <= std::numeric_limits<uint32_t>::max());
+            while (!try_build(keys)) {
+                seed_ = perfect_hash::mix(seed_ + 1);
+            }
+        }
+
+        // The number of distinct keys.
+        constexpr size_t size() const {
+            return size_;
+        }
+
+        // The bytes allocated for the tables, not counting the keys.
+        constexpr size_t memory_usage() const {
+            return (displacements_.capacity() + overflow_.capacity()) * sizeof(uint32_t);
+        }
+
+        // The parts of a built hash, to store it and `restore` it later without building it again.
+        constexpr uint64_t seed() const {
+            return seed_;
+        }
+
+        constexpr std::span<const uint32_t> displacements() const {
+            return displacements_;
+        }
+
+        constexpr std::span<const uint32_t> overflow() const {
+            return overflow_;
+        }
+
+        // The hash with the given parts, of a hash with `size` keys. Parts which no built hash has
+        // (e.g. read from a damaged file) give `std::nullopt`, so that any result is safe to look
+        // up in.
+        static constexpr std::optional<perfect_hash> restore(uint64_t seed, size_t size,
+            std::span<const uint32_t> displacements, std::span<const uint32_t> overflow,
+            arena_allocator<uint32_t> allocator = {}) {
+            if (displacements.empty()
+                || size > std::numeric_limits<uint32_t>::max() - overflow.size()) {
+                return std::nullopt;
+            }
+            for (const uint32_t moved_to : overflow) {
+                if (moved_to >= size) return std::nullopt;
+            }
+
+            perfect_hash result(seed, allocator);
+            result.size_ = size;
+            result.range_ = size + overflow.size();
+            result.displacements_.assign(displacements.begin(), displacements.end());
+            result.overflow_.assign(overflow.begin(), overflow.end());
+            return result;
+        }
+
+        // Only meaningful when `size() != 0`.
+        constexpr size_t operator()(std::string_view key) const {
+            const uint64_t hash = perfect_hash::hash(key, seed_);
+            const size_t i = index(hash, displacements_[bucket(hash)]);
+            if (i < size_) [[likely]]
+                return i;
+            return overflow_[i - size_];
+        }
+
+    private:
+        // An empty hash, for `restore` to fill in.
+        explicit constexpr perfect_hash(uint64_t seed, arena_allocator<uint32_t> allocator)
+            : seed_(seed)
+            , displacements_(allocator)
+            , overflow_(allocator) {
+        }
+
+        // Keys per bucket, on average. Larger buckets make the table smaller but much slower to
+        // build.
+        static constexpr size_t bucket_size = 2;
+
+        // How full the range of `index` ends up.
+        static constexpr double load_factor = 0.99;
+
+        // Past this many displacements for a bucket, it's quicker to start again with a new seed.
+        // The last buckets placed only have a few free indices to land on, so this scales with
+        // the number of keys.
+        static constexpr size_t max_displacements(size_t num_keys) {
+            return std::min<size_t>(std::max<size_t>(size_t(1) << 16, 16 * num_keys),
+                std::numeric_limits<uint32_t>::max());
+        }
+
+        constexpr size_t bucket(uint64_t hash) const {
+            return (static_cast<uint64_t>(static_cast<uint32_t>(hash >> 32))
+                       * displacements_.size())
+                >> 32;
+        }
+
+        // A bijective mix, so that each displacement moves a bucket's keys somewhere new.
+        static constexpr uint64_t mix(uint64_t x) {
+            x ^= x >> 32;
+            x *= 0xD6E8FEB86659FD93;
+            x ^= x >> 32;
+            return x;
+        }
+
+        // Reads an unaligned integer.
+        template <typename Int>
+        static constexpr Int load(const char* data) {
+            if consteval {
+                // The same as the copy on little endian machines.
+                Int result = 0;
+                for (size_t i = 0; i < sizeof(Int); ++i) {
+                    result |= static_cast<Int>(static_cast<unsigned char>(data[i])) << (8 * i);
+                }
+                return result;
+            } else {
+                Int result;
+                std::memcpy(&result, data, sizeof(result));
+                return result;
+            }
+        }
+
+        static constexpr uint64_t hash(std::string_view key, uint64_t seed) {
+            uint64_t state = seed ^ (key.size() * 0x9E3779B97F4A7C15);
+            while (key.size() >= sizeof(uint64_t)) {
+                const uint64_t word = perfect_hash::load<uint64_t>(key.data());
+                state = perfect_hash::mix(state ^ word) + 0x2545F4914F6CDD1D;
+                key.remove_prefix(sizeof(uint64_t));
+            }
+            // The last 0-7 bytes, without a variable-length copy. The loads may overlap, which
+            // is fine since the length is already part of `state`.
+            uint64_t tail = 0;
+            if (key.size() >= sizeof(uint32_t)) {
+                const uint32_t low = perfect_hash::load<uint32_t>(key.data());
+                const uint32_t high
+                    = perfect_hash::load<uint32_t>(key.data() + key.size() - sizeof(uint32_t));
+                tail = (static_cast<uint64_t>(high) << 32) | low;
+            } else if (!key.empty()) {
+                tail = (static_cast<uint64_t>(static_cast<unsigned char>(key[0])) << 16)
+                    | (static_cast<uint64_t>(static_cast<unsigned char>(key[key.size() / 2])) << 8)
+                    | static_cast<unsigned char>(key.back());
+            }
+            return perfect_hash::mix(state ^ tail);
+        }
+
+        constexpr size_t index(uint64_t hash, uint32_t displacement) const {
+            const uint64_t mixed = perfect_hash::mix(hash + displacement * 0x9E3779B97F4A7C15);
+            return (static_cast<uint64_t>(static_cast<uint32_t>(mixed)) * range_) >> 32;
+        }
+
+        constexpr bool try_build(std::span<const std::string_view> keys) {
+            const size_t num_buckets = std::max<size_t>(1, keys.size() / bucket_size);
+            displacements_.assign(num_buckets, 0);
+
+            std::vector<uint64_t> hashes(keys.size());
+            for (size_t i = 0; i < keys.size(); ++i) {
+                hashes[i] = perfect_hash::hash(keys[i], seed_);
+            }
+
+            // The keys of bucket `b` are `members[bucket_begin[b], bucket_begin[b + 1])`, in key
+            // order.
+            std::vector<uint32_t> bucket_begin(num_buckets + 1, 0);
+            for (uint64_t hash : hashes) {
+                ++bucket_begin[bucket(hash) + 1];
+            }
+            for (size_t b = 0; b < num_buckets; ++b) {
+                bucket_begin[b + 1] += bucket_begin[b];
+            }
+            std::vector<uint32_t> members(keys.size());
+            {
+                std::vector<uint32_t> next(bucket_begin.begin(), bucket_begin.end() - 1);
+                for (size_t i = 0; i < keys.size(); ++i) {
+                    members[next[bucket(hashes[i])]++] = static_cast<uint32_t>(i);
+                }
+            }
+
+            // Equal keys are always in the same bucket, so duplicates can be dropped bucket by
+            // bucket. Each bucket's kept keys are moved to its front; `bucket_end` is their end.
+            std::vector<uint32_t> bucket_end(num_buckets);
+            size_t max_size = 0;
+            size_ = 0;
+            for (size_t b = 0; b < num_buckets; ++b) {
+                uint32_t end = bucket_begin[b];
+                for (uint32_t m = bucket_begin[b]; m < bucket_begin[b + 1]; ++m) {
+                    const uint32_t key = members[m];
+                    bool duplicate = false;
+                    for (uint32_t prev = bucket_begin[b]; prev < end; ++prev) {
+                        if (hashes[members[prev]] != hashes[key]) continue;
+                        // Two distinct keys with the same hash can never be separated.
+                        if (keys[members[prev]] != keys[key]) return false;
+                        duplicate = true;
+                        break;
+                    }
+                    if (!duplicate) members[end++] = key;
+                }
+                bucket_end[b] = end;
+                size_ += end - bucket_begin[b];
+                max_size = std::max<size_t>(max_size, end - bucket_begin[b]);
+            }
+            if (size_ == 0) return true;
+            range_ = static_cast<size_t>(static_cast<double>(size_) / load_factor) + 1;
+
+            // Largest buckets first, while there are still plenty of free indices.
+            std::vector<uint32_t> by_size(num_buckets);
+            {
+                std::vector<uint32_t> size_begin(max_size + 2, 0);
+                for (size_t b = 0; b < num_buckets; ++b) {
+                    ++size_begin[max_size - (bucket_end[b] - bucket_begin[b]) + 1];
+                }
+                for (size_t s = 0; s <= max_size; ++s) {
+                    size_begin[s + 1] += size_begin[s];
+                }
+                for (size_t b = 0; b < num_buckets; ++b) {
+                    by_size[size_begin[max_size - (bucket_end[b] - bucket_begin[b])]++]
+                        = static_cast<uint32_t>(b);
+                }
+            }
+
+            std::vector<bool> taken(range_, false);
+            std::vector<size_t> indices;
+            indices.reserve(max_size);
+            const size_t limit = max_displacements(range_);
+            for (const uint32_t b : by_size) {
+                if (bucket_begin[b] == bucket_end[b]) break;
+
+                uint32_t displacement = 0;
+                while (true) {
+                    if (displacement == limit) return false;
+
+                    indices.clear();
+                    for (uint32_t m = bucket_begin[b]; m < bucket_end[b]; ++m) {
+                        const size_t i = index(hashes[members[m]], displacement);
+                        if (taken[i] || std::ranges::find(indices, i) != indices.end()) break;
+                        indices.push_back(i);
+                    }
+                    if (indices.size() == bucket_end[b] - bucket_begin[b]) break;
+                    ++displacement;
+                }
+
+                displacements_[b] = displacement;
+                for (const size_t i : indices) {
+                    taken[i] = true;
+                }
+            }
+
+            // There are exactly as many holes below `size_` as keys at or above it.
+            overflow_.assign(range_ - size_, 0);
+            size_t hole = 0;
+            for (size_t i = size_; i < range_; ++i) {
+                if (!taken[i]) continue;
+                while (taken[hole]) {
+                    ++hole;
+                }
+                overflow_[i - size_] = static_cast<uint32_t>(hole++);
+            }
+            return true;
+        }
+
+        uint64_t seed_ = 0;
+        size_t size_ = 0;
+        // The range which `index` maps into, a little over `size_`.
+        size_t range_ = 0;
+        // One per bucket.
+        arena_vector<uint32_t> displacements_;
+        // Where each index from `size_` up to `range_` is moved to.
+        arena_vector<uint32_t> overflow_;
+    };
+}
@@ -0,0 +1,77 @@
+#include "./perfect_hash.hpp"
+
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace noctern {
+    namespace {
+        TEST_CASE("perfect_hash maps each key to its own index") {
+            const int num_keys = GENERATE(0, 1, 2, 3, 7, 100, 10000);
+            std::vector<std::string> storage;
+            for (int i = 0; i < num_keys; ++i) {
+                storage.push_back(fmt::format("f{}", i));
+            }
+            const std::vector<std::string_view> keys(storage.begin(), storage.end());
+
+            const perfect_hash hash(keys);
+            REQUIRE(hash.size() == keys.size());
+
+            std::vector<bool> seen(keys.size(), false);
+            for (std::string_view key : keys) {
+                const size_t index = hash(key);
+                REQUIRE(index < keys.size());
+                CHECK(!seen[index]);
+                seen[index] = true;
+            }
+        }
+
+        TEST_CASE("perfect_hash ignores duplicate keys") {
+            const std::vector<std::string_view> keys
+                = {"a", "bb", "a", "a_long_name_over_eight_bytes", "", "bb", ""};
+
+            const perfect_hash hash(keys);
+            REQUIRE(hash.size() == 4);
+
+            CHECK(hash("a") < 4);
+            CHECK(hash("bb") < 4);
+            CHECK(hash("a_long_name_over_eight_bytes") < 4);
+            CHECK(hash("") < 4);
+            CHECK(hash("a") != hash("bb"));
+            CHECK(hash("a") != hash("a_long_name_over_eight_bytes"));
+            CHECK(hash("a") != hash(""));
+            CHECK(hash("bb") != hash("a_long_name_over_eight_bytes"));
+            CHECK(hash("bb") != hash(""));
+            CHECK(hash("a_long_name_over_eight_bytes") != hash(""));
+        }
+
+        TEST_CASE("perfect_hash restores from its parts") {
+            std::vector<std::string> storage;
+            for (int i = 0; i < 1000; ++i) {
+                storage.push_back(fmt::format("f{}", i));
+            }
+            const std::vector<std::string_view> keys(storage.begin(), storage.end());
+            const perfect_hash hash(keys);
+
+            const std::optional<perfect_hash> restored = perfect_hash::restore(
+                hash.seed(), hash.size(), hash.displacements(), hash.overflow());
+            REQUIRE(restored.has_value());
+            CHECK(restored->size() == hash.size());
+            for (std::string_view key : keys) {
+                CHECK((*restored)(key) == hash(key));
+            }
+
+            // Parts which would look up out of range.
+            CHECK_FALSE(perfect_hash::restore(hash.seed(), hash.size(), {}, hash.overflow()));
+            std::vector<uint32_t> overflow(hash.overflow().begin(), hash.overflow().end());
+            overflow.push_back(static_cast<uint32_t>(hash.size()));
+            CHECK_FALSE(perfect_hash::restore(
+                hash.seed(), hash.size(), hash.displacements(), overflow));
+        }
+    }
+}
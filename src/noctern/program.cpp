@@ -0,0 +1,201 @@
+#include "./program.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <system_error>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+
+#include <fmt/format.h>
+
+#include "noctern/arena.hpp"
+#include "noctern/compilation_unit.hpp"
+#include "noctern/parser.hpp"
+#include "noctern/value_numbering.hpp"
+
+namespace noctern {
+    namespace {
+        // Hands loaded files from the loading threads to the front end threads.
+        class loaded_queue {
+        public:
+            struct entry {
+                size_t index;
+                source_file source;
+            };
+
+            void push(size_t index, source_file source) {
+                {
+                    std::lock_guard lock(mutex_);
+                    entries_.push_back(entry {.index = index, .source = std::move(source)});
+                }
+                ready_.notify_one();
+            }
+
+            // No more entries will be pushed.
+            void close() {
+                {
+                    std::lock_guard lock(mutex_);
+                    closed_ = true;
+                }
+                ready_.notify_all();
+            }
+
+            // Waits for the next entry. Empty once the queue is closed and drained.
+            std::optional<entry> pop() {
+                std::unique_lock lock(mutex_);
+                ready_.wait(lock, [&] { return closed_ || !entries_.empty(); });
+                if (entries_.empty()) return std::nullopt;
+                entry result = std::move(entries_.front());
+                entries_.pop_front();
+                return result;
+            }
+
+        private:
+            std::mutex mutex_;
+            std::condition_variable ready_;
+            std::deque<entry> entries_;
+            bool closed_ = false;
+        };
+    }
+
+    std::expected<program, std::string> program::compile(
+        std::span<const std::filesystem::path> paths, int num_threads,
+        const compile_cache* cache, source_io io) {
+        assert(num_threads >= 1);
+
+        program result;
+        result.files_.reserve(paths.size());
+        for (const std::filesystem::path& path : paths) {
+            result.files_.push_back(program_file(path));
+        }
+
+        std::vector<std::string> errors(paths.size());
+        const auto compile_file = [&](size_t i, source_file source) {
+            program_file& file = result.files_[i];
+            if (cache != nullptr) file.cached_ = cache->load(source.contents());
+            if (!file.cached_.has_value()) {
+                file.arena_ = std::make_unique<arena>();
+                file.tokens_ = noctern::eliminate_common_subexpressions(
+                    noctern::parse(noctern::tokenize_all(source.contents(), file.arena_.get())));
+            }
+
+            const compilation_unit unit(file.tokens());
+            file.fn_defs_.assign(unit.fn_defs().begin(), unit.fn_defs().end());
+            if (!file.cached_.has_value()) {
+                file.symbols_.emplace(*file.tokens_, unit);
+                if (cache != nullptr) {
+                    cache->store(source.contents(), *file.tokens_, *file.symbols_);
+                }
+                file.source_ = std::move(source);
+            }
+        };
+
+        // Files are compiled as soon as they're loaded, while the rest are still being read.
+        loaded_queue queue;
+        {
+            std::vector<std::jthread> workers;
+            for (int i = 0; i < num_threads; ++i) {
+                workers.emplace_back([&] {
+                    while (std::optional<loaded_queue::entry> loaded = queue.pop()) {
+                        compile_file(loaded->index, std::move(loaded->source));
+                    }
+                });
+            }
+
+            noctern::load_sources(paths, io, num_threads,
+                [&](size_t i, std::expected<source_file, std::error_code> source) {
+                    if (source.has_value()) {
+                        queue.push(i, std::move(*source));
+                    } else {
+                        errors[i] = fmt::format("Couldn't read file {}: {}",
+                            result.files_[i].path_.string(), source.error().message());
+                    }
+                });
+            queue.close();
+        }
+
+        for (std::string& error : errors) {
+            if (!error.empty()) return std::unexpected(std::move(error));
+        }
+
+        // Merged in file order, so that which definition wins doesn't depend on scheduling.
+        std::vector<fn_entry> fns;
+        std::vector<std::string_view> names;
+        for (size_t i = 0; i < result.files_.size(); ++i) {
+            const noctern::tokens& tokens = result.files_[i].tokens();
+            for (token fn_intro : result.files_[i].fn_defs()) {
+                const auto it = tokens.to_iterator(fn_intro);
+                assert(tokens.id(it[1]) == token_id::ident);
+                fns.push_back(fn_entry {
+                    .name = tokens.string(it[1]),
+                    .location = fn_location {.file = i, .decl = it[2]},
+                });
+                names.push_back(fns.back().name);
+            }
+        }
+
+        // Duplicates share their index, and only the first is stored there.
+        result.fn_hash_.emplace(names);
+        result.fn_table_.resize(result.fn_hash_->size());
+        for (const fn_entry& fn : fns) {
+            fn_entry& entry = result.fn_table_[(*result.fn_hash_)(fn.name)];
+            if (entry.name.empty()) {
+                entry = fn;
+            } else {
+                result.duplicates_.push_back(duplicate_definition {
+                    .name = fn.name,
+                    .first_file = entry.location.file,
+                    .duplicate_file = fn.location.file,
+                });
+            }
+        }
+
+        return result;
+    }
+
+    std::expected<std::vector<std::filesystem::path>, std::string> find_sources(
+        std::span<const std::string> args) {
+        std::vector<std::filesystem::path> result;
+        std::unordered_set<std::string> seen;
+        const auto add = [&](const std::filesystem::path& path) {
+            std::error_code error;
+            const std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+            if (seen.insert(error ? path.string() : canonical.string()).second) {
+                result.push_back(path);
+            }
+        };
+
+        for (const std::string& arg : args) {
+            std::error_code error;
+            if (!std::filesystem::is_directory(arg, error)) {
+                if (!std::filesystem::exists(arg, error)) {
+                    return std::unexpected(fmt::format("No such file or directory: {}", arg));
+                }
+                add(arg);
+                continue;
+            }
+
+            std::vector<std::filesystem::path> found;
+            for (auto it = std::filesystem::recursive_directory_iterator(arg, error);
+                 !error && it != std::filesystem::recursive_directory_iterator();
+                 it.increment(error)) {
+                if (it->is_regular_file(error) && it->path().extension() == ".nct") {
+                    found.push_back(it->path());
+                }
+            }
+            if (error) {
+                return std::unexpected(
+                    fmt::format("Couldn't search directory {}: {}", arg, error.message()));
+            }
+            std::sort(found.begin(), found.end());
+            std::ranges::for_each(found, add);
+        }
+        return result;
+    }
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+#include <expected>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "noctern/arena.hpp"
+#include "noctern/compile_cache.hpp"
+#include "noctern/perfect_hash.hpp"
+#include "noctern/source_file.hpp"
+#include "noctern/source_loader.hpp"
+#include "noctern/symbol_table.hpp"
+#include "noctern/tokenize.hpp"
+
+// Compiling a program spread over many source files.
+namespace noctern {
+    // The front end's result for one file of a `program`.
+    class program_file {
+    public:
+        const std::filesystem::path& path() const {
+            return path_;
+        }
+
+        const noctern::tokens& tokens() const {
+            return cached_.has_value() ? cached_->tokens() : *tokens_;
+        }
+
+        // The file's own functions.
+        const symbol_table& symbols() const {
+            return cached_.has_value() ? cached_->symbols() : *symbols_;
+        }
+
+        // The `fn_intro` of each function, in source order.
+        std::span<const token> fn_defs() const {
+            return fn_defs_;
+        }
+
+    private:
+        friend class program;
+
+        explicit program_file(std::filesystem::path path)
+            : path_(std::move(path)) {
+        }
+
+        std::filesystem::path path_;
+
+        // Holds everything compiled from `source_`, so it must outlive `tokens_` and `symbols_`.
+        std::unique_ptr<noctern::arena> arena_;
+
+        // Either the file came from the compile cache, or it was compiled from `source_`.
+        std::optional<cached_module> cached_;
+        std::optional<source_file> source_;
+        std::optional<noctern::tokens> tokens_;
+        std::optional<symbol_table> symbols_;
+
+        std::vector<token> fn_defs_;
+    };
+
+    // Where a function of a `program` is declared.
+    struct fn_location {
+        // Indexes `program::files()`.
+        size_t file;
+        // As for `symbol_table::find_fn_decl`, within the file's tokens.
+        token decl;
+    };
+
+    // A function defined more than once across a `program`.
+    struct duplicate_definition {
+        std::string_view name;
+        // The definition which `program::find_fn_decl` finds.
+        size_t first_file;
+        size_t duplicate_file;
+    };
+
+    // Many source files, compiled independently and sharing one namespace of functions.
+    class program {
+    public:
+        // Reads files through `io`, tokenizing and parsing each on one of `num_threads` threads as
+        // soon as it's loaded, then merges the files' functions. Files are loaded from (and stored
+        // to) `cache` if it's given.
+        //
+        // Fails if a file can't be read. Duplicate definitions are not an error here; see
+        // `duplicates()`.
+        static std::expected<program, std::string> compile(
+            std::span<const std::filesystem::path> paths, int num_threads,
+            const compile_cache* cache = nullptr, source_io io = source_io::io_uring);
+
+        std::span<const program_file> files() const {
+            return files_;
+        }
+
+        // Finds a function by name across all files. If it's defined more than once, finds the
+        // definition in the earliest file.
+        std::optional<fn_location> find_fn_decl(std::string_view name) const {
+            if (fn_table_.empty()) return std::nullopt;
+            const fn_entry& entry = fn_table_[(*fn_hash_)(name)];
+            if (entry.name != name) return std::nullopt;
+            return entry.location;
+        }
+
+        // Every definition which shadows an earlier one of the same name, in file order.
+        std::span<const duplicate_definition> duplicates() const {
+            return duplicates_;
+        }
+
+    private:
+        program() = default;
+
+        struct fn_entry {
+            std::string_view name;
+            fn_location location;
+        };
+
+        std::vector<program_file> files_;
+        // The functions never change once merged, so as in `symbol_table`, they're indexed by a
+        // perfect hash over their names: a lookup is one hash and one string comparison.
+        std::optional<perfect_hash> fn_hash_;
+        // Indexed by `fn_hash_`. Holds the first definition of each name.
+        std::vector<fn_entry> fn_table_;
+        std::vector<duplicate_definition> duplicates_;
+    };
+
+    // Expands the files and directories named by `args` into the source files of a program.
+    //
+    // Directories are searched recursively for `.nct` files, in sorted order. Files are taken
+    // whatever their extension. A file named more than once is only listed the first time.
+    std::expected<std::vector<std::filesystem::path>, std::string> find_sources(
+        std::span<const std::string> args);
+}
@@ -0,0 +1,124 @@
+#include "./program.hpp"
+
+#include <catch2/catch.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "noctern/interpreter.hpp"
+#include "noctern/temp_dir.test.hpp"
+
+namespace noctern {
+    namespace {
+        // Writes a source file under `dir`.
+        std::filesystem::path write(
+            const temp_dir& dir, const std::filesystem::path& name, std::string_view source) {
+            const std::filesystem::path path = dir.path() / name;
+            std::filesystem::create_directories(path.parent_path());
+            std::FILE* file = std::fopen(path.c_str(), "wb");
+            REQUIRE(file != nullptr);
+            std::fwrite(source.data(), 1, source.size(), file);
+            std::fclose(file);
+            return path;
+        }
+
+        double eval(const program& program, std::string_view name, interpreter::frame arguments) {
+            std::optional<fn_location> fn = program.find_fn_decl(name);
+            REQUIRE(fn.has_value());
+            const program_file& file = program.files()[fn->file];
+            return interpreter(file.symbols())
+                .eval_fn(file.tokens(), fn->decl, std::move(arguments));
+        }
+
+        TEST_CASE("program finds functions across files") {
+            const temp_dir dir;
+            std::vector<std::filesystem::path> paths;
+            for (int i = 0; i < 50; ++i) {
+                paths.push_back(noctern::write(dir, fmt::format("f{}.nct", i),
+                    fmt::format("def f{0}(x): x * {0};\ndef g{0}(): {{ let y = {0}; return y; }};",
+                        i)));
+            }
+
+            const int num_threads = GENERATE(1, 4);
+            const source_io io = GENERATE(source_io::mmap, source_io::pread, source_io::io_uring);
+            auto program = program::compile(paths, num_threads, nullptr, io);
+            REQUIRE(program.has_value());
+            CHECK(program->files().size() == paths.size());
+            CHECK(program->duplicates().empty());
+
+            for (int i = 0; i < 50; ++i) {
+                const std::string f = fmt::format("f{}", i);
+                REQUIRE(program->find_fn_decl(f).has_value());
+                CHECK(program->files()[program->find_fn_decl(f)->file].path() == paths[i]);
+                const interpreter::frame arguments {.locals = {{"x", 2}}, .expr_stack = {}};
+                CHECK(noctern::eval(*program, f, arguments) == 2 * i);
+                CHECK(noctern::eval(*program, fmt::format("g{}", i), interpreter::frame {}) == i);
+            }
+            CHECK_FALSE(program->find_fn_decl("h").has_value());
+        }
+
+        TEST_CASE("program reports duplicate definitions") {
+            const temp_dir dir;
+            const std::vector<std::filesystem::path> paths = {
+                noctern::write(dir, "a.nct", "def f(): 1;\ndef g(): 2;"),
+                noctern::write(dir, "b.nct", "def h(): 3;\ndef f(): 4;"),
+                noctern::write(dir, "c.nct", "def g(): 5;\ndef g(): 6;"),
+            };
+
+            auto program = program::compile(paths, 2);
+            REQUIRE(program.has_value());
+
+            REQUIRE(program->duplicates().size() == 3);
+            CHECK(program->duplicates()[0].name == "f");
+            CHECK(program->duplicates()[0].first_file == 0);
+            CHECK(program->duplicates()[0].duplicate_file == 1);
+            CHECK(program->duplicates()[1].name == "g");
+            CHECK(program->duplicates()[1].duplicate_file == 2);
+            CHECK(program->duplicates()[2].name == "g");
+            CHECK(program->duplicates()[2].duplicate_file == 2);
+
+            // The earliest definition wins.
+            CHECK(noctern::eval(*program, "f", interpreter::frame {}) == 1);
+            CHECK(noctern::eval(*program, "g", interpreter::frame {}) == 2);
+        }
+
+        TEST_CASE("program fails on unreadable files") {
+            const temp_dir dir;
+            const std::vector<std::filesystem::path> paths = {
+                noctern::write(dir, "a.nct", "def f(): 1;"),
+                dir.path() / "missing.nct",
+            };
+            auto program = program::compile(paths, 2);
+            REQUIRE_FALSE(program.has_value());
+            CHECK_THAT(program.error(), Catch::Contains("missing.nct"));
+        }
+
+        TEST_CASE("find_sources searches directories for .nct files") {
+            const temp_dir dir;
+            const auto b = noctern::write(dir, "lib/b.nct", "def b(): 1;");
+            const auto a = noctern::write(dir, "lib/a.nct", "def a(): 1;");
+            const auto nested = noctern::write(dir, "lib/nested/c.nct", "def c(): 1;");
+            noctern::write(dir, "lib/notes.txt", "not a source");
+            const auto main = noctern::write(dir, "main.src", "def Main(): 1;");
+
+            const std::vector<std::string> args = {main.string(), (dir.path() / "lib").string()};
+            auto sources = noctern::find_sources(args);
+            REQUIRE(sources.has_value());
+            CHECK(*sources == std::vector<std::filesystem::path> {main, a, b, nested});
+
+            // Files already found aren't repeated.
+            const std::vector<std::string> repeated = {a.string(), (dir.path() / "lib").string()};
+            sources = noctern::find_sources(repeated);
+            REQUIRE(sources.has_value());
+            CHECK(*sources == std::vector<std::filesystem::path> {a, b, nested});
+
+            const std::vector<std::string> missing = {(dir.path() / "nope").string()};
+            CHECK_FALSE(noctern::find_sources(missing).has_value());
+        }
+    }
+}
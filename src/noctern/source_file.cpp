@@ -0,0 +1,135 @@
+#include "./source_file.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace noctern {
+    namespace {
+        std::error_code last_error() {
+            return std::error_code(errno, std::system_category());
+        }
+
+        // Closes the file descriptor when leaving scope.
+        class fd_closer {
+        public:
+            explicit fd_closer(int fd)
+                : fd_(fd) {
+            }
+
+            fd_closer(const fd_closer&) = delete;
+            fd_closer& operator=(const fd_closer&) = delete;
+
+            ~fd_closer() {
+                ::close(fd_);
+            }
+
+        private:
+            int fd_;
+        };
+
+        constexpr size_t read_chunk_size = 64 * 1024;
+
+        // Reads the rest of `fd` into `buffer`, reserving `info`'s size up front for regular files.
+        std::error_code read_all(int fd, const struct stat& info, std::vector<char>& buffer) {
+            if (S_ISREG(info.st_mode)) buffer.reserve(static_cast<size_t>(info.st_size));
+            size_t size = 0;
+            while (true) {
+                buffer.resize(size + read_chunk_size);
+                const ssize_t count = ::read(fd, buffer.data() + size, read_chunk_size);
+                if (count == 0) break;
+                if (count == -1) {
+                    if (errno == EINTR) continue;
+                    return noctern::last_error();
+                }
+                size += static_cast<size_t>(count);
+            }
+            buffer.resize(size);
+            return {};
+        }
+    }
+
+    std::expected<source_file, std::error_code> source_file::open(const char* path) {
+        const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (fd == -1) return std::unexpected(noctern::last_error());
+        fd_closer closer(fd);
+
+        return source_file::read(fd);
+    }
+
+    std::expected<source_file, std::error_code> source_file::open_copy(const char* path) {
+        const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+        if (fd == -1) return std::unexpected(noctern::last_error());
+        fd_closer closer(fd);
+
+        struct stat info;
+        if (::fstat(fd, &info) != 0) return std::unexpected(noctern::last_error());
+        std::vector<char> buffer;
+        if (const std::error_code error = noctern::read_all(fd, info, buffer)) {
+            return std::unexpected(error);
+        }
+        return source_file::from_buffer(std::move(buffer));
+    }
+
+    std::expected<source_file, std::error_code> source_file::read(int fd) {
+        struct stat info;
+        if (::fstat(fd, &info) != 0) return std::unexpected(noctern::last_error());
+
+        source_file result;
+
+        // Only map from the start of the file, so that the mapping is page aligned.
+        if (S_ISREG(info.st_mode) && info.st_size > 0 && ::lseek(fd, 0, SEEK_CUR) == 0) {
+            const auto size = static_cast<size_t>(info.st_size);
+            void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED) {
+                // Both are only hints; failing to follow them is fine.
+                ::madvise(mapping, size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+                ::madvise(mapping, size, MADV_HUGEPAGE);
+#endif
+                result.mapping_ = static_cast<const char*>(mapping);
+                result.mapping_size_ = size;
+                return result;
+            }
+        }
+
+        if (const std::error_code error = noctern::read_all(fd, info, result.buffer_)) {
+            return std::unexpected(error);
+        }
+        return result;
+    }
+
+    void source_file::release_before(size_t offset) {
+        if (mapping_ == nullptr) return;
+
+        static const auto page_size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        const size_t length = std::min(offset, mapping_size_) / page_size * page_size;
+        if (length != 0) ::madvise(const_cast<char*>(mapping_), length, MADV_DONTNEED);
+    }
+
+    source_file::source_file(source_file&& rhs) noexcept
+        : mapping_(std::exchange(rhs.mapping_, nullptr))
+        , mapping_size_(std::exchange(rhs.mapping_size_, 0))
+        , buffer_(std::move(rhs.buffer_)) {
+    }
+
+    source_file& source_file::operator=(source_file&& rhs) noexcept {
+        if (this != &rhs) {
+            if (mapping_ != nullptr) ::munmap(const_cast<char*>(mapping_), mapping_size_);
+            mapping_ = std::exchange(rhs.mapping_, nullptr);
+            mapping_size_ = std::exchange(rhs.mapping_size_, 0);
+            buffer_ = std::move(rhs.buffer_);
+        }
+        return *this;
+    }
+
+    source_file::~source_file() {
+        if (mapping_ != nullptr) ::munmap(const_cast<char*>(mapping_), mapping_size_);
+    }
+}
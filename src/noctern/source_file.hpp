@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <expected>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace noctern {
+    // The contents of a source file, loaded without copying when possible.
+    //
+    // Regular files are memory mapped read-only, advised for sequential access (and for huge pages,
+    // where the kernel supports them for files). Anything else, such as a pipe, is read into a
+    // buffer.
+    //
+    // `contents()` stays valid for the lifetime of the `source_file`, including across moves, so it
+    // can be given straight to `tokenize_all`.
+    class source_file {
+    public:
+        static std::expected<source_file, std::error_code> open(const char* path);
+
+        // Like `open`, but always reads the file into a buffer. For files which may be truncated
+        // while the contents are in use, e.g. saved in place by an editor: reading a mapping past
+        // the file's new end raises SIGBUS.
+        static std::expected<source_file, std::error_code> open_copy(const char* path);
+
+        // Loads whatever remains in `fd`, e.g. `STDIN_FILENO`. Does not close `fd`.
+        static std::expected<source_file, std::error_code> read(int fd);
+
+        // Takes ownership of contents which were already read, e.g. by `load_sources`.
+        static source_file from_buffer(std::vector<char> contents) {
+            source_file result;
+            result.buffer_ = std::move(contents);
+            return result;
+        }
+
+        source_file(source_file&& rhs) noexcept;
+        source_file& operator=(source_file&& rhs) noexcept;
+        ~source_file();
+
+        std::string_view contents() const {
+            if (mapping_ != nullptr) return std::string_view(mapping_, mapping_size_);
+            return std::string_view(buffer_.data(), buffer_.size());
+        }
+
+        bool is_mapped() const {
+            return mapping_ != nullptr;
+        }
+
+        // Tells the kernel that the contents before `offset` won't be read again, so that a
+        // sequential pass over a large mapped file doesn't keep all of it resident. Only drops
+        // whole pages; does nothing for buffered contents.
+        void release_before(size_t offset);
+
+    private:
+        source_file() = default;
+
+        const char* mapping_ = nullptr;
+        size_t mapping_size_ = 0;
+
+        // A `vector` rather than a `string`, so that moves never relocate the contents.
+        std::vector<char> buffer_;
+    };
+}
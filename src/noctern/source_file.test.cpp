@@ -0,0 +1,88 @@
+#include "./source_file.hpp"
+
+#include <catch2/catch.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+#include "noctern/temp_dir.test.hpp"
+
+#include <unistd.h>
+
+namespace noctern {
+    namespace {
+        constexpr std::string_view source = "def Main(): { let x = 1; return x * 2; };\n";
+
+        TEST_CASE("source_file maps regular files") {
+            const temp_dir dir;
+            const std::filesystem::path path = dir / "source.nct";
+            std::FILE* file = std::fopen(path.c_str(), "wb");
+            REQUIRE(file != nullptr);
+            std::fwrite(source.data(), 1, source.size(), file);
+            std::fclose(file);
+
+            auto loaded = source_file::open(path.c_str());
+            REQUIRE(loaded.has_value());
+            CHECK(loaded->is_mapped());
+            CHECK(loaded->contents() == source);
+
+            // Moving keeps the contents in place.
+            const char* data = loaded->contents().data();
+            source_file moved = std::move(*loaded);
+            CHECK(moved.contents().data() == data);
+        }
+
+        TEST_CASE("source_file copies files on request") {
+            const temp_dir dir;
+            const std::filesystem::path path = dir / "source.nct";
+            std::FILE* file = std::fopen(path.c_str(), "wb");
+            REQUIRE(file != nullptr);
+            std::fwrite(source.data(), 1, source.size(), file);
+            std::fclose(file);
+
+            auto loaded = source_file::open_copy(path.c_str());
+            REQUIRE(loaded.has_value());
+            CHECK_FALSE(loaded->is_mapped());
+
+            // Unaffected by truncating the file, which would make reading a mapping fault.
+            std::filesystem::resize_file(path, 0);
+            CHECK(loaded->contents() == source);
+        }
+
+        TEST_CASE("source_file reads pipes") {
+            int fds[2];
+            REQUIRE(::pipe(fds) == 0);
+
+            // Bigger than the pipe's buffer, to need several reads.
+            std::string contents;
+            while (contents.size() < 256 * 1024) {
+                contents += source;
+            }
+
+            std::thread writer([&] {
+                std::string_view remaining = contents;
+                while (!remaining.empty()) {
+                    const ssize_t count = ::write(fds[1], remaining.data(), remaining.size());
+                    if (count <= 0) break;
+                    remaining.remove_prefix(static_cast<size_t>(count));
+                }
+                ::close(fds[1]);
+            });
+
+            auto loaded = source_file::read(fds[0]);
+            writer.join();
+            ::close(fds[0]);
+
+            REQUIRE(loaded.has_value());
+            CHECK_FALSE(loaded->is_mapped());
+            CHECK(loaded->contents() == contents);
+        }
+
+        TEST_CASE("source_file reports missing files") {
+            auto loaded = source_file::open("/nonexistent/noctern/file.nct");
+            REQUIRE_FALSE(loaded.has_value());
+            CHECK(loaded.error() == std::errc::no_such_file_or_directory);
+        }
+    }
+}
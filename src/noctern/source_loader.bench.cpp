@@ -0,0 +1,104 @@
+#include "./source_loader.hpp"
+
+#include <atomic>
+#include <catch2/catch.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+namespace noctern {
+    namespace {
+        // Many small source files, as in a large multi-file build.
+        class source_tree {
+        public:
+            explicit source_tree(int num_files)
+                : dir_(std::filesystem::temp_directory_path() / "noctern.source_loader.bench") {
+                std::filesystem::remove_all(dir_);
+                std::filesystem::create_directories(dir_);
+                for (int i = 0; i < num_files; ++i) {
+                    std::string source;
+                    for (int j = 0; j < 40; ++j) {
+                        source += fmt::format(
+                            "def f{}_{}(x, y): {{ let a = x * {}; return a - y; }};\n", i, j, j);
+                    }
+                    paths_.push_back(dir_ / fmt::format("f{}.nct", i));
+                    std::FILE* file = std::fopen(paths_.back().c_str(), "wb");
+                    std::fwrite(source.data(), 1, source.size(), file);
+                    std::fclose(file);
+                }
+            }
+
+            source_tree(const source_tree&) = delete;
+            source_tree& operator=(const source_tree&) = delete;
+
+            ~source_tree() {
+                std::filesystem::remove_all(dir_);
+            }
+
+            const std::vector<std::filesystem::path>& paths() const {
+                return paths_;
+            }
+
+        private:
+            std::filesystem::path dir_;
+            std::vector<std::filesystem::path> paths_;
+        };
+
+        // How nocternc used to read its input.
+        size_t load_with_fread(const std::filesystem::path& path) {
+            std::FILE* file = std::fopen(path.c_str(), "rb");
+            std::fseek(file, 0, SEEK_END);
+            std::string contents(static_cast<size_t>(std::ftell(file)), '\0');
+            std::fseek(file, 0, SEEK_SET);
+            const size_t size = std::fread(contents.data(), 1, contents.size(), file);
+            std::fclose(file);
+            return size;
+        }
+
+        TEST_CASE("loading many source files", "[benchmark]") {
+            const int num_files = GENERATE(100, 2000);
+            const source_tree tree(num_files);
+
+            BENCHMARK(fmt::format("{} files, sequential fopen/fread", num_files)) {
+                size_t total = 0;
+                for (const std::filesystem::path& path : tree.paths()) {
+                    total += noctern::load_with_fread(path);
+                }
+                return total;
+            };
+
+            BENCHMARK(fmt::format("{} files, sequential source_file::open", num_files)) {
+                size_t total = 0;
+                for (const std::filesystem::path& path : tree.paths()) {
+                    total += source_file::open(path.c_str())->contents().size();
+                }
+                return total;
+            };
+
+            const auto load_all = [&](source_io io, int num_threads) {
+                std::atomic<size_t> total = 0;
+                noctern::load_sources(tree.paths(), io, num_threads,
+                    [&](size_t, std::expected<source_file, std::error_code> source) {
+                        total += source->contents().size();
+                    });
+                return total.load();
+            };
+
+            for (int num_threads : {1, 4}) {
+                BENCHMARK(fmt::format("{} files, mmap on {} threads", num_files, num_threads)) {
+                    return load_all(source_io::mmap, num_threads);
+                };
+                BENCHMARK(fmt::format("{} files, pread on {} threads", num_files, num_threads)) {
+                    return load_all(source_io::pread, num_threads);
+                };
+            }
+
+            BENCHMARK(fmt::format("{} files, io_uring", num_files)) {
+                return load_all(source_io::io_uring, 1);
+            };
+        }
+    }
+}
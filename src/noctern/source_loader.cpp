@@ -0,0 +1,483 @@
+#include "./source_loader.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace noctern {
+    namespace {
+        std::error_code last_error() {
+            return std::error_code(errno, std::system_category());
+        }
+
+        // Closes the file descriptor when leaving scope.
+        class fd_closer {
+        public:
+            explicit fd_closer(int fd)
+                : fd_(fd) {
+            }
+
+            fd_closer(const fd_closer&) = delete;
+            fd_closer& operator=(const fd_closer&) = delete;
+
+            ~fd_closer() {
+                ::close(fd_);
+            }
+
+        private:
+            int fd_;
+        };
+
+        // Reads at most this much per request, which keeps the length within what both `pread`
+        // and io_uring reads accept.
+        constexpr size_t max_read_size = size_t {1} << 30;
+
+        std::expected<source_file, std::error_code> pread_file(const char* path) {
+            const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+            if (fd == -1) return std::unexpected(noctern::last_error());
+            fd_closer closer(fd);
+
+            struct stat info;
+            if (::fstat(fd, &info) != 0) return std::unexpected(noctern::last_error());
+            if (!S_ISREG(info.st_mode)) return source_file::read(fd);
+
+            std::vector<char> buffer(static_cast<size_t>(info.st_size));
+            size_t size = 0;
+            while (size < buffer.size()) {
+                const ssize_t count = ::pread(fd, buffer.data() + size,
+                    std::min(buffer.size() - size, max_read_size), static_cast<off_t>(size));
+                if (count == 0) break;
+                if (count == -1) {
+                    if (errno == EINTR) continue;
+                    return std::unexpected(noctern::last_error());
+                }
+                size += static_cast<size_t>(count);
+            }
+            // The file may have shrunk since the `fstat`.
+            buffer.resize(size);
+            return source_file::from_buffer(std::move(buffer));
+        }
+
+        void load_on_pool(std::span<const std::filesystem::path> paths, int num_threads,
+            std::expected<source_file, std::error_code> (*load)(const char*),
+            const source_loaded_fn& on_loaded) {
+            std::atomic<size_t> next_file = 0;
+            const auto load_files = [&] {
+                for (size_t i = next_file++; i < paths.size(); i = next_file++) {
+                    on_loaded(i, load(paths[i].c_str()));
+                }
+            };
+
+            const size_t num_workers = std::min(static_cast<size_t>(num_threads), paths.size());
+            std::vector<std::jthread> workers;
+            // The calling thread works too.
+            for (size_t i = 1; i < num_workers; ++i) {
+                workers.emplace_back(load_files);
+            }
+            load_files();
+        }
+
+        // A minimal io_uring, driven through the raw system calls.
+        class io_ring {
+        public:
+            static std::unique_ptr<io_ring> create(unsigned entries) {
+                io_uring_params params {};
+                const int fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+                if (fd < 0) return nullptr;
+
+                // Single mmap (5.4), no dropped completions (5.5), and the opcodes of 5.6, for
+                // which `IORING_FEAT_RW_CUR_POS` stands in.
+                constexpr uint32_t needed_features
+                    = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_RW_CUR_POS;
+                if ((params.features & needed_features) != needed_features) {
+                    ::close(fd);
+                    return nullptr;
+                }
+
+                const size_t ring_size
+                    = std::max(params.sq_off.array + params.sq_entries * sizeof(uint32_t),
+                        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+                void* ring = ::mmap(nullptr, ring_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+                if (ring == MAP_FAILED) {
+                    ::close(fd);
+                    return nullptr;
+                }
+                const size_t sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+                void* sqes = ::mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+                if (sqes == MAP_FAILED) {
+                    ::munmap(ring, ring_size);
+                    ::close(fd);
+                    return nullptr;
+                }
+
+                return std::unique_ptr<io_ring>(
+                    new io_ring(fd, params, static_cast<char*>(ring), ring_size,
+                        static_cast<io_uring_sqe*>(sqes), sqes_size));
+            }
+
+            io_ring(const io_ring&) = delete;
+            io_ring& operator=(const io_ring&) = delete;
+
+            ~io_ring() {
+                ::munmap(sqes_, sqes_size_);
+                ::munmap(ring_, ring_size_);
+                ::close(fd_);
+            }
+
+            unsigned capacity() const {
+                return num_entries_;
+            }
+
+            // The next submission queue entry, zeroed. The caller must not queue more than
+            // `capacity()` entries between calls to `submit_and_wait`.
+            io_uring_sqe& next_sqe() {
+                const uint32_t index = sq_tail_ & sq_mask_;
+                io_uring_sqe& sqe = sqes_[index];
+                std::memset(&sqe, 0, sizeof(sqe));
+                sq_array_[index] = index;
+                ++sq_tail_;
+                ++num_queued_;
+                return sqe;
+            }
+
+            // Submits the queued entries and waits for at least `wait_for` completions.
+            std::error_code submit_and_wait(unsigned wait_for) {
+                std::atomic_ref(*sq_tail_shared_).store(sq_tail_, std::memory_order_release);
+                while (true) {
+                    const long submitted = ::syscall(__NR_io_uring_enter, fd_, num_queued_,
+                        wait_for, IORING_ENTER_GETEVENTS, nullptr, 0);
+                    if (submitted >= 0) {
+                        num_queued_ -= static_cast<unsigned>(submitted);
+                        if (num_queued_ == 0) return {};
+                        // Only part was taken; the rest goes with the next call.
+                        wait_for = 0;
+                        continue;
+                    }
+                    if (errno == EINTR) continue;
+                    return noctern::last_error();
+                }
+            }
+
+            // Waits for at least `wait_for` completions, without submitting anything.
+            std::error_code wait(unsigned wait_for) {
+                while (true) {
+                    if (::syscall(__NR_io_uring_enter, fd_, 0, wait_for, IORING_ENTER_GETEVENTS,
+                            nullptr, 0)
+                        >= 0) {
+                        return {};
+                    }
+                    if (errno != EINTR) return noctern::last_error();
+                }
+            }
+
+            // The entries queued which the kernel hasn't taken yet.
+            unsigned num_unsubmitted() const {
+                return num_queued_;
+            }
+
+            // Calls `fn(user_data, result)` for each completion which has arrived.
+            template <typename Fn>
+            void for_each_completion(Fn&& fn) {
+                uint32_t head = *cq_head_;
+                const uint32_t tail = std::atomic_ref(*cq_tail_).load(std::memory_order_acquire);
+                for (; head != tail; ++head) {
+                    const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+                    fn(cqe.user_data, cqe.res);
+                }
+                std::atomic_ref(*cq_head_).store(head, std::memory_order_release);
+            }
+
+        private:
+            io_ring(int fd, const io_uring_params& params, char* ring, size_t ring_size,
+                io_uring_sqe* sqes, size_t sqes_size)
+                : fd_(fd)
+                , num_entries_(params.sq_entries)
+                , ring_(ring)
+                , ring_size_(ring_size)
+                , sqes_(sqes)
+                , sqes_size_(sqes_size)
+                , sq_tail_shared_(reinterpret_cast<uint32_t*>(ring + params.sq_off.tail))
+                , sq_mask_(*reinterpret_cast<uint32_t*>(ring + params.sq_off.ring_mask))
+                , sq_array_(reinterpret_cast<uint32_t*>(ring + params.sq_off.array))
+                , cq_head_(reinterpret_cast<uint32_t*>(ring + params.cq_off.head))
+                , cq_tail_(reinterpret_cast<uint32_t*>(ring + params.cq_off.tail))
+                , cq_mask_(*reinterpret_cast<uint32_t*>(ring + params.cq_off.ring_mask))
+                , cqes_(reinterpret_cast<io_uring_cqe*>(ring + params.cq_off.cqes))
+                , sq_tail_(*sq_tail_shared_) {
+            }
+
+            int fd_;
+            unsigned num_entries_;
+            char* ring_;
+            size_t ring_size_;
+            io_uring_sqe* sqes_;
+            size_t sqes_size_;
+
+            uint32_t* sq_tail_shared_;
+            uint32_t sq_mask_;
+            uint32_t* sq_array_;
+            uint32_t* cq_head_;
+            uint32_t* cq_tail_;
+            uint32_t cq_mask_;
+            io_uring_cqe* cqes_;
+
+            // Entries queued locally, but not yet published to the kernel.
+            uint32_t sq_tail_;
+            unsigned num_queued_ = 0;
+        };
+
+        // The number of queue entries. Each file in flight needs at most two at once, plus one
+        // to close it.
+        constexpr unsigned ring_entries = 256;
+        constexpr size_t max_files_in_flight = ring_entries / 4;
+
+        // Loads files through an `io_ring`, with up to `max_files_in_flight` at various stages.
+        //
+        // Each file's open and statx are submitted together. Once both are done, the whole file is
+        // read, and the read resubmitted if it comes up short. Once it's read, the file is handed
+        // over and its close submitted without waiting for it.
+        class uring_loader {
+        public:
+            uring_loader(io_ring& ring, std::span<const std::filesystem::path> paths,
+                const source_loaded_fn& on_loaded)
+                : ring_(ring)
+                , paths_(paths)
+                , on_loaded_(on_loaded)
+                , slots_(std::min(max_files_in_flight, paths.size())) {
+                for (size_t i = 0; i < slots_.size(); ++i) {
+                    free_slots_.push_back(i);
+                }
+            }
+
+            // Returns false if requests may still be in flight, when the kernel may yet write into
+            // the loader: then it must outlive the call, along with the ring.
+            bool run() {
+                while (next_file_ < paths_.size() || num_in_flight_ > 0) {
+                    while (next_file_ < paths_.size() && !free_slots_.empty()
+                        && num_in_flight_ + 3 <= ring_.capacity()) {
+                        start(next_file_++);
+                    }
+
+                    if (std::error_code error = ring_.submit_and_wait(1); error) {
+                        // Nothing more can be done through the ring; fail what's left.
+                        return fail_remaining(error);
+                    }
+                    ring_.for_each_completion(
+                        [&](uint64_t user_data, int32_t result) { complete(user_data, result); });
+                }
+                return true;
+            }
+
+        private:
+            enum class operation : uint64_t { open, statx, read, close };
+
+            struct file_state {
+                size_t file = 0;
+                int fd = -1;
+                // The error of the first failed operation, if any.
+                int error = 0;
+                unsigned num_pending = 0;
+                struct statx info = {};
+                std::vector<char> buffer;
+                size_t size = 0;
+            };
+
+            static uint64_t user_data(size_t slot, operation operation) {
+                return (static_cast<uint64_t>(slot) << 2) | static_cast<uint64_t>(operation);
+            }
+
+            void start(size_t file) {
+                const size_t index = free_slots_.back();
+                free_slots_.pop_back();
+                file_state& slot = slots_[index];
+                slot = file_state {};
+                slot.file = file;
+                slot.num_pending = 2;
+                const char* path = paths_[file].c_str();
+
+                io_uring_sqe& open = ring_.next_sqe();
+                open.opcode = IORING_OP_OPENAT;
+                open.fd = AT_FDCWD;
+                open.addr = reinterpret_cast<uint64_t>(path);
+                open.open_flags = O_RDONLY | O_CLOEXEC;
+                open.user_data = user_data(index, operation::open);
+
+                io_uring_sqe& stat = ring_.next_sqe();
+                stat.opcode = IORING_OP_STATX;
+                stat.fd = AT_FDCWD;
+                stat.addr = reinterpret_cast<uint64_t>(path);
+                stat.len = STATX_TYPE | STATX_SIZE;
+                stat.off = reinterpret_cast<uint64_t>(&slot.info);
+                stat.user_data = user_data(index, operation::statx);
+
+                num_in_flight_ += 2;
+            }
+
+            void submit_read(size_t index) {
+                file_state& slot = slots_[index];
+                io_uring_sqe& read = ring_.next_sqe();
+                read.opcode = IORING_OP_READ;
+                read.fd = slot.fd;
+                read.addr = reinterpret_cast<uint64_t>(slot.buffer.data() + slot.size);
+                read.len = static_cast<uint32_t>(
+                    std::min(slot.buffer.size() - slot.size, max_read_size));
+                read.off = slot.size;
+                read.user_data = user_data(index, operation::read);
+                ++slot.num_pending;
+                ++num_in_flight_;
+            }
+
+            void complete(uint64_t user_data, int32_t result) {
+                --num_in_flight_;
+                const auto op = static_cast<operation>(user_data & 3);
+                if (op == operation::close) return;
+
+                const size_t index = static_cast<size_t>(user_data >> 2);
+                file_state& slot = slots_[index];
+                --slot.num_pending;
+                if (result < 0) {
+                    if (slot.error == 0) slot.error = -result;
+                } else if (op == operation::open) {
+                    slot.fd = result;
+                } else if (op == operation::read) {
+                    if (result == 0) {
+                        // The file shrank since the statx.
+                        slot.buffer.resize(slot.size);
+                    }
+                    slot.size += static_cast<size_t>(result);
+                }
+                if (slot.num_pending != 0) return;
+
+                if (slot.error == 0 && op != operation::read) {
+                    // Both the open and the statx are done.
+                    if (!S_ISREG(slot.info.stx_mode)) {
+                        finish(index, source_file::read(slot.fd));
+                        return;
+                    }
+                    slot.buffer.resize(static_cast<size_t>(slot.info.stx_size));
+                }
+                if (slot.error == 0 && slot.size < slot.buffer.size()) {
+                    submit_read(index);
+                    return;
+                }
+
+                if (slot.error != 0) {
+                    finish(index,
+                        std::unexpected(std::error_code(slot.error, std::system_category())));
+                } else {
+                    finish(index, source_file::from_buffer(std::move(slot.buffer)));
+                }
+            }
+
+            void finish(size_t index, std::expected<source_file, std::error_code> source) {
+                file_state& slot = slots_[index];
+                if (slot.fd != -1) {
+                    if (num_in_flight_ < ring_.capacity()) {
+                        io_uring_sqe& close = ring_.next_sqe();
+                        close.opcode = IORING_OP_CLOSE;
+                        close.fd = slot.fd;
+                        close.user_data = user_data(0, operation::close);
+                        ++num_in_flight_;
+                    } else {
+                        ::close(slot.fd);
+                    }
+                }
+                free_slots_.push_back(index);
+                on_loaded_(slot.file, std::move(source));
+            }
+
+            // Fails the files in flight and those not started yet. Returns whether everything the
+            // kernel took has completed, as `run` does.
+            bool fail_remaining(std::error_code error) {
+                for (file_state& slot : slots_) {
+                    if (slot.num_pending != 0) on_loaded_(slot.file, std::unexpected(error));
+                }
+                for (; next_file_ < paths_.size(); ++next_file_) {
+                    on_loaded_(next_file_, std::unexpected(error));
+                }
+
+                // What the kernel took may still write into `slots_`, so wait for all of it. It
+                // only takes the entries it's given, so the rest never run.
+                unsigned num_submitted = num_in_flight_ - ring_.num_unsubmitted();
+                while (num_submitted > 0) {
+                    if (ring_.wait(1)) return false;
+                    ring_.for_each_completion([&](uint64_t user_data, int32_t result) {
+                        --num_submitted;
+                        if (static_cast<operation>(user_data & 3) == operation::open
+                            && result >= 0) {
+                            ::close(result);
+                        }
+                    });
+                }
+                for (file_state& slot : slots_) {
+                    if (slot.num_pending != 0 && slot.fd != -1) ::close(slot.fd);
+                }
+                return true;
+            }
+
+            io_ring& ring_;
+            std::span<const std::filesystem::path> paths_;
+            const source_loaded_fn& on_loaded_;
+
+            std::vector<file_state> slots_;
+            std::vector<size_t> free_slots_;
+            size_t next_file_ = 0;
+            unsigned num_in_flight_ = 0;
+        };
+    }
+
+    std::optional<source_io> parse_source_io(std::string_view name) {
+        if (name == "mmap") return source_io::mmap;
+        if (name == "pread") return source_io::pread;
+        if (name == "io_uring") return source_io::io_uring;
+        return std::nullopt;
+    }
+
+    bool io_uring_available() {
+        static const bool available = io_ring::create(1) != nullptr;
+        return available;
+    }
+
+    void load_sources(std::span<const std::filesystem::path> paths, source_io io,
+        int num_threads, const source_loaded_fn& on_loaded) {
+        assert(num_threads >= 1);
+        if (paths.empty()) return;
+
+        switch (io) {
+        case source_io::mmap:
+            noctern::load_on_pool(paths, num_threads, &source_file::open, on_loaded);
+            return;
+        case source_io::pread:
+            noctern::load_on_pool(paths, num_threads, &noctern::pread_file, on_loaded);
+            return;
+        case source_io::io_uring:
+            if (std::unique_ptr<io_ring> ring = io_ring::create(ring_entries)) {
+                auto loader = std::make_unique<uring_loader>(*ring, paths, on_loaded);
+                if (!loader->run()) {
+                    // The kernel may still write into either, so neither can be freed.
+                    [[maybe_unused]] io_ring* leaked_ring = ring.release();
+                    [[maybe_unused]] uring_loader* leaked_loader = loader.release();
+                }
+            } else {
+                noctern::load_on_pool(paths, num_threads, &noctern::pread_file, on_loaded);
+            }
+            return;
+        }
+    }
+}
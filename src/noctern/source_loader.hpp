@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <expected>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <system_error>
+
+#include "noctern/source_file.hpp"
+
+namespace noctern {
+    // How `load_sources` reads files.
+    enum class source_io {
+        // A pool of threads, each loading whole files with `source_file::open`, i.e. by mapping
+        // them.
+        mmap,
+        // A pool of threads, each loading whole files with `open`, `fstat` and `pread`.
+        pread,
+        // One thread submitting the opens, stats, reads and closes of many files at once through
+        // io_uring. Falls back to `pread` where io_uring is unavailable.
+        io_uring,
+    };
+
+    std::optional<source_io> parse_source_io(std::string_view name);
+
+    // Whether the kernel supports everything `source_io::io_uring` needs.
+    bool io_uring_available();
+
+    using source_loaded_fn
+        = std::function<void(size_t index, std::expected<source_file, std::error_code> source)>;
+
+    // Loads each of `paths`, calling `on_loaded` with its index as soon as each has been read, so
+    // that it can be processed while the rest are still loading.
+    //
+    // Files complete in no particular order. `on_loaded` is called from the loading threads, and
+    // concurrently for the thread pools. Returns once every file has been handed to `on_loaded`.
+    void load_sources(std::span<const std::filesystem::path> paths, source_io io,
+        int num_threads, const source_loaded_fn& on_loaded);
+}
@@ -0,0 +1,70 @@
+#include "./source_loader.hpp"
+
+#include <catch2/catch.hpp>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "noctern/temp_dir.test.hpp"
+
+namespace noctern {
+    namespace {
+        TEST_CASE("load_sources loads every file") {
+            const temp_dir dir;
+
+            // More files than are in flight at once, of various sizes, including empty.
+            std::vector<std::filesystem::path> paths;
+            std::vector<std::string> contents;
+            for (int i = 0; i < 200; ++i) {
+                std::string source;
+                for (int j = 0; j < i * 37 % 500; ++j) {
+                    source += fmt::format("def f{}_{}(x): x * {};\n", i, j, j);
+                }
+                paths.push_back(dir / fmt::format("f{}.nct", i));
+                std::FILE* file = std::fopen(paths.back().c_str(), "wb");
+                REQUIRE(file != nullptr);
+                std::fwrite(source.data(), 1, source.size(), file);
+                std::fclose(file);
+                contents.push_back(std::move(source));
+            }
+            paths.push_back(dir / "missing.nct");
+
+            const source_io io = GENERATE(source_io::mmap, source_io::pread, source_io::io_uring);
+            const int num_threads = GENERATE(1, 3);
+
+            std::mutex mutex;
+            std::vector<int> num_loads(paths.size());
+            std::vector<std::string> loaded(paths.size());
+            std::vector<std::error_code> errors(paths.size());
+            noctern::load_sources(paths, io, num_threads,
+                [&](size_t i, std::expected<source_file, std::error_code> source) {
+                    std::lock_guard lock(mutex);
+                    ++num_loads[i];
+                    if (source.has_value()) {
+                        loaded[i] = std::string(source->contents());
+                    } else {
+                        errors[i] = source.error();
+                    }
+                });
+
+            for (size_t i = 0; i < contents.size(); ++i) {
+                CHECK(num_loads[i] == 1);
+                CHECK(!errors[i]);
+                CHECK(loaded[i] == contents[i]);
+            }
+            CHECK(num_loads.back() == 1);
+            CHECK(errors.back() == std::errc::no_such_file_or_directory);
+        }
+
+        TEST_CASE("parse_source_io") {
+            CHECK(noctern::parse_source_io("mmap") == source_io::mmap);
+            CHECK(noctern::parse_source_io("pread") == source_io::pread);
+            CHECK(noctern::parse_source_io("io_uring") == source_io::io_uring);
+            CHECK_FALSE(noctern::parse_source_io("aio").has_value());
+        }
+    }
+}
@@ -0,0 +1,75 @@
+#include "./specialize.hpp"
+
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+
+#include "noctern/compiled_fn.hpp"
+#include "noctern/ir.hpp"
+
+namespace noctern {
+    namespace {
+        using ir::value_id;
+
+        std::string cache_key(std::string_view name, std::span<const std::optional<double>> bound) {
+            std::string key(name);
+            for (const std::optional<double>& value : bound) {
+                if (!value.has_value()) {
+                    key.push_back('\0');
+                    continue;
+                }
+                key.push_back('\1');
+                const auto bits = std::bit_cast<uint64_t>(*value);
+                for (int shift = 0; shift < 64; shift += 8) {
+                    key.push_back(static_cast<char>(bits >> shift));
+                }
+            }
+            return key;
+        }
+    }
+
+    ir::function specialize(const ir::function& fn, std::span<const std::optional<double>> bound) {
+        assert(bound.size() == static_cast<size_t>(fn.num_params()));
+
+        ir::rewriter rewriter(fn, bound);
+        for (value_id id = fn.num_params(); id < static_cast<value_id>(fn.instructions.size());
+            ++id) {
+            const ir::instruction& inst = fn.instructions[id];
+            const int num_operands = ir::num_operands(inst.op);
+
+            std::array<double, 3> constants = {};
+            bool all_constant = num_operands != 0;
+            for (int i = 0; i < num_operands && all_constant; ++i) {
+                const double* constant = rewriter.constant_value(rewriter.map(inst.args[i]));
+                all_constant = constant != nullptr;
+                if (all_constant) constants[i] = *constant;
+            }
+
+            if (all_constant) {
+                rewriter.set_mapping(id,
+                    rewriter.add_constant(
+                        ir::apply(inst.op, constants[0], constants[1], constants[2])));
+            } else {
+                rewriter.set_mapping(id, rewriter.copy(id));
+            }
+        }
+
+        return ir::eliminate_dead_code(std::move(rewriter).finish());
+    }
+
+    const compiled_fn* specialization_cache::get(
+        std::string_view name, std::span<const std::optional<double>> bound) {
+        std::string key = noctern::cache_key(name, bound);
+        if (auto it = cache_.find(key); it != cache_.end()) {
+            return &it->second;
+        }
+
+        const ir::function* fn = module_.find(name);
+        if (fn == nullptr || bound.size() != static_cast<size_t>(fn->num_params())) return nullptr;
+
+        auto [it, inserted] = cache_.emplace(
+            std::move(key), noctern::lower(noctern::specialize(*fn, bound)));
+        return &it->second;
+    }
+}
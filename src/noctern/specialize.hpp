@@ -0,0 +1,48 @@
+#pragma once
+
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "noctern/compiled_fn.hpp"
+#include "noctern/ir.hpp"
+
+namespace noctern {
+    // Partially evaluates `fn` with some of its arguments known.
+    //
+    // `bound` has one entry per parameter of `fn`. Bound parameters are substituted as constants
+    // and folded through the body, and whatever no longer contributes to the result is removed. The
+    // result takes the unbound parameters, in their original order.
+    //
+    // Folding rounds exactly as evaluation would, so the result is bit-identical to calling `fn`.
+    ir::function specialize(const ir::function& fn, std::span<const std::optional<double>> bound);
+
+    // Caches compiled specializations of the functions in a module, e.g. for functions which are
+    // called with per-tenant arguments fixed.
+    //
+    // Not thread safe.
+    class specialization_cache {
+    public:
+        // `module` must outlive the cache.
+        explicit specialization_cache(const ir::module& module)
+            : module_(module) {
+        }
+
+        // The function `name` specialized on `bound`, compiled on first use. Returns `nullptr` if
+        // there is no such function, or `bound` doesn't have one entry per parameter of it. The
+        // reference stays valid for the cache's lifetime.
+        const compiled_fn* get(std::string_view name, std::span<const std::optional<double>> bound);
+
+        size_t size() const {
+            return cache_.size();
+        }
+
+    private:
+        const ir::module& module_;
+
+        // Keyed by the function name followed by the bits of each binding.
+        std::unordered_map<std::string, compiled_fn> cache_;
+    };
+}
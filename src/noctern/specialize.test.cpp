@@ -0,0 +1,89 @@
+#include "./specialize.hpp"
+
+#include <bit>
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "noctern/compiled_fn.hpp"
+#include "noctern/ir.hpp"
+#include "noctern/parser.hpp"
+#include "noctern/tokenize.hpp"
+
+namespace noctern {
+    namespace {
+        constexpr std::string_view source = R"(
+            def price(amount, rate, scale): {
+                let fee = rate * scale + 0.5;
+                let unused = scale / 3;
+                return amount * (1 + fee) / scale;
+            };
+        )";
+
+        TEST_CASE("specialize folds bound arguments") {
+            ir::module module = ir::build(noctern::parse(noctern::tokenize_all(source)));
+            const ir::function& fn = module.functions[0];
+
+            std::vector<std::optional<double>> bound = {std::nullopt, 0.25, 4.0};
+            ir::function result = noctern::specialize(fn, bound);
+
+            CHECK(ir::verify(result).empty());
+            // The parser is right associative: `amount * ((1 + fee) / scale)`.
+            CHECK(ir::dump(result)
+                == "fn price(%0 amount) {\n"
+                   "  %1 = constant 0.625\n"
+                   "  %2 = mul %0, %1\n"
+                   "  return %2\n"
+                   "}\n");
+
+            compiled_fn general = noctern::lower(fn);
+            compiled_fn specialized = noctern::lower(result);
+            for (double amount : {0.0, 13.37, -1e300}) {
+                CHECK(std::bit_cast<uint64_t>(specialized.call(std::vector<double> {amount}))
+                    == std::bit_cast<uint64_t>(
+                        general.call(std::vector<double> {amount, 0.25, 4.0})));
+            }
+        }
+
+        TEST_CASE("specialize with every argument bound is a constant") {
+            ir::module module = ir::build(noctern::parse(noctern::tokenize_all(source)));
+
+            std::vector<std::optional<double>> bound = {2.0, 0.25, 4.0};
+            ir::function result = noctern::specialize(module.functions[0], bound);
+
+            CHECK(ir::dump(result)
+                == "fn price() {\n"
+                   "  %0 = constant 1.25\n"
+                   "  return %0\n"
+                   "}\n");
+        }
+
+        TEST_CASE("specialization_cache reuses specializations") {
+            ir::module module = ir::build(noctern::parse(noctern::tokenize_all(source)));
+            specialization_cache cache(module);
+
+            std::vector<std::optional<double>> tenant_a = {std::nullopt, 0.25, 4.0};
+            std::vector<std::optional<double>> tenant_b = {std::nullopt, 0.5, 4.0};
+
+            const compiled_fn* a = cache.get("price", tenant_a);
+            REQUIRE(a != nullptr);
+            CHECK(a->num_params() == 1);
+            CHECK(cache.get("price", tenant_a) == a);
+            CHECK(cache.size() == 1);
+
+            const compiled_fn* b = cache.get("price", tenant_b);
+            REQUIRE(b != nullptr);
+            CHECK(b != a);
+            CHECK(cache.size() == 2);
+
+            CHECK(a->call(std::vector<double> {8.0}) == 8.0 * 2.5 / 4.0);
+            CHECK(b->call(std::vector<double> {8.0}) == 8.0 * 3.5 / 4.0);
+
+            CHECK(cache.get("missing", {}) == nullptr);
+            CHECK(cache.get("price", std::vector<std::optional<double>> {0.25, 4.0}) == nullptr);
+            CHECK(cache.get("price", std::vector<std::optional<double>>(4)) == nullptr);
+            CHECK(cache.size() == 2);
+        }
+    }
+}
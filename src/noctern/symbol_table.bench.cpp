@@ -0,0 +1,64 @@
+#include "./symbol_table.hpp"
+
+#include <catch2/catch.hpp>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "noctern/tokenize.hpp"
+
+namespace noctern {
+    namespace {
+        TEST_CASE("symbol_table against std::unordered_map", "[benchmark]") {
+            const int num_fns = GENERATE(100, 10000, 200000);
+
+            std::vector<std::string> names;
+            for (int i = 0; i < num_fns; ++i) {
+                names.push_back(fmt::format("module_function_{}", i));
+            }
+            std::vector<std::pair<std::string_view, token>> fn_decls;
+            for (const std::string& name : names) {
+                fn_decls.emplace_back(name, token());
+            }
+            // Looked up in a scattered order, as a program's calls would be.
+            std::vector<std::string_view> lookups;
+            for (size_t i = 0; i < names.size(); ++i) {
+                lookups.push_back(names[(i * 7919) % names.size()]);
+            }
+
+            BENCHMARK(fmt::format("build symbol_table, {} functions", num_fns)) {
+                return symbol_table(fn_decls);
+            };
+
+            BENCHMARK(fmt::format("build std::unordered_map, {} functions", num_fns)) {
+                return std::unordered_map<std::string_view, token>(
+                    fn_decls.begin(), fn_decls.end());
+            };
+
+            const symbol_table table(fn_decls);
+            const std::unordered_map<std::string_view, token> map(
+                fn_decls.begin(), fn_decls.end());
+
+            BENCHMARK(fmt::format("lookup symbol_table, {} functions", num_fns)) {
+                size_t found = 0;
+                for (std::string_view name : lookups) {
+                    found += table.find_fn_decl(name).has_value();
+                }
+                return found;
+            };
+
+            BENCHMARK(fmt::format("lookup std::unordered_map, {} functions", num_fns)) {
+                size_t found = 0;
+                for (std::string_view name : lookups) {
+                    found += map.find(name) != map.end();
+                }
+                return found;
+            };
+        }
+    }
+}
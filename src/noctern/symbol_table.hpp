@@ -1,25 +1,100 @@
 #pragma once
 
+#include <cassert>
 #include <optional>
+#include <ranges>
+#include <span>
 #include <string_view>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "noctern/arena.hpp"
 #include "noctern/compilation_unit.hpp"
+#include "noctern/perfect_hash.hpp"
 #include "noctern/tokenize.hpp"
 
 namespace noctern {
+    namespace symbol_table_internal {
+        constexpr std::vector<std::pair<std::string_view, token>> fn_decls(
+            const tokens& input, const compilation_unit& unit) {
+            auto decls = unit.fn_defs() | std::views::transform([&](token token) {
+                const auto it = input.to_iterator(token);
+                assert(input.id(it[1]) == token_id::ident);
+                return std::pair(input.string(it[1]), it[2]);
+            });
+            return std::vector(std::ranges::begin(decls), std::ranges::end(decls));
+        }
+
+        constexpr std::vector<std::string_view> names(
+            std::span<const std::pair<std::string_view, token>> fn_decls) {
+            auto names = fn_decls | std::views::keys;
+            return std::vector(std::ranges::begin(names), std::ranges::end(names));
+        }
+    }
+
+    // An index of a module's functions by name. The set of functions never changes once built,
+    // so it's a perfect hash over the names: a lookup is one hash and one string comparison.
+    //
+    // If there are several functions of the same name, the first is found.
     class symbol_table {
     public:
-        explicit symbol_table(const tokens& input, const compilation_unit& unit);
+        // A function, as stored at its index of the hash.
+        struct fn_decl {
+            std::string_view name;
+            token decl;
+        };
+
+        // Allocates from the same arena as `input`.
+        explicit constexpr symbol_table(const tokens& input, const compilation_unit& unit)
+            : symbol_table(symbol_table_internal::fn_decls(input, unit), input.allocator()) {
+        }
+
+        // From an existing list of function names and declarations.
+        explicit constexpr symbol_table(
+            std::span<const std::pair<std::string_view, token>> fn_decls,
+            arena_allocator<std::byte> allocator = {})
+            : hash_(symbol_table_internal::names(fn_decls), allocator)
+            , fn_decls_(hash_.size(), allocator) {
+            // Duplicates share their index, and only the first is stored there.
+            for (const auto& [name, decl] : fn_decls) {
+                fn_decl& entry = fn_decls_[hash_(name)];
+                if (entry.name.empty()) entry = fn_decl {.name = name, .decl = decl};
+            }
+        }
+
+        // From the parts of an existing table, e.g. from the compile cache, without building the
+        // hash again. `fn_decls` holds the function at each index of `hash`.
+        explicit constexpr symbol_table(perfect_hash hash, std::span<const fn_decl> fn_decls,
+            arena_allocator<std::byte> allocator = {})
+            : hash_(std::move(hash))
+            , fn_decls_(fn_decls.begin(), fn_decls.end(), allocator) {
+            assert(fn_decls_.size() == hash_.size());
+        }
+
+        constexpr const perfect_hash& hash() const {
+            return hash_;
+        }
+
+        // Indexed by `hash()`.
+        constexpr std::span<const fn_decl> fn_decls() const {
+            return fn_decls_;
+        }
+
+        constexpr std::optional<token> find_fn_decl(std::string_view name) const {
+            if (fn_decls_.empty()) return std::nullopt;
+            const fn_decl& entry = fn_decls_[hash_(name)];
+            if (entry.name != name) return std::nullopt;
+            return entry.decl;
+        }
 
-        std::optional<token> find_fn_decl(std::string_view name) const {
-            auto it = fn_table_.find(name);
-            if (it == fn_table_.end()) return std::nullopt;
-            return it->second;
+        // The bytes allocated, not counting the names, which refer to the tokens' input.
+        constexpr size_t memory_usage() const {
+            return hash_.memory_usage() + fn_decls_.capacity() * sizeof(fn_decl);
         }
 
     private:
-        // TODO: use a better map type.
-        std::unordered_map<std::string_view, token> fn_table_;
+        perfect_hash hash_;
+        // Indexed by `hash_`.
+        arena_vector<fn_decl> fn_decls_;
     };
-}
\ No newline at end of file
+}
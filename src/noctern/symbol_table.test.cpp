@@ -0,0 +1,57 @@
+#include "./symbol_table.hpp"
+
+#include <catch2/catch.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "noctern/compilation_unit.hpp"
+#include "noctern/count_allocations.test.hpp"
+#include "noctern/parser.hpp"
+#include "noctern/tokenize.hpp"
+
+namespace noctern {
+    namespace {
+        TEST_CASE("symbol_table finds the first function of each name") {
+            const tokens parsed = noctern::parse(noctern::tokenize_all(R"(
+                def f(x): x;
+                def g(x, y): x + y;
+                def f(y): y * 2;
+            )"));
+            const compilation_unit unit(parsed);
+            const symbol_table table(parsed, unit);
+
+            const std::optional<token> f = table.find_fn_decl("f");
+            REQUIRE(f.has_value());
+            CHECK(parsed.string(*f) == "x");
+            CHECK(table.find_fn_decl("g").has_value());
+            CHECK(!table.find_fn_decl("h").has_value());
+            CHECK(!table.find_fn_decl("").has_value());
+        }
+
+        TEST_CASE("symbol lookup doesn't allocate") {
+            std::string source;
+            for (int i = 0; i < 1000; ++i) {
+                source += fmt::format("def function_with_a_long_name_{}(x): x;\n", i);
+            }
+            const tokens parsed = noctern::parse(noctern::tokenize_all(source));
+            const compilation_unit unit(parsed);
+            const symbol_table table(parsed, unit);
+
+            std::vector<std::string> names;
+            for (int i = 0; i < 1100; ++i) {
+                names.push_back(fmt::format("function_with_a_long_name_{}", i));
+            }
+
+            size_t num_found = 0;
+            CHECK(noctern::count_allocations([&] {
+                for (const std::string& name : names) {
+                    num_found += table.find_fn_decl(name).has_value();
+                }
+            }) == 0);
+            CHECK(num_found == 1000);
+        }
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <catch2/catch.hpp>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include <stdlib.h>
+
+namespace noctern {
+    // A fresh directory for a test's files, removed with everything in it at the end of the test.
+    //
+    // Each is unique, since ctest runs every TEST_CASE as a process of its own, in parallel under
+    // `ctest -j`.
+    class temp_dir {
+    public:
+        temp_dir() {
+            std::string path
+                = (std::filesystem::temp_directory_path() / "noctern.test.XXXXXX").string();
+            REQUIRE(::mkdtemp(path.data()) != nullptr);
+            path_ = std::move(path);
+        }
+
+        temp_dir(const temp_dir&) = delete;
+        temp_dir& operator=(const temp_dir&) = delete;
+
+        ~temp_dir() {
+            std::error_code error;
+            std::filesystem::remove_all(path_, error);
+        }
+
+        const std::filesystem::path& path() const {
+            return path_;
+        }
+
+        std::filesystem::path operator/(std::string_view name) const {
+            return path_ / name;
+        }
+
+    private:
+        std::filesystem::path path_;
+    };
+}
@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <catch2/catch.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "noctern/perf_fuzz.hpp"
+#include "noctern/tokenize.hpp"
+
+// Generated by flex from tokenize.flex.l.
+#include "tokenize.flex.hpp"
+
+// `tokenize_all` against a flex scanner for the same tokens: checks that they agree, then
+// compares their speed. Built as `noctern.bench.flex` with NOCTERN_BUILD_FLEX_BENCHMARK, which
+// needs flex.
+
+namespace noctern {
+    namespace {
+        using token_list = std::vector<std::pair<token_id, std::string_view>>;
+
+        class flex_lexer {
+        public:
+            flex_lexer() {
+                yylex_init(&scanner_);
+            }
+
+            flex_lexer(const flex_lexer&) = delete;
+            flex_lexer& operator=(const flex_lexer&) = delete;
+
+            ~flex_lexer() {
+                yylex_destroy(scanner_);
+            }
+
+            // Scans in place, like `tokenize_all`, rather than copying the input as
+            // `yy_scan_bytes` does. `buffer` must end in two NULs, which aren't scanned. flex
+            // writes to it while scanning, but puts it back.
+            //
+            // The tokens are stored much as `tokenize_all` stores them, so that both do about the
+            // same work besides scanning.
+            token_list tokenize(std::string& buffer) {
+                token_list result;
+                const YY_BUFFER_STATE state
+                    = yy_scan_buffer(buffer.data(), buffer.size(), scanner_);
+                while (const int token = yylex(scanner_)) {
+                    result.emplace_back(static_cast<token_id>(token - 1),
+                        std::string_view(
+                            yyget_text(scanner_), static_cast<size_t>(yyget_leng(scanner_))));
+                }
+                yy_delete_buffer(state, scanner_);
+                return result;
+            }
+
+        private:
+            yyscan_t scanner_;
+        };
+
+        std::string flex_buffer(std::string_view source) {
+            std::string result(source);
+            result.append(2, '\0');
+            return result;
+        }
+
+        token_list tokenize_all_list(std::string_view source) {
+            const tokens tokens = noctern::tokenize_all(source);
+            token_list result;
+            for (const token token : tokens) {
+                result.emplace_back(tokens.id(token), tokens.string(token));
+            }
+            return result;
+        }
+
+        // Empty if the lists are the same.
+        std::string first_difference(const token_list& expected, const token_list& actual) {
+            for (size_t i = 0; i < std::max(expected.size(), actual.size()); ++i) {
+                if (i < expected.size() && i < actual.size() && expected[i] == actual[i]) continue;
+                const auto describe = [&](const token_list& list) {
+                    if (i >= list.size()) return std::string("nothing");
+                    return fmt::format(
+                        "<{}: \"{}\">", stringify(list[i].first), list[i].second);
+                };
+                return fmt::format("token {}: tokenize_all gave {}, flex {}", i,
+                    describe(expected), describe(actual));
+            }
+            return {};
+        }
+
+        // Source made of the characters which make up tokens, plus a few which can't, so that
+        // every kind of token turns up, next to every other.
+        std::string random_text(std::mt19937& rng, size_t size) {
+            constexpr std::string_view alphabet
+                = "abdefilnrtuxyz_AZ0159.    \t\n\r,{}();:=+-*/#@\x80\xff";
+            std::string result;
+            result.reserve(size);
+            while (result.size() < size) {
+                // Keywords are rare at random, so often put one in whole.
+                if (rng() % 16 == 0) {
+                    constexpr std::string_view keywords[] = {"def", "let", "return"};
+                    result += keywords[rng() % std::size(keywords)];
+                } else {
+                    result += alphabet[rng() % alphabet.size()];
+                }
+            }
+            return result;
+        }
+
+        std::string random_bytes(std::mt19937& rng, size_t size) {
+            std::string result(size, '\0');
+            for (char& c : result) {
+                c = static_cast<char>(rng());
+            }
+            return result;
+        }
+
+        std::string random_program(std::mt19937& rng, size_t size) {
+            std::vector<uint8_t> input(64);
+            std::string result;
+            while (result.size() < size) {
+                for (uint8_t& byte : input) {
+                    byte = static_cast<uint8_t>(rng());
+                }
+                result += noctern::generate_program(input, 1 + rng() % 4);
+            }
+            return result;
+        }
+
+        TEST_CASE("flex and tokenize_all give the same tokens") {
+            const int seed = GENERATE(range(1, 21));
+            const size_t size = GENERATE(0, 1, 10, 1000);
+            std::mt19937 rng(seed);
+            const std::pair<std::string_view, std::string> corpora[] = {
+                {"random text", noctern::random_text(rng, size)},
+                {"random bytes", noctern::random_bytes(rng, size)},
+                {"programs", noctern::random_program(rng, size)},
+            };
+
+            flex_lexer flex;
+            for (const auto& [name, source] : corpora) {
+                INFO(fmt::format("{} from seed {}", name, seed));
+                std::string buffer = noctern::flex_buffer(source);
+                CHECK(noctern::first_difference(
+                          noctern::tokenize_all_list(source), flex.tokenize(buffer))
+                    == "");
+            }
+        }
+
+        TEST_CASE("tokenize_all against flex", "[benchmark]") {
+            constexpr size_t size = 1 << 20;
+            std::mt19937 rng(1);
+            const std::pair<std::string_view, std::string> corpora[] = {
+                {"programs", noctern::random_program(rng, size)},
+                {"random tokens", noctern::random_text(rng, size)},
+            };
+
+            for (const auto& [name, source] : corpora) {
+                std::string buffer = noctern::flex_buffer(source);
+                flex_lexer flex;
+
+                BENCHMARK(fmt::format("tokenize_all, 1 MiB of {}", name)) {
+                    return noctern::tokenize_all(source).num_tokens();
+                };
+
+                BENCHMARK(fmt::format("flex, 1 MiB of {}", name)) {
+                    return flex.tokenize(buffer).size();
+                };
+            }
+        }
+    }
+}
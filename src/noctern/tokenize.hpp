@@ -1,21 +1,30 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cassert>
 #include <concepts>
 #include <cstdint>
 #include <functional>
+#include <limits>
+#include <memory>
 #include <optional>
+#include <string>
 #include <string_view>
 #include <tuple>
 #include <utility>
 #include <vector>
 
+#include "noctern/arena.hpp"
 #include "noctern/enum.hpp"
 #include "noctern/iterator_facade.hpp"
 #include "noctern/meta.hpp"
 
 namespace noctern {
-    using token_index_t = int32_t;
+    // Indexes the tokens of a `tokens`. 64 bits, so that any input can be indexed; a `token` is a
+    // handle rather than something stored per token, so the width costs next to nothing. Indices
+    // stored per token use `token_index_vector` instead, which is only as wide as it needs to be.
+    using token_index_t = int64_t;
 
     struct _token_id_wrapper {
         // The token_id identifier.
@@ -165,11 +174,45 @@ namespace noctern {
     template <>
     inline constexpr auto token_data<token_id::return_> = empty_data<"return"> {};
 
+    // The `token_id`s with runtime data.
+    inline constexpr enum_bitset<token_id> tokens_with_data = [] {
+        enum_bitset<token_id> result;
+        enum_values(type<token_id>, [&]<token_id... tokens>(val_t<tokens>...) {
+            (
+                [&]<token_id token_id>(val_t<token_id>) {
+                    using data = std::remove_cvref_t<decltype(token_data<token_id>)>;
+                    if constexpr (!is_empty_data<data>) result.insert(token_id);
+                }(val<tokens>),
+                ...);
+        });
+        return result;
+    }();
+
     // Whether there is runtime data associated with this `token_id` type.
     constexpr bool has_data(token_id token_id) {
-        return enum_switch(token_id, []<noctern::token_id token_id>(val_t<token_id>) {
-            return !is_empty_data<std::remove_cvref_t<decltype(token_data<token_id>)>>;
-        });
+        return tokens_with_data.contains(token_id);
+    }
+
+    // Number literals.
+    inline constexpr enum_bitset<token_id> literal_tokens = {token_id::int_lit, token_id::real_lit};
+
+    // The binary arithmetic operators.
+    inline constexpr enum_bitset<token_id> operator_tokens
+        = {token_id::plus, token_id::minus, token_id::mult, token_id::div};
+
+    // The fixed spelling of a `token_id` without runtime data, e.g. `token_id::plus` -> "+".
+    //
+    // Empty for `token_id`s with runtime data.
+    constexpr std::string_view spelling(token_id token_id) {
+        return enum_switch(
+            token_id, []<noctern::token_id token_id>(val_t<token_id>) -> std::string_view {
+                using data = std::remove_cvref_t<decltype(token_data<token_id>)>;
+                if constexpr (is_empty_data<data>) {
+                    return data::value;
+                } else {
+                    return {};
+                }
+            });
     }
 
     class token_without_data {
@@ -194,6 +237,83 @@ namespace noctern {
         token_id value;
     };
 
+    // One `token_index_t` per token, stored as `Compact` while the values fit.
+    //
+    // The width is picked by size: a table of at most `Compact`'s maximum entries is compact. If a
+    // larger value is stored anyway, the table widens to 64 bits rather than overflow.
+    template <std::signed_integral Compact = int32_t>
+    class token_index_vector {
+    public:
+        explicit constexpr token_index_vector(arena_allocator<std::byte> allocator)
+            : compact_(allocator)
+            , wide_(allocator) {
+        }
+
+        constexpr bool empty() const {
+            return compact_.empty() && wide_.empty();
+        }
+
+        constexpr size_t size() const {
+            return is_wide() ? wide_.size() : compact_.size();
+        }
+
+        // Whether the values take 64 bits each.
+        constexpr bool is_wide() const {
+            return !wide_.empty();
+        }
+
+        // The bytes allocated for the values.
+        constexpr size_t memory_usage() const {
+            return compact_.capacity() * sizeof(Compact) + wide_.capacity() * sizeof(token_index_t);
+        }
+
+        // New values are 0.
+        constexpr void resize(size_t size) {
+            if (is_wide() || size > static_cast<size_t>(std::numeric_limits<Compact>::max())) {
+                widen();
+                wide_.resize(size);
+            } else {
+                compact_.resize(size);
+            }
+        }
+
+        constexpr void erase_from(size_t index) {
+            if (is_wide()) {
+                wide_.erase(wide_.begin() + index, wide_.end());
+            } else {
+                compact_.erase(compact_.begin() + index, compact_.end());
+            }
+        }
+
+        constexpr token_index_t operator[](size_t index) const {
+            return is_wide() ? wide_[index] : compact_[index];
+        }
+
+        constexpr void set(size_t index, token_index_t value) {
+            if (!is_wide()
+                && (value < std::numeric_limits<Compact>::min()
+                    || value > std::numeric_limits<Compact>::max())) [[unlikely]] {
+                widen();
+            }
+            if (is_wide()) {
+                wide_[index] = value;
+            } else {
+                compact_[index] = static_cast<Compact>(value);
+            }
+        }
+
+    private:
+        constexpr void widen() {
+            if (is_wide() || compact_.empty()) return;
+            wide_.assign(compact_.begin(), compact_.end());
+            compact_ = arena_vector<Compact>(compact_.get_allocator());
+        }
+
+        arena_vector<Compact> compact_;
+        // Non-empty exactly when in use.
+        arena_vector<token_index_t> wide_;
+    };
+
     class token {
         friend class tokens;
 
@@ -226,15 +346,15 @@ namespace noctern {
 
             constexpr const_iterator() = default;
 
-            token read() const {
+            constexpr token read() const {
                 return make(index_);
             }
 
-            void advance(token_index_t offset) {
+            constexpr void advance(token_index_t offset) {
                 index_ += offset;
             }
 
-            ptrdiff_t distance(const_iterator rhs) const {
+            constexpr ptrdiff_t distance(const_iterator rhs) const {
                 return rhs.index_ - index_;
             }
 
@@ -250,23 +370,26 @@ namespace noctern {
             friend class tokens;
 
         public:
-            explicit constexpr builder(std::string_view input_file)
+            // The tokens are allocated from `arena`, if given.
+            explicit constexpr builder(std::string_view input_file, arena* arena = nullptr)
                 : remaining_input_(input_file)
-                , input_file_(input_file) {
+                , input_file_(input_file)
+                , tokens_(arena_allocator<token_id>(arena))
+                , token_strs_(arena_allocator<std::string_view>(arena)) {
             }
 
-            std::string_view remaining_input() const {
+            constexpr std::string_view remaining_input() const {
                 return remaining_input_;
             }
 
-            void add_token(token_id token, token_index_t length) {
+            constexpr void add_token(token_id token, size_t length) {
                 tokens_.push_back(token);
                 token_strs_.emplace_back(remaining_input_.substr(0, length));
                 input_start_index_ += length;
                 remaining_input_.remove_prefix(length);
             }
 
-            void add_ignored_token(token_index_t length) {
+            constexpr void add_ignored_token(size_t length) {
                 input_start_index_ += length;
                 remaining_input_.remove_prefix(length);
             }
@@ -275,28 +398,118 @@ namespace noctern {
             std::string_view remaining_input_;
 
             std::string_view input_file_;
-            token_index_t input_start_index_ = 0;
+            size_t input_start_index_ = 0;
 
-            std::vector<token_id> tokens_;
-            std::vector<std::string_view> token_strs_;
+            arena_vector<token_id> tokens_;
+            arena_vector<std::string_view> token_strs_;
         };
 
-        explicit tokens(builder builder)
+        // Builds a new token stream out of an existing one, e.g. for an optimization pass.
+        //
+        // Tokens may be copied from the source or synthesized. Synthesized strings are owned by the
+        // resulting `tokens` (and shared by its copies). Allocates from the same arena as the
+        // source.
+        class rewriter {
+            friend class tokens;
+
+        public:
+            explicit rewriter(const tokens& source)
+                : source_(&source)
+                , input_file_(source.input_file_)
+                , owned_strs_(source.owned_strs_)
+                , tokens_(source.allocator())
+                , token_strs_(source.allocator()) {
+            }
+
+            void copy_token(token token) {
+                tokens_.push_back(source_->id(token));
+                token_strs_.push_back(source_->string(token));
+            }
+
+            void add_token(token_without_data token) {
+                tokens_.push_back(token.value);
+                token_strs_.push_back(spelling(token.value));
+            }
+
+            // `string` must be owned by the source or have come from `add_synthesized_token`.
+            void add_token(token_id token, std::string_view string) {
+                tokens_.push_back(token);
+                token_strs_.push_back(string);
+            }
+
+            // Returns the stored string, so that the token can be repeated via `add_token` without
+            // another copy.
+            std::string_view add_synthesized_token(token_id token, std::string string) {
+                auto& owned = owned_strs_.emplace_back(
+                    std::make_shared<const std::string>(std::move(string)));
+                add_token(token, *owned);
+                return *owned;
+            }
+
+        private:
+            const tokens* source_;
+
+            std::string_view input_file_;
+            std::vector<std::shared_ptr<const std::string>> owned_strs_;
+
+            arena_vector<token_id> tokens_;
+            arena_vector<std::string_view> token_strs_;
+        };
+
+        explicit constexpr tokens(builder builder)
             : input_file_(builder.input_file_)
             , tokens_(std::move(builder.tokens_))
-            , token_strs_(std::move(builder.token_strs_)) {
+            , token_strs_(std::move(builder.token_strs_))
+            , subtree_sizes_(tokens_.get_allocator()) {
+        }
+
+        // Tokens whose strings all refer into `storage`, e.g. a memory-mapped compile cache.
+        constexpr tokens(std::string_view storage, arena_vector<token_id> ids,
+            arena_vector<std::string_view> strings)
+            : input_file_(storage)
+            , tokens_(std::move(ids))
+            , token_strs_(std::move(strings))
+            , subtree_sizes_(tokens_.get_allocator()) {
+            assert(tokens_.size() == token_strs_.size());
+        }
+
+        explicit tokens(rewriter rewriter)
+            : input_file_(rewriter.input_file_)
+            , owned_strs_(std::move(rewriter.owned_strs_))
+            , tokens_(std::move(rewriter.tokens_))
+            , token_strs_(std::move(rewriter.token_strs_))
+            , subtree_sizes_(tokens_.get_allocator()) {
         }
 
-        size_t num_tokens() const {
+        // Where the tokens were allocated, for structures built from them to allocate alongside.
+        constexpr arena_allocator<std::byte> allocator() const {
+            return tokens_.get_allocator();
+        }
+
+        constexpr size_t num_tokens() const {
             return tokens_.size();
         }
 
-        const_iterator begin() const {
+        // The bytes allocated for the tokens: the ids, their strings (but not the input they refer
+        // to), any subtree sizes, and strings owned by these tokens. Owned strings shared with
+        // other copies are counted in full by each.
+        constexpr size_t memory_usage() const {
+            size_t result = tokens_.capacity() * sizeof(token_id)
+                + token_strs_.capacity() * sizeof(std::string_view)
+                + subtree_sizes_.memory_usage()
+                + owned_strs_.capacity() * sizeof(std::shared_ptr<const std::string>);
+            for (const auto& owned : owned_strs_) {
+                result += sizeof(std::string) + owned->capacity() + 1;
+            }
+            return result;
+        }
+
+        constexpr const_iterator begin() const {
             return const_iterator(0);
         }
 
-        const_iterator end() const {
-            return const_iterator(tokens_.size());
+        constexpr const_iterator end() const {
+            return const_iterator(static_cast<token_index_t>(tokens_.size()));
         }
 
         class extracted_data {
@@ -309,32 +522,51 @@ namespace noctern {
             std::string_view string;
         };
 
-        extracted_data extract(const_iterator pos) {
+        constexpr extracted_data extract(const_iterator pos) {
             extracted_data result;
             result.id = std::exchange(tokens_[pos.index_], token_id::invalid);
             result.string = token_strs_[pos.index_];
             return result;
         }
 
-        void store(const_iterator dest, extracted_data source) {
+        constexpr void store(const_iterator dest, extracted_data source) {
             tokens_[dest.index_] = source.id;
             token_strs_[dest.index_] = source.string;
         }
 
-        void erase_to_end(const_iterator pos) {
+        constexpr void erase_to_end(const_iterator pos) {
             tokens_.erase(tokens_.begin() + pos.index_, tokens_.end());
             token_strs_.erase(token_strs_.begin() + pos.index_, token_strs_.end());
+            if (!subtree_sizes_.empty()) subtree_sizes_.erase_from(pos.index_);
+        }
+
+        // Whether `subtree_size` is available, i.e. whether these tokens came from `parse` (and
+        // contain a `let`).
+        constexpr bool has_subtree_sizes() const {
+            return !subtree_sizes_.empty();
         }
 
-        const_iterator to_iterator(token token) const {
+        // The number of tokens in the initializer of the `let` introduced by `valdef_intro`, not
+        // counting the `statement_end`. Lets the initializer be skipped without reading it.
+        constexpr token_index_t subtree_size(token valdef_intro) const {
+            assert(id(valdef_intro) == token_id::valdef_intro);
+            return subtree_sizes_[valdef_intro.index_];
+        }
+
+        constexpr void set_subtree_size(const_iterator valdef_intro, token_index_t size) {
+            if (subtree_sizes_.empty()) subtree_sizes_.resize(tokens_.size());
+            subtree_sizes_.set(valdef_intro.index_, size);
+        }
+
+        constexpr const_iterator to_iterator(token token) const {
             return const_iterator(token.index_);
         }
 
-        token_id id(token token) const {
+        constexpr token_id id(token token) const {
             return tokens_[token.index_];
         }
 
-        std::string_view string(token token) const {
+        constexpr std::string_view string(token token) const {
             return token_strs_[token.index_];
         }
 
@@ -343,6 +575,10 @@ namespace noctern {
 
         std::string_view input_file_;
 
+        // Strings which don't live in `input_file_`, such as names invented by optimization passes.
+        // Shared so that copies of `tokens` keep referring to valid strings.
+        std::vector<std::shared_ptr<const std::string>> owned_strs_;
+
         // The parser only needs to work directly on the tokens. We organize memory to encourage
         // this.
         //
@@ -351,17 +587,276 @@ namespace noctern {
         // compute: we don't need to store a full `string_view`, but only an offset into the
         // original buffer. We could retokenize to determine the string value.
 
-        std::vector<token_id> tokens_;
+        arena_vector<token_id> tokens_;
 
         // This representation is probably wrong: tokens are an incrementing index, rather than a
         // direct index into the source file. We can change this, but this is a slightly easier
         // initial representation.
 
-        std::vector<std::string_view> token_strs_;
+        arena_vector<std::string_view> token_strs_;
+
+        // Parallel to `tokens_` once any size is recorded; only meaningful at `valdef_intro`s.
+        token_index_vector<> subtree_sizes_;
     };
     static_assert(std::bidirectional_iterator<tokens::const_iterator>);
 
-    tokens tokenize_all(std::string_view input);
+    // The tokenizer is defined here so that it can run in constant expressions.
+    namespace tokenize_internal {
+        template <token_id token_id>
+        using token_data_t = std::remove_cvref_t<decltype(token_data<token_id>)>;
+
+        // Calls `fn(val<token_id>, token_data<token_id>)` once per empty token_id.
+        template <typename Fn>
+        constexpr void for_each_empty_token(Fn&& fn) {
+            enum_values(type<token_id>, [&]<token_id... tokens>(val_t<tokens>...) {
+                (
+                    [&]<token_id token_id, typename Data>(val_t<token_id> val, Data data) {
+                        if constexpr (is_empty_data<Data>) {
+                            fn(val, data);
+                        }
+                    }(val<tokens>, token_data<tokens>),
+                    ...);
+            });
+        }
+
+        // For any `char` value, the `token_id` type that we should tokenize as.
+        // E.g. '0' -> `token_id::int_lit`.
+        //
+        // Note that this is only the _first_ character of the token_id.
+        inline constexpr std::array<token_id, 256> token_for_leading_char = [] {
+            std::array<token_id, 256> result;
+            for (token_id& t : result) {
+                t = token_id::invalid;
+            }
+
+            const auto store
+                = [&](unsigned char index, token_id token_id, [[maybe_unused]] bool force = false) {
+                // We don't want collisions.
+                assert(result[index] == token_id::invalid || force);
+                result[index] = token_id;
+            };
+
+            for_each_empty_token([&]<token_id token_id, typename Data>(val_t<token_id>, Data) {
+                store(static_cast<unsigned char>(Data::value[0]), token_id);
+            });
+
+            // token_id::space
+            store(' ', token_id::space);
+            store('\t', token_id::space);
+            store('\n', token_id::space);
+            store('\r', token_id::space);
+
+            // token_id::ident
+            for (unsigned char c = 'a'; c <= 'z'; ++c) {
+                store(c, token_id::ident, /*force=*/true); // keyword collisions.
+            }
+            for (unsigned char c = 'A'; c <= 'Z'; ++c) {
+                store(c, token_id::ident);
+            }
+            store('_', token_id::ident);
+
+            // token_id::int_lit
+            for (unsigned char c = '0'; c <= '9'; ++c) {
+                store(c, token_id::int_lit);
+            }
+
+            // token_id::real_lit
+            store('.', token_id::real_lit);
+
+            return result;
+        }();
+
+        // Keywords are any empty token_id that had a collision with `ident`.
+        inline constexpr enum_bitset<token_id> keyword_tokens = [] {
+            enum_bitset<token_id> result;
+            for_each_empty_token([&]<token_id token_id, typename Data>(val_t<token_id>, Data) {
+                if (token_for_leading_char[static_cast<unsigned char>(Data::value[0])]
+                    == token_id::ident) {
+                    result.insert(token_id);
+                }
+            });
+            return result;
+        }();
+
+        // A hash table to detemrine which identifiers are actually keywords.
+        class keyword_table {
+        private:
+            static constexpr size_t num_keywords = keyword_tokens.size();
+            static constexpr size_t num_table_entries = 4;
+            static_assert(num_table_entries >= num_keywords);
+
+            // A perfect hash for the keywords.
+            static constexpr uint8_t hash(std::string_view identifier) {
+                // Arbitrarily chosen.
+                return (static_cast<uint8_t>(identifier.front()) >> 3) & (num_table_entries - 1);
+            }
+
+        public:
+            constexpr std::optional<token_id> find_keyword(std::string_view identifier) const {
+                uint8_t hash_value = hash(identifier);
+                entry entry = table_[hash_value];
+                if (entry.value == identifier) {
+                    return entry.token_id.value;
+                }
+                return std::nullopt;
+            }
+
+        private:
+            struct entry {
+                token_without_data token_id {val<noctern::token_id::empty_invalid>};
+                std::string_view value;
+            };
+
+            std::array<entry, num_table_entries> table_ = [] {
+                std::array<entry, num_table_entries> result;
+
+                for_each_empty_token([&]<token_id token_id, typename Data>(val_t<token_id>, Data) {
+                    if (keyword_tokens.contains(token_id)) {
+                        uint8_t hash_value = hash(Data::value);
+                        entry& entry = result[hash_value];
+                        assert(entry.token_id.value == token_id::empty_invalid);
+                        entry.value = Data::value;
+                        entry.token_id = token_without_data(val<token_id>);
+                    }
+                });
+
+                return result;
+            }();
+        };
+
+        inline constexpr keyword_table keywords;
+
+        struct tokenized_result {
+            token_id id;
+            size_t length;
+        };
 
-    tokens tokenize_all_keeping_spaces(std::string_view input);
+        // `tokenize_at` gets the next token_id where `token_for_leading_char` tells us which
+        // overload to call. It is guaranteed that `input`'s first character matches the entry in
+        // that table.
+        //
+        // We mutate the `input` in-out param to indicate that we've consumed input.
+        //
+        // We add the token_id (and string value if relevant) to the `builder` parameter.
+
+        template <token_id token_id>
+            requires is_empty_data<token_data_t<token_id>>
+        constexpr tokenized_result tokenize_at(val_t<token_id>, std::string_view input) {
+            // Possible optimization: it may be faster to generate a table rather than generate N
+            // overloads.
+
+            constexpr auto value = token_data_t<token_id>::value;
+            if constexpr (value.size() == 1) {
+                return {token_id, 1};
+            } else {
+                std::string_view data = value;
+
+                if (input.size() < data.size()) {
+                    return {token_id::invalid, input.size()};
+                }
+
+                return {token_id, data.size()};
+            }
+        }
+
+        // Collects the front part of `input` which matches `p`.
+        //
+        // Assumes the first character matches `p`.
+        template <typename Pred>
+        constexpr size_t parse_while(std::string_view input, Pred&& p) {
+            assert(!input.empty());
+            assert(p(input[0]));
+
+            auto last_valid = std::ranges::find_if_not(input.substr(1), p);
+            return static_cast<size_t>(last_valid - input.begin());
+        }
+
+        constexpr tokenized_result tokenize_at(
+            val_t<token_id::invalid> token_id, std::string_view input) {
+            return {token_id, parse_while(input, [](char c) {
+                        return token_for_leading_char[static_cast<unsigned char>(c)]
+                            == token_id::invalid;
+                    })};
+        }
+
+        constexpr tokenized_result tokenize_at(
+            val_t<token_id::space> token_id, std::string_view input) {
+            return {token_id, parse_while(input, [](char c) {
+                        return token_for_leading_char[static_cast<unsigned char>(c)]
+                            == token_id::space;
+                    })};
+        }
+
+        constexpr tokenized_result tokenize_at(val_t<token_id::ident>, std::string_view input) {
+            size_t length = parse_while(input, [](char c) {
+                return ('0' <= c && c <= '9') || ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z')
+                    || c == '_';
+            });
+            if (std::optional<token_id> keyword = keywords.find_keyword(input.substr(0, length))) {
+                return {*keyword, length};
+            }
+
+            return {token_id::ident, length};
+        }
+
+        // Tokenizes r'\.[0-9]*'.
+        constexpr size_t tokenize_real_part_lit(std::string_view input) {
+            std::string_view old_input = input;
+
+            input.remove_prefix(1);
+            auto last_valid
+                = std::ranges::find_if_not(input, [](char c) { return '0' <= c && c <= '9'; });
+            return static_cast<size_t>(last_valid - old_input.begin());
+        }
+
+        constexpr tokenized_result tokenize_at(
+            val_t<token_id::real_lit> token_id, std::string_view input) {
+            return {token_id, tokenize_real_part_lit(input)};
+        }
+
+        constexpr tokenized_result tokenize_at(val_t<token_id::int_lit>, std::string_view input) {
+            size_t int_lit_length
+                = parse_while(input, [](char c) { return '0' <= c && c <= '9'; });
+            input.remove_prefix(int_lit_length);
+
+            if (!input.empty()
+                // We might actually need to combine this with a real number literal.
+                && token_for_leading_char[static_cast<unsigned char>(input.front())]
+                    == token_id::real_lit) {
+                size_t real_lit_len = tokenize_internal::tokenize_real_part_lit(input);
+                return {token_id::real_lit, int_lit_length + real_lit_len};
+            } else {
+                return {token_id::int_lit, int_lit_length};
+            }
+        }
+
+        template <bool keep_spaces>
+        constexpr tokens tokenize_all_impl(std::string_view input, arena* arena = nullptr) {
+            tokens::builder builder(input, arena);
+
+            while (!builder.remaining_input().empty()) {
+                auto next = static_cast<unsigned char>(builder.remaining_input().front());
+                tokenized_result token = enum_switch(
+                    token_for_leading_char[next], [&]<token_id lex_next>(val_t<lex_next> val) {
+                        return tokenize_internal::tokenize_at(val, builder.remaining_input());
+                    });
+                if (!keep_spaces && token.id == token_id::space) {
+                    builder.add_ignored_token(token.length);
+                } else {
+                    builder.add_token(token.id, token.length);
+                }
+            }
+
+            return tokens(std::move(builder));
+        }
+    }
+
+    // Allocates the tokens from `arena`, if given.
+    constexpr tokens tokenize_all(std::string_view input, arena* arena = nullptr) {
+        return tokenize_internal::tokenize_all_impl</*keep_spaces=*/false>(input, arena);
+    }
+
+    constexpr tokens tokenize_all_keeping_spaces(std::string_view input) {
+        return tokenize_internal::tokenize_all_impl</*keep_spaces=*/true>(input);
+    }
 }
@@ -1,11 +1,13 @@
 #include "./tokenize.hpp"
 
 #include <algorithm>
+#include <bit>
 #include <ranges>
 #include <string>
 
 #include <catch2/catch.hpp>
 
+#include "./count_allocations.test.hpp"
 #include "./tokenize.test.hpp"
 
 namespace noctern {
@@ -290,5 +292,54 @@ namespace noctern {
                 }
             }
         }
+
+        TEST_CASE("token_index_vector widens instead of overflowing") {
+            // 8 bits, so that widening doesn't need gigabytes of tokens.
+            token_index_vector<int8_t> indices(arena_allocator<std::byte> {});
+
+            indices.resize(100);
+            CHECK(!indices.is_wide());
+            indices.set(1, 127);
+            indices.set(2, -128);
+            CHECK(indices[1] == 127);
+            CHECK(indices[2] == -128);
+
+            SECTION("storing a value which doesn't fit") {
+                indices.set(3, 1000);
+                CHECK(indices.is_wide());
+            }
+            SECTION("growing past the largest index") {
+                indices.resize(300);
+                CHECK(indices.is_wide());
+                indices.set(299, 299);
+                CHECK(indices[299] == 299);
+            }
+
+            CHECK(indices[1] == 127);
+            CHECK(indices[2] == -128);
+            CHECK(indices[0] == 0);
+
+            indices.erase_from(0);
+            CHECK(indices.empty());
+        }
+
+        TEST_CASE("tokenize_all allocates a logarithmic number of times") {
+            std::string source;
+            for (int i = 0; i < 10000; ++i) {
+                source += "def f(x, y): { let a = x * 2; return a + y; };\n";
+            }
+
+            size_t num_tokens = 0;
+            const size_t num_allocations = noctern::count_allocations(
+                [&] { num_tokens = tokenize_all(source).num_tokens(); });
+            // The two arrays grow geometrically.
+            CHECK(num_allocations <= 2 * (std::bit_width(num_tokens) + 1));
+
+            // Or into an arena, only for its blocks (if that; large blocks are mapped directly).
+            arena arena;
+            const size_t arena_allocations
+                = noctern::count_allocations([&] { tokenize_all(source, &arena); });
+            CHECK(arena_allocations <= arena.num_blocks());
+        }
     }
 }
\ No newline at end of file
@@ -0,0 +1,174 @@
+#include "./validate.hpp"
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+
+#include <fmt/format.h>
+
+namespace noctern {
+    namespace {
+        // Text from the file is quoted in errors at most this long: a run of `invalid` characters
+        // can be as long as the file, and errors may be shown to someone who can't read the file.
+        constexpr size_t max_quoted_size = 16;
+
+        std::string quoted(std::string_view text) {
+            if (text.size() <= max_quoted_size) return fmt::format("`{}`", text);
+            return fmt::format("`{}`...", text.substr(0, max_quoted_size));
+        }
+
+        // A recursive descent over the same grammar as `parse`, which reports the first problem
+        // instead of asserting.
+        class validator {
+        public:
+            explicit validator(const tokens& input)
+                : input_(input)
+                , pos_(input.begin()) {
+            }
+
+            std::optional<std::string> file() {
+                while (pos_ != input_.end()) {
+                    if (auto error = fndef()) {
+                        if (fn_name_.empty()) return error;
+                        return fmt::format("in {}: {}", noctern::quoted(fn_name_), *error);
+                    }
+                }
+                return std::nullopt;
+            }
+
+        private:
+            std::optional<token_id> peek() const {
+                if (pos_ == input_.end()) return std::nullopt;
+                return input_.id(*pos_);
+            }
+
+            std::string describe_next() const {
+                if (pos_ == input_.end()) return "the end of the file";
+                const token_id id = input_.id(*pos_);
+                return noctern::quoted(has_data(id) ? input_.string(*pos_) : noctern::spelling(id));
+            }
+
+            std::string unexpected(std::string_view expected) const {
+                return fmt::format("expected {} but found {}", expected, describe_next());
+            }
+
+            // Consumes a `token_id`, or describes what was there instead.
+            std::optional<std::string> expect(token_id id) {
+                if (peek() != id) {
+                    return unexpected(id == token_id::ident
+                            ? std::string("an identifier")
+                            : fmt::format("`{}`", noctern::spelling(id)));
+                }
+                ++pos_;
+                return std::nullopt;
+            }
+
+            std::optional<std::string> fndef() {
+                fn_name_ = {};
+                scope_.clear();
+                if (auto error = expect(token_id::fn_intro)) return error;
+                if (peek() == token_id::ident) fn_name_ = input_.string(*pos_);
+                if (auto error = expect(token_id::ident)) return error;
+                if (auto error = expect(token_id::lparen)) return error;
+
+                while (peek() != token_id::rparen) {
+                    if (peek() == token_id::ident) scope_.insert(input_.string(*pos_));
+                    if (auto error = expect(token_id::ident)) return error;
+                    if (peek() != token_id::rparen) {
+                        if (auto error = expect(token_id::comma)) return error;
+                    }
+                }
+                ++pos_;
+                if (auto error = expect(token_id::fn_outro)) return error;
+
+                if (peek() == token_id::lbrace) {
+                    if (auto error = block()) return error;
+                } else {
+                    if (auto error = expr(0)) return error;
+                }
+                return expect(token_id::statement_end);
+            }
+
+            std::optional<std::string> block() {
+                ++pos_;
+                while (peek() == token_id::valdef_intro) {
+                    ++pos_;
+                    const std::string_view name
+                        = peek() == token_id::ident ? input_.string(*pos_) : std::string_view();
+                    if (auto error = expect(token_id::ident)) return error;
+                    if (auto error = expect(token_id::valdef_outro)) return error;
+                    if (auto error = expr(0)) return error;
+                    if (auto error = expect(token_id::statement_end)) return error;
+                    // Only in scope after its initializer, as `parse`'s consumers bind it.
+                    scope_.insert(name);
+                }
+                if (auto error = expect(token_id::return_)) return error;
+                if (auto error = expr(0)) return error;
+                if (auto error = expect(token_id::statement_end)) return error;
+                return expect(token_id::rbrace);
+            }
+
+            // add_sub_expr ::= div_mul_expr [(`+` | `-`) add_sub_expr]
+            std::optional<std::string> expr(size_t depth) {
+                if (depth > max_validated_depth) return "expression nested too deeply";
+                if (peek() == token_id::lbrace) return "a block can only be a function's body";
+                if (auto error = div_mul_expr(depth)) return error;
+                if (peek() == token_id::plus || peek() == token_id::minus) {
+                    ++pos_;
+                    return expr(depth + 1);
+                }
+                return std::nullopt;
+            }
+
+            // div_mul_expr ::= base_expr [(`*` | `/`) div_mul_expr]
+            std::optional<std::string> div_mul_expr(size_t depth) {
+                if (depth > max_validated_depth) return "expression nested too deeply";
+                if (auto error = base_expr(depth)) return error;
+                if (peek() == token_id::mult || peek() == token_id::div) {
+                    ++pos_;
+                    return div_mul_expr(depth + 1);
+                }
+                return std::nullopt;
+            }
+
+            std::optional<std::string> base_expr(size_t depth) {
+                const std::optional<token_id> id = peek();
+                if (id == token_id::lparen) {
+                    ++pos_;
+                    if (auto error = expr(depth + 1)) return error;
+                    return expect(token_id::rparen);
+                }
+                if (id == token_id::ident) {
+                    const std::string_view name = input_.string(*pos_);
+                    if (!scope_.contains(name)) {
+                        return fmt::format("unknown identifier {}", noctern::quoted(name));
+                    }
+                    ++pos_;
+                    return std::nullopt;
+                }
+                if (id.has_value() && literal_tokens.contains(*id)) {
+                    ++pos_;
+                    return std::nullopt;
+                }
+                return unexpected("an expression");
+            }
+
+            const tokens& input_;
+            tokens::const_iterator pos_;
+
+            std::string_view fn_name_;
+            // The parameters and `let`s visible so far.
+            std::unordered_set<std::string_view> scope_;
+        };
+    }
+
+    std::expected<void, std::string> validate(const tokens& input) {
+        if (std::optional<std::string> error = validator(input).file()) {
+            return std::unexpected(std::move(*error));
+        }
+        return {};
+    }
+}
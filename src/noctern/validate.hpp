@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <expected>
+#include <string>
+
+#include "noctern/tokenize.hpp"
+
+namespace noctern {
+    // Checks that `parse` and the passes after it can take `input`, the output of `tokenize_all`.
+    // They only assert on bad input, so anything compiling source it doesn't control (e.g. a
+    // module named by a client) validates it first.
+    //
+    // Beyond the grammar, every identifier must name a parameter or an earlier `let`, and a block
+    // can only be a function's body, as the passes after `parse` expect.
+    //
+    // The error describes the first problem, e.g. "in `Main`: unknown identifier `y`".
+    std::expected<void, std::string> validate(const tokens& input);
+
+    // The deepest nesting of expressions which `validate` accepts, counting each parenthesis and
+    // each operator of a chain: `parse` recurses for each, so deeper would risk its stack.
+    inline constexpr size_t max_validated_depth = 1000;
+}
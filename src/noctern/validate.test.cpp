@@ -0,0 +1,82 @@
+#include "./validate.hpp"
+
+#include <catch2/catch.hpp>
+#include <string>
+#include <string_view>
+
+#include "noctern/ir.hpp"
+#include "noctern/parser.hpp"
+
+namespace noctern {
+    namespace {
+        // Empty if `source` is valid.
+        std::string validation_error(std::string_view source) {
+            const auto result = noctern::validate(noctern::tokenize_all(source));
+            return result.has_value() ? "" : result.error();
+        }
+
+        TEST_CASE("validate accepts what the compiler takes") {
+            const std::string_view source = GENERATE(as<std::string_view> {}, "",
+                "def f(x, y): x * (y - 1.5) / 2;",
+                "def f(x,): x;",
+                "def Main(): { let a = 1; let a = a + 1; return a * a; };",
+                "def f(x): { let x = x + 1; return x; }; def g(): 2;");
+            CHECK(noctern::validation_error(source) == "");
+            // Asserts if it's invalid.
+            ir::build(noctern::parse(noctern::tokenize_all(source)));
+        }
+
+        TEST_CASE("validate describes the first problem") {
+            CHECK(noctern::validation_error("def Main(): { let x = ; return x; };")
+                == "in `Main`: expected an expression but found `;`");
+            CHECK(noctern::validation_error("def Main(): y + 1;")
+                == "in `Main`: unknown identifier `y`");
+            CHECK(noctern::validation_error("def f(): { let a = a; return a; };")
+                == "in `f`: unknown identifier `a`");
+            CHECK(noctern::validation_error("def f(x): x + ;")
+                == "in `f`: expected an expression but found `;`");
+            CHECK(noctern::validation_error("def f(x): x")
+                == "in `f`: expected `;` but found the end of the file");
+            CHECK(noctern::validation_error("def f(x y): x;")
+                == "in `f`: expected `,` but found `y`");
+            CHECK(noctern::validation_error("def f(): 1 # 2;")
+                == "in `f`: expected `;` but found `#`");
+            CHECK(noctern::validation_error("def f(): { return 1; }")
+                == "in `f`: expected `;` but found the end of the file");
+            CHECK(noctern::validation_error("def f(): { let a = 1; };")
+                == "in `f`: expected `return` but found `}`");
+            CHECK(noctern::validation_error("def f(): ({ return 1; });")
+                == "in `f`: a block can only be a function's body");
+            CHECK(noctern::validation_error("let a = 1;") == "expected `def` but found `let`");
+            CHECK(noctern::validation_error("def (): 1;")
+                == "expected an identifier but found `(`");
+        }
+
+        TEST_CASE("validate quotes only the start of long text") {
+            // E.g. a file which isn't a module at all.
+            CHECK(noctern::validation_error("root:x:0:0:root:/root:/bin/bash")
+                == "expected `def` but found `root`");
+            CHECK(noctern::validation_error("def f(): 1 " + std::string(10000, '#') + ";")
+                == "in `f`: expected `;` but found `################`...");
+            const std::string long_name(100, 'n');
+            CHECK(noctern::validation_error("def " + long_name + "(): " + long_name + ";")
+                == "in `nnnnnnnnnnnnnnnn`...: unknown identifier `nnnnnnnnnnnnnnnn`...");
+        }
+
+        TEST_CASE("validate caps nesting") {
+            const auto nested = [](size_t depth) {
+                return "def f(): " + std::string(depth, '(') + "1" + std::string(depth, ')')
+                    + ";";
+            };
+            CHECK(noctern::validation_error(nested(max_validated_depth - 1)) == "");
+            CHECK(noctern::validation_error(nested(max_validated_depth + 1))
+                == "in `f`: expression nested too deeply");
+
+            std::string chain = "def f(): 1";
+            for (size_t i = 0; i <= max_validated_depth; ++i) {
+                chain += " + 1";
+            }
+            CHECK(noctern::validation_error(chain + ";") == "in `f`: expression nested too deeply");
+        }
+    }
+}
@@ -0,0 +1,268 @@
+#include "./value_numbering.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+#include <fmt/format.h>
+
+#include "noctern/arena.hpp"
+#include "noctern/number.hpp"
+#include "noctern/tokenize.hpp"
+
+namespace noctern {
+    namespace {
+        using value_id = int32_t;
+
+        // A node in the value graph of one function body.
+        //
+        // `source` is the token which we copy when emitting the value: the parameter's `ident`, the
+        // literal, or the operator.
+        struct value {
+            token source;
+            value_id lhs = -1;
+            value_id rhs = -1;
+        };
+
+        // Identifies structurally equal values. Literals are keyed by their bits, so that e.g.
+        // `2` and `2.` are the same value.
+        struct value_key {
+            token_id id;
+            uint64_t first;
+            uint64_t second;
+
+            friend bool operator==(const value_key&, const value_key&) = default;
+        };
+
+        struct value_key_hash {
+            size_t operator()(const value_key& key) const {
+                size_t result = std::hash<uint64_t> {}(key.first);
+                result = result * 31 + std::hash<uint64_t> {}(key.second);
+                return result * 31 + static_cast<size_t>(key.id);
+            }
+        };
+
+        class function_rewriter {
+        public:
+            // The rewriter's own state is allocated from `scratch`.
+            function_rewriter(const tokens& input, tokens::rewriter& out, arena& scratch)
+                : input_(input)
+                , out_(out)
+                , values_(arena_allocator<value>(&scratch))
+                , interned_(arena_allocator<std::pair<const value_key, value_id>>(&scratch))
+                , bindings_(arena_allocator<std::pair<const std::string_view, value_id>>(&scratch))
+                , expr_stack_(arena_allocator<value_id>(&scratch))
+                , names_(arena_allocator<std::string_view>(&scratch)) {
+            }
+
+            // Rewrites the function whose `fn_intro` is at `pos`, leaving `pos` after the function.
+            void rewrite_fn(tokens::const_iterator& pos) {
+                assert(input_.id(*pos) == token_id::fn_intro);
+                out_.copy_token(*pos++);
+                assert(input_.id(*pos) == token_id::ident);
+                out_.copy_token(*pos++);
+
+                while (input_.id(*pos) != token_id::rparen) {
+                    assert(input_.id(*pos) == token_id::ident);
+                    out_.copy_token(*pos);
+                    bindings_[input_.string(*pos)] = add_value(value {.source = *pos});
+                    ++pos;
+                }
+                out_.copy_token(*pos++);
+
+                // An expression body's `;` also ends the function; a block is followed by one.
+                value_id result;
+                if (input_.id(*pos) == token_id::lbrace) {
+                    result = read_block(pos);
+                    assert(input_.id(*pos) == token_id::statement_end);
+                    ++pos;
+                } else {
+                    result = read_expr(pos);
+                }
+
+                emit_body(result);
+            }
+
+        private:
+            value_id add_value(value value) {
+                values_.push_back(value);
+                return static_cast<value_id>(values_.size() - 1);
+            }
+
+            value_id intern(value_key key, value value) {
+                auto [it, inserted] = interned_.try_emplace(key, 0);
+                if (inserted) it->second = add_value(value);
+                return it->second;
+            }
+
+            value_id read_block(tokens::const_iterator& pos) {
+                assert(input_.id(*pos) == token_id::lbrace);
+                ++pos;
+
+                while (input_.id(*pos) == token_id::valdef_intro) {
+                    ++pos;
+                    assert(input_.id(*pos) == token_id::ident);
+                    const token ident = *pos;
+                    ++pos;
+
+                    value_id result = read_expr(pos);
+                    // Only bind after `read_expr`, so that `let x = x + 1;` reads the outer `x`.
+                    bindings_[input_.string(ident)] = result;
+                }
+
+                assert(input_.id(*pos) == token_id::return_);
+                ++pos;
+                value_id result = read_expr(pos);
+                assert(input_.id(*pos) == token_id::rbrace);
+                ++pos;
+                return result;
+            }
+
+            // Mirrors `interpreter::eval_expr`, computing value numbers instead of values.
+            value_id read_expr(tokens::const_iterator& pos) {
+                assert(expr_stack_.empty());
+
+                while (input_.id(*pos) != token_id::statement_end) {
+                    token next = *pos;
+                    token_id id = input_.id(next);
+                    ++pos;
+
+                    if (id == token_id::ident) {
+                        auto binding = bindings_.find(input_.string(next));
+                        assert(binding != bindings_.end() && "Unknown identifier");
+                        expr_stack_.push_back(binding->second);
+                    } else if (literal_tokens.contains(id)) {
+                        double literal = noctern::parse_number(input_.string(next));
+                        expr_stack_.push_back(
+                            intern({token_id::real_lit, std::bit_cast<uint64_t>(literal), 0},
+                                value {.source = next}));
+                    } else if (operator_tokens.contains(id)) {
+                        assert(expr_stack_.size() >= 2);
+                        value_id rhs = expr_stack_.back();
+                        expr_stack_.pop_back();
+                        value_id lhs = expr_stack_.back();
+                        expr_stack_.pop_back();
+
+                        expr_stack_.push_back(intern(
+                            {id, static_cast<uint64_t>(lhs), static_cast<uint64_t>(rhs)},
+                            value {.source = next, .lhs = lhs, .rhs = rhs}));
+                    } else {
+                        assert(false && "not an expression token");
+                    }
+                }
+                ++pos;
+
+                assert(expr_stack_.size() == 1);
+                value_id result = expr_stack_.back();
+                expr_stack_.pop_back();
+                return result;
+            }
+
+            bool is_operation(value_id id) const {
+                return values_[id].lhs != -1;
+            }
+
+            void emit_body(value_id result) {
+                // Count the uses of each value reachable from the result. Values are created after
+                // their operands, so a reverse sweep visits every user before its operands.
+                arena_vector<int32_t> uses(values_.size(), 0, values_.get_allocator());
+                uses[result] = 1;
+                for (value_id id = result; id >= 0; --id) {
+                    if (uses[id] == 0 || !is_operation(id)) continue;
+                    ++uses[values_[id].lhs];
+                    ++uses[values_[id].rhs];
+                }
+
+                // Bind each value used more than once, and each which would nest too deep to be
+                // inlined. `depth` counts the operators of a value as it's emitted, with each bound
+                // operand read by name.
+                names_.assign(values_.size(), std::string_view());
+                arena_vector<int32_t> depth(values_.size(), 0, values_.get_allocator());
+                bool any_shared = false;
+                for (value_id id = 0; id <= result; ++id) {
+                    if (uses[id] == 0 || !is_operation(id)) continue;
+                    depth[id] = 1 + std::max(depth[values_[id].lhs], depth[values_[id].rhs]);
+                    if (uses[id] < 2 && depth[id] <= max_inlined_depth) continue;
+                    depth[id] = 0;
+
+                    if (!any_shared) {
+                        out_.add_token(token_without_data(val<token_id::lbrace>));
+                        any_shared = true;
+                    }
+
+                    out_.add_token(token_without_data(val<token_id::valdef_intro>));
+                    std::string_view name = out_.add_synthesized_token(
+                        token_id::ident, fmt::format("${}", next_name_++));
+                    emit_operation(id);
+                    names_[id] = name;
+                    out_.add_token(token_without_data(val<token_id::statement_end>));
+                }
+
+                if (any_shared) {
+                    out_.add_token(token_without_data(val<token_id::return_>));
+                    emit_value(result);
+                    out_.add_token(token_without_data(val<token_id::statement_end>));
+                    out_.add_token(token_without_data(val<token_id::rbrace>));
+                    out_.add_token(token_without_data(val<token_id::statement_end>));
+                } else {
+                    emit_value(result);
+                    out_.add_token(token_without_data(val<token_id::statement_end>));
+                }
+            }
+
+            void emit_value(value_id id) {
+                if (!names_[id].empty()) {
+                    out_.add_token(token_id::ident, names_[id]);
+                } else if (is_operation(id)) {
+                    emit_operation(id);
+                } else {
+                    out_.copy_token(values_[id].source);
+                }
+            }
+
+            void emit_operation(value_id id) {
+                emit_value(values_[id].lhs);
+                emit_value(values_[id].rhs);
+                out_.copy_token(values_[id].source);
+            }
+
+            const tokens& input_;
+            tokens::rewriter& out_;
+
+            arena_vector<value> values_;
+            std::unordered_map<value_key, value_id, value_key_hash, std::equal_to<value_key>,
+                arena_allocator<std::pair<const value_key, value_id>>>
+                interned_;
+            std::unordered_map<std::string_view, value_id, std::hash<std::string_view>,
+                std::equal_to<std::string_view>,
+                arena_allocator<std::pair<const std::string_view, value_id>>>
+                bindings_;
+            arena_vector<value_id> expr_stack_;
+
+            // The synthesized `let` name of each value which is computed into a temporary.
+            arena_vector<std::string_view> names_;
+            int next_name_ = 0;
+        };
+    }
+
+    tokens eliminate_common_subexpressions(const tokens& input) {
+        tokens::rewriter out(input);
+
+        auto pos = input.begin();
+        while (pos != input.end()) {
+            // Each function's value graph only lives while it's rewritten, and is usually small
+            // enough for the stack.
+            std::array<std::byte, 8192> buffer;
+            arena scratch(buffer);
+            function_rewriter(input, out, scratch).rewrite_fn(pos);
+        }
+
+        return tokens(std::move(out));
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "noctern/tokenize.hpp"
+
+namespace noctern {
+    // Rewrites each function in the output of `parse` so that every distinct pure subexpression
+    // is computed at most once, and drops `let`s which are never read.
+    //
+    // Subexpressions which are used more than once are bound to synthesized `let`s (named `$0`,
+    // `$1`, ..., which can't collide with source identifiers). Only structurally identical
+    // subexpressions are shared; nothing is reassociated, so results are bit-identical.
+    //
+    // A subexpression which would nest deeper than `max_inlined_depth` operators, e.g. at the end
+    // of a long chain of `let`s each read once, is bound to a synthesized `let` too.
+    tokens eliminate_common_subexpressions(const tokens& input);
+
+    // How deep `eliminate_common_subexpressions` nests operators. Emitting an expression recurses
+    // for each operator in it, so it's capped rather than growing with the source.
+    inline constexpr int max_inlined_depth = 256;
+}
@@ -0,0 +1,187 @@
+#include "./value_numbering.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <catch2/catch.hpp>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "noctern/compilation_unit.hpp"
+#include "noctern/interpreter.hpp"
+#include "noctern/parser.hpp"
+#include "noctern/symbol_table.hpp"
+#include "noctern/tokenize.test.hpp"
+
+namespace noctern {
+    namespace {
+        struct elaborated_token {
+            noctern::token_id token_id;
+            std::string value;
+
+            elaborated_token(noctern::token_id token_id)
+                : token_id(token_id) {
+                assert(!has_data(token_id));
+            }
+            elaborated_token(noctern::token_id token_id, std::string value)
+                : token_id(token_id)
+                , value(std::move(value)) {
+                assert(has_data(token_id));
+            }
+
+            friend bool operator==(const elaborated_token& lhs, const elaborated_token& rhs)
+                = default;
+
+            friend std::ostream& operator<<(std::ostream& out, const elaborated_token& token) {
+                out << "<" << stringify(token.token_id);
+                if (!token.value.empty()) {
+                    out << ": " << token.value;
+                }
+                return out << ">";
+            }
+        };
+
+        std::vector<elaborated_token> elaborate(const noctern::tokens& tokens) {
+            std::vector<elaborated_token> result;
+
+            for (const token token : tokens) {
+                if (has_data(tokens.id(token))) {
+                    result.emplace_back(tokens.id(token), std::string(tokens.string(token)));
+                } else {
+                    result.emplace_back(tokens.id(token));
+                }
+            }
+
+            return result;
+        }
+
+        double eval(const noctern::tokens& tokens, std::string_view fn,
+            std::unordered_map<std::string_view, double> args) {
+            noctern::compilation_unit cu(tokens);
+            noctern::symbol_table st(tokens, cu);
+            noctern::interpreter interpreter(st);
+
+            return interpreter.eval_fn(tokens, *st.find_fn_decl(fn),
+                noctern::interpreter::frame {
+                    .locals = {args.begin(), args.end()},
+                    .expr_stack = {},
+                });
+        }
+
+        TEST_CASE("eliminate_common_subexpressions shares repeated subexpressions") {
+            using enum noctern::token_id;
+
+            noctern::tokens parsed = noctern::parse(noctern::tokenize_all(R"(
+                def f(x, y): x * y + x * y;
+            )"));
+            noctern::tokens result = noctern::eliminate_common_subexpressions(parsed);
+
+            CHECK_THAT(noctern::elaborate(result),
+                Catch::Matchers::Equals(std::vector<elaborated_token>({
+                    fn_intro,
+                    {ident, "f"},
+                    {ident, "x"},
+                    {ident, "y"},
+                    rparen,
+                    lbrace,
+                    valdef_intro,
+                    {ident, "$0"},
+                    {ident, "x"},
+                    {ident, "y"},
+                    mult,
+                    statement_end,
+                    return_,
+                    {ident, "$0"},
+                    {ident, "$0"},
+                    plus,
+                    statement_end,
+                    rbrace,
+                    statement_end,
+                })));
+
+            CHECK(noctern::eval(result, "f", {{"x", 1.5}, {"y", -3.25}})
+                == noctern::eval(parsed, "f", {{"x", 1.5}, {"y", -3.25}}));
+        }
+
+        TEST_CASE("eliminate_common_subexpressions drops unused lets") {
+            using enum noctern::token_id;
+
+            noctern::tokens parsed = noctern::parse(noctern::tokenize_all(R"(
+                def f(x): {
+                    let unused = x * 3;
+                    let y = x + 1;
+                    return y;
+                };
+            )"));
+            noctern::tokens result = noctern::eliminate_common_subexpressions(parsed);
+
+            CHECK_THAT(noctern::elaborate(result),
+                Catch::Matchers::Equals(std::vector<elaborated_token>({
+                    fn_intro,
+                    {ident, "f"},
+                    {ident, "x"},
+                    rparen,
+                    {ident, "x"},
+                    {int_lit, "1"},
+                    plus,
+                    statement_end,
+                })));
+        }
+
+        TEST_CASE("eliminate_common_subexpressions preserves results") {
+            noctern::tokens parsed = noctern::parse(noctern::tokenize_all(R"(
+                def f(x, y): {
+                    let a = x * 2. + y / 3;
+                    let b = x * 2 + y / 3.0;
+                    let x = a - b;
+                    let c = (x + y) * (x + y) - a * b;
+                    return c / (a * b) + x;
+                };
+            )"));
+            noctern::tokens result = noctern::eliminate_common_subexpressions(parsed);
+
+            CHECK(result.num_tokens() < parsed.num_tokens());
+
+            for (double x : {0.0, -1.5, 3.0e10, 1.0 / 3}) {
+                for (double y : {0.1, 7.0, -0.0}) {
+                    double expected = noctern::eval(parsed, "f", {{"x", x}, {"y", y}});
+                    double actual = noctern::eval(result, "f", {{"x", x}, {"y", y}});
+                    CHECK(std::bit_cast<uint64_t>(actual) == std::bit_cast<uint64_t>(expected));
+                }
+            }
+        }
+
+        TEST_CASE("eliminate_common_subexpressions caps the depth of long chains") {
+            // Each `let` is read once, so all of them would be inlined into one expression.
+            constexpr int length = 100000;
+            std::string source = "def f(x): { let b0 = x;";
+            for (int i = 1; i <= length; ++i) {
+                source += fmt::format(" let b{} = b{} + 1;", i, i - 1);
+            }
+            source += fmt::format(" return b{}; }};", length);
+
+            noctern::tokens result = noctern::eliminate_common_subexpressions(
+                noctern::parse(noctern::tokenize_all(source)));
+
+            int num_lets = 0;
+            int num_operators = 0;
+            int max_operators = 0;
+            for (const token token : result) {
+                const token_id id = result.id(token);
+                if (id == token_id::valdef_intro) ++num_lets;
+                if (operator_tokens.contains(id)) {
+                    max_operators = std::max(max_operators, ++num_operators);
+                }
+                if (id == token_id::statement_end) num_operators = 0;
+            }
+            CHECK(num_lets == length / (max_inlined_depth + 1));
+            CHECK(max_operators == max_inlined_depth + 1);
+
+            CHECK(noctern::eval(result, "f", {{"x", 0.5}}) == length + 0.5);
+        }
+    }
+}
@@ -1,72 +1,510 @@
+#include <algorithm>
+#include <cassert>
 #include <cerrno>
-#include <cstddef>
+#include <charconv>
+#include <chrono>
+#include <csignal>
 #include <cstdio>
 #include <cstring>
+#include <filesystem>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 #include <fmt/core.h>
 
+#include "noctern/arena.hpp"
+#include "noctern/batch.hpp"
 #include "noctern/compilation_unit.hpp"
+#include "noctern/compile_cache.hpp"
+#include "noctern/compiled_fn.hpp"
+#include "noctern/eval_server.hpp"
+#include "noctern/fast_math.hpp"
+#include "noctern/file_watcher.hpp"
 #include "noctern/interpreter.hpp"
+#include "noctern/ir.hpp"
+#include "noctern/lazy_module.hpp"
+#include "noctern/memory_stats.hpp"
 #include "noctern/parser.hpp"
+#include "noctern/perf_counters.hpp"
+#include "noctern/program.hpp"
+#include "noctern/source_file.hpp"
+#include "noctern/source_loader.hpp"
 #include "noctern/symbol_table.hpp"
 #include "noctern/tokenize.hpp"
+#include "noctern/value_numbering.hpp"
+
+namespace {
+    noctern::eval_server* running_server = nullptr;
+
+    int serve(const char* socket_path, int num_threads, const char* module_root) {
+        auto server = noctern::eval_server::listen(socket_path, num_threads, module_root);
+        if (!server.has_value()) {
+            fmt::println(stderr, "Couldn't serve {} on {}: {}", module_root, socket_path,
+                server.error().message());
+            return 1;
+        }
+
+        running_server = server->get();
+        const auto stop = [](int) { running_server->stop(); };
+        std::signal(SIGINT, stop);
+        std::signal(SIGTERM, stop);
+
+        fmt::println(stderr, "Serving the modules under {} on {} with {} worker threads",
+            module_root, socket_path, num_threads);
+        (*server)->run();
+        return 0;
+    }
+
+    // Evaluates `Main()`, parsing only what that needs.
+    std::optional<double> eval_main(noctern::lazy_module& module, noctern::math_mode math_mode) {
+        const std::optional<noctern::lazy_module::function> main = module.find_fn_decl("Main");
+        if (!main.has_value()) {
+            fmt::println(stderr, "No `Main()` function found!");
+            return std::nullopt;
+        }
+
+        if (math_mode != noctern::math_mode::strict) {
+            noctern::ir::module ir = noctern::ir::build(main->tokens);
+            noctern::optimize_math(ir, math_mode);
+            return noctern::lower(*ir.find("Main")).call({});
+        }
+
+        noctern::interpreter interpreter(main->symbols);
+        return interpreter.eval_fn(main->tokens, main->decl, noctern::interpreter::frame {});
+    }
+
+    int run_lazy(const std::filesystem::path& path, noctern::math_mode math_mode) {
+        auto source = noctern::source_file::open(path.c_str());
+        if (!source.has_value()) {
+            fmt::println(
+                stderr, "Couldn't read file {}: {}", path.string(), source.error().message());
+            return 1;
+        }
+
+        noctern::lazy_module module(source->contents());
+        const std::optional<double> result = eval_main(module, math_mode);
+        if (!result.has_value()) return 1;
+        fmt::println(stdout, "Result: {}", *result);
+        return 0;
+    }
+
+    // Re-evaluates `Main()` each time the file changes. Functions are kept parsed across changes
+    // unless their text changed, so the time to react depends on what was edited rather than on
+    // the size of the file.
+    int watch(const std::filesystem::path& path, noctern::math_mode math_mode) {
+        auto watcher = noctern::file_watcher::watch(path);
+        if (!watcher.has_value()) {
+            fmt::println(stderr, "Couldn't watch {}: {}", path.string(), watcher.error().message());
+            return 1;
+        }
+
+        std::optional<noctern::source_file> source;
+        std::optional<noctern::lazy_module> module;
+        while (true) {
+            const auto start = std::chrono::steady_clock::now();
+            // Copied rather than mapped: an editor may truncate the file while it's read.
+            auto loaded = noctern::source_file::open_copy(path.c_str());
+            if (!loaded.has_value()) {
+                fmt::println(
+                    stderr, "Couldn't read file {}: {}", path.string(), loaded.error().message());
+            } else {
+                // The module may still refer to the old source until it's reloaded.
+                if (module.has_value()) {
+                    module->reload(loaded->contents());
+                } else {
+                    module.emplace(loaded->contents());
+                }
+                source = std::move(*loaded);
+
+                const size_t num_kept = module->num_parsed();
+                const std::optional<double> result = eval_main(*module, math_mode);
+                const std::chrono::duration<double, std::milli> elapsed
+                    = std::chrono::steady_clock::now() - start;
+                if (result.has_value()) fmt::println(stdout, "Result: {}", *result);
+                fmt::println(stderr, "Evaluated in {:.2f}ms, parsing {} of {} functions",
+                    elapsed.count(), module->num_parsed() - num_kept, module->num_functions());
+            }
+            std::fflush(stdout);
+
+            if (std::error_code error = watcher->wait(); error) {
+                fmt::println(stderr, "Couldn't watch {}: {}", path.string(), error.message());
+                return 1;
+            }
+        }
+    }
+
+    // Evaluates `Main()` one phase at a time, reporting each phase's hardware counters.
+    //
+    // On a single thread, without the compile cache, so that the phases are comparable between
+    // runs.
+    int run_with_perf_counters(const std::filesystem::path& path) {
+        auto source = noctern::source_file::open(path.c_str());
+        if (!source.has_value()) {
+            fmt::println(
+                stderr, "Couldn't read file {}: {}", path.string(), source.error().message());
+            return 1;
+        }
+
+        noctern::perf_counters counters;
+        if (!counters.available()) {
+            fmt::println(stderr, "No hardware counters ({}); only reporting time",
+                counters.error().message());
+        }
+
+        noctern::arena arena;
+        std::optional<noctern::tokens> lexed;
+        const noctern::perf_sample lex = counters.measure(
+            [&] { lexed.emplace(noctern::tokenize_all(source->contents(), &arena)); });
+        const size_t num_tokens = lexed->num_tokens();
+
+        std::optional<noctern::tokens> parsed;
+        const noctern::perf_sample parse
+            = counters.measure([&] { parsed.emplace(noctern::parse(std::move(*lexed))); });
+
+        std::optional<noctern::compilation_unit> unit;
+        std::optional<noctern::symbol_table> symbols;
+        const noctern::perf_sample symbol_table = counters.measure([&] {
+            unit.emplace(*parsed);
+            symbols.emplace(*parsed, *unit);
+        });
+
+        const std::optional<noctern::token> main = symbols->find_fn_decl("Main");
+        if (!main.has_value()) {
+            fmt::println(stderr, "No `Main()` function found!");
+            return 1;
+        }
+        const noctern::interpreter interpreter(*symbols);
+        double result = 0;
+        const noctern::perf_sample eval = counters.measure([&] {
+            result = interpreter.eval_fn(*parsed, *main, noctern::interpreter::frame {});
+        });
+
+        for (const auto& [name, sample] : {std::pair("lex", lex), std::pair("parse", parse),
+                 std::pair("symbol table", symbol_table), std::pair("eval", eval)}) {
+            fmt::println(stderr, "{:<14}{}", name,
+                noctern::format_perf_sample(sample, num_tokens, "token"));
+        }
+        fmt::println(stdout, "Result: {}", result);
+        return 0;
+    }
+
+    // Evaluates `Main()` one phase at a time, reporting the memory each phase allocates and what
+    // its results keep, per byte of source and per token.
+    int run_with_mem_stats(const std::filesystem::path& path) {
+        auto source = noctern::source_file::open(path.c_str());
+        if (!source.has_value()) {
+            fmt::println(
+                stderr, "Couldn't read file {}: {}", path.string(), source.error().message());
+            return 1;
+        }
+        const std::string_view contents = source->contents();
+
+        noctern::arena arena;
+        std::optional<noctern::tokens> lexed;
+        noctern::memory_sample lex = noctern::measure_allocations(
+            arena, [&] { lexed.emplace(noctern::tokenize_all(contents, &arena)); });
+        lex.retained = lexed->memory_usage();
+        const size_t num_tokens = lexed->num_tokens();
+
+        std::optional<noctern::tokens> parsed;
+        noctern::memory_sample parse = noctern::measure_allocations(
+            arena, [&] { parsed.emplace(noctern::parse(std::move(*lexed))); });
+        parse.retained = parsed->memory_usage();
+
+        std::optional<noctern::compilation_unit> unit;
+        std::optional<noctern::symbol_table> symbols;
+        noctern::memory_sample symbol_table = noctern::measure_allocations(arena, [&] {
+            unit.emplace(*parsed);
+            symbols.emplace(*parsed, *unit);
+        });
+        symbol_table.retained = unit->memory_usage() + symbols->memory_usage();
+
+        const std::optional<noctern::token> main = symbols->find_fn_decl("Main");
+        if (!main.has_value()) {
+            fmt::println(stderr, "No `Main()` function found!");
+            return 1;
+        }
+        // The frames die with the evaluation, so it retains nothing.
+        const noctern::interpreter interpreter(*symbols);
+        double result = 0;
+        const noctern::memory_sample eval = noctern::measure_allocations(arena, [&] {
+            result = interpreter.eval_fn(*parsed, *main, noctern::interpreter::frame {}, arena);
+        });
+
+        fmt::println(stderr, "{} source bytes, {} tokens", contents.size(), num_tokens);
+        for (const auto& [name, sample] : {std::pair("lex", lex), std::pair("parse", parse),
+                 std::pair("symbol table", symbol_table), std::pair("eval", eval)}) {
+            fmt::println(stderr, "{:<14}{}", name,
+                noctern::format_memory_sample(sample, contents.size(), num_tokens));
+        }
+        fmt::println(stderr, "{:<14}{}", "peak RSS", noctern::format_bytes(noctern::peak_rss()));
+        fmt::println(stdout, "Result: {}", result);
+        return 0;
+    }
+
+    bool is_csv(std::string_view path) {
+        return path == "-" || path.ends_with(".csv");
+    }
+
+    // nocternc apply <file.nct> <fn> --input <path>... --output <path> [--math=...]
+    //
+    // A `.csv` (or `-`, for stdin/stdout) input has one field per parameter of `fn`. Otherwise,
+    // there must be one `--input` per parameter, each a column of raw little-endian doubles. The
+    // output is likewise CSV or a column of doubles.
+    int apply(int argc, char** argv) {
+        const char* path = nullptr;
+        const char* fn_name = nullptr;
+        std::vector<std::string> inputs;
+        const char* output_path = nullptr;
+        std::optional<noctern::math_mode> math_mode = noctern::math_mode::strict;
+        bool bad_usage = false;
+        for (int i = 0; i < argc && !bad_usage; ++i) {
+            std::string_view arg = argv[i];
+            if (arg == "--input" && i + 1 < argc) {
+                inputs.emplace_back(argv[++i]);
+            } else if (arg == "--output" && i + 1 < argc) {
+                output_path = argv[++i];
+            } else if (arg.starts_with("--math=")) {
+                math_mode
+                    = noctern::parse_math_mode(arg.substr(std::string_view("--math=").size()));
+            } else if (path == nullptr && !arg.starts_with("--")) {
+                path = argv[i];
+            } else if (fn_name == nullptr && !arg.starts_with("--")) {
+                fn_name = argv[i];
+            } else {
+                bad_usage = true;
+            }
+        }
+        if (bad_usage || fn_name == nullptr || inputs.empty() || output_path == nullptr
+            || !math_mode.has_value()) {
+            fmt::println(stderr,
+                "Usage: nocternc apply <file.nct> <fn> --input <path>... --output <path> "
+                "[--math=strict|contract|fast]");
+            return 1;
+        }
+
+        auto source = noctern::source_file::open(path);
+        if (!source.has_value()) {
+            fmt::println(stderr, "Couldn't read file {}: {}", path, source.error().message());
+            return 1;
+        }
+        noctern::arena arena;
+        noctern::ir::module module = noctern::ir::build(noctern::eliminate_common_subexpressions(
+            noctern::parse(noctern::tokenize_all(source->contents(), &arena))));
+        noctern::optimize_math(module, *math_mode);
+        const noctern::ir::function* fn = module.find(fn_name);
+        if (fn == nullptr) {
+            fmt::println(stderr, "No `{}` function found!", fn_name);
+            return 1;
+        }
+        const noctern::compiled_fn compiled = noctern::lower(*fn);
+
+        std::unique_ptr<noctern::batch_input> input;
+        std::FILE* input_file = nullptr;
+        if (inputs.size() == 1 && is_csv(inputs[0])) {
+            input_file = inputs[0] == "-" ? stdin : std::fopen(inputs[0].c_str(), "rb");
+            if (input_file == nullptr) {
+                fmt::println(stderr, "Couldn't read {}: {}", inputs[0], std::strerror(errno));
+                return 1;
+            }
+            input = std::make_unique<noctern::csv_input>(input_file, fn->num_params());
+        } else if (inputs.size() != static_cast<size_t>(fn->num_params())) {
+            fmt::println(stderr, "`{}` takes {} arguments, but got {} input columns", fn_name,
+                fn->num_params(), inputs.size());
+            return 1;
+        } else {
+            auto columns = noctern::column_input::open(inputs);
+            if (!columns.has_value()) {
+                fmt::println(stderr, "{}", columns.error());
+                return 1;
+            }
+            input = std::make_unique<noctern::column_input>(std::move(*columns));
+        }
+
+        const std::string_view output_name = output_path;
+        std::FILE* output_file = output_name == "-" ? stdout : std::fopen(output_path, "wb");
+        if (output_file == nullptr) {
+            fmt::println(stderr, "Couldn't write {}: {}", output_name, std::strerror(errno));
+            return 1;
+        }
+        std::unique_ptr<noctern::batch_output> output;
+        if (is_csv(output_name)) {
+            output = std::make_unique<noctern::csv_output>(output_file);
+        } else {
+            output = std::make_unique<noctern::column_output>(output_file);
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        auto rows = noctern::apply(compiled, *input, *output);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        if (input_file != nullptr && input_file != stdin) std::fclose(input_file);
+        if (output_file != stdout) std::fclose(output_file);
+
+        if (!rows.has_value()) {
+            fmt::println(stderr, "{}", rows.error());
+            return 1;
+        }
+        fmt::println(stderr, "Applied `{}` to {} rows in {:.3f}s ({:.0f} rows/s)", fn_name, *rows,
+            elapsed.count(), static_cast<double>(*rows) / elapsed.count());
+        return 0;
+    }
+}
 
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        fmt::println(stderr, "Usage: nocternc <file.nct>");
-        return 1;
+    if (argc > 1 && std::string_view(argv[1]) == "apply") {
+        return apply(argc - 2, argv + 2);
     }
 
-    // TODO: mmap
-    std::FILE* file = std::fopen(argv[1], "rb");
-    if (file == nullptr) {
-        std::string err(std::strerror(errno));
-        fmt::println(stderr, "Couldn't find file {}: {}", argv[1], err);
-        return 1;
+    bool emit_ir = false;
+    bool lazy = false;
+    bool watch_file = false;
+    bool perf_counters = false;
+    bool mem_stats = false;
+    std::optional<noctern::math_mode> math_mode = noctern::math_mode::strict;
+    const char* serve_path = nullptr;
+    const char* module_root = ".";
+    const char* cache_dir = nullptr;
+    std::optional<noctern::source_io> source_io = noctern::source_io::io_uring;
+    int num_threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    std::vector<std::string> paths;
+    bool bad_usage = false;
+    for (int i = 1; i < argc && !bad_usage; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "--emit-ir") {
+            emit_ir = true;
+        } else if (arg == "--lazy") {
+            lazy = true;
+        } else if (arg == "--watch") {
+            watch_file = true;
+        } else if (arg == "--perf-counters") {
+            perf_counters = true;
+        } else if (arg == "--mem-stats") {
+            mem_stats = true;
+        } else if (arg.starts_with("--math=")) {
+            math_mode = noctern::parse_math_mode(arg.substr(std::string_view("--math=").size()));
+        } else if (arg.starts_with("--cache-dir=")) {
+            cache_dir = argv[i] + std::string_view("--cache-dir=").size();
+        } else if (arg.starts_with("--io=")) {
+            source_io = noctern::parse_source_io(arg.substr(std::string_view("--io=").size()));
+        } else if (arg == "--serve" && i + 1 < argc) {
+            serve_path = argv[++i];
+        } else if (arg.starts_with("--module-root=")) {
+            module_root = argv[i] + std::string_view("--module-root=").size();
+        } else if (arg.starts_with("--threads=")) {
+            std::string_view value = arg.substr(std::string_view("--threads=").size());
+            auto [ptr, ec]
+                = std::from_chars(value.data(), value.data() + value.size(), num_threads);
+            bad_usage = ec != std::errc {} || ptr != value.data() + value.size() || num_threads < 1;
+        } else if (!arg.starts_with("--")) {
+            paths.emplace_back(arg);
+        } else {
+            bad_usage = true;
+        }
     }
-    if (std::fseek(file, 0, SEEK_END) != 0) {
-        std::string err(std::strerror(errno));
-        fmt::println(stderr, "fseek failed: {}", err);
-        return 1;
+    if (serve_path != nullptr && paths.empty() && !bad_usage) {
+        return serve(serve_path, num_threads, module_root);
     }
-    long length = std::ftell(file);
-    if (length == -1) {
-        std::string err(std::strerror(errno));
-        fmt::println(stderr, "ftell failed: {}", err);
+    if (bad_usage || paths.empty() || !math_mode.has_value() || !source_io.has_value()) {
+        fmt::println(stderr,
+            "Usage: nocternc [--emit-ir] [--math=strict|contract|fast] [--cache-dir=<dir>] "
+            "[--threads=N] [--io=mmap|pread|io_uring] <file.nct | dir>...");
+        fmt::println(
+            stderr, "       nocternc --lazy|--watch [--math=strict|contract|fast] <file.nct>");
+        fmt::println(stderr, "       nocternc --perf-counters|--mem-stats <file.nct>");
+        fmt::println(
+            stderr, "       nocternc --serve <socket> [--threads=N] [--module-root=<dir>]");
+        fmt::println(
+            stderr, "       nocternc apply <file.nct> <fn> --input <path>... --output <path>");
         return 1;
     }
-    if (std::fseek(file, 0, SEEK_SET) != 0) {
-        std::string err(std::strerror(errno));
-        fmt::println(stderr, "fseek failed: {}", err);
+
+    auto sources = noctern::find_sources(paths);
+    if (!sources.has_value()) {
+        fmt::println(stderr, "{}", sources.error());
         return 1;
     }
-    std::string source(length, '\0');
-    [[maybe_unused]] size_t c = std::fread(source.data(), source.size(), length, file);
-    if (std::ferror(file) != 0) {
-        std::string err(std::strerror(errno));
-        fmt::println(stderr, "fread failed: {}", err);
-        return 1;
+    if (perf_counters || mem_stats) {
+        if (sources->size() != 1 || emit_ir || lazy || watch_file || (perf_counters && mem_stats)
+            || *math_mode != noctern::math_mode::strict) {
+            fmt::println(stderr,
+                "--perf-counters and --mem-stats take a single file, and only run the strict "
+                "interpreter");
+            return 1;
+        }
+        if (mem_stats) return run_with_mem_stats(sources->front());
+        return run_with_perf_counters(sources->front());
+    }
+    if (lazy || watch_file) {
+        if (sources->size() != 1 || emit_ir) {
+            fmt::println(stderr, "--lazy and --watch take a single file, and don't emit IR");
+            return 1;
+        }
+        if (watch_file) return watch(sources->front(), *math_mode);
+        return run_lazy(sources->front(), *math_mode);
     }
-    if (std::feof(file) == 0) {
-        std::string err(std::strerror(errno));
-        fmt::println(stderr, "failed to read entire file; didn't find eof.");
+
+    // Cached files skip the front end entirely.
+    std::optional<noctern::compile_cache> cache;
+    if (cache_dir != nullptr) cache.emplace(cache_dir);
+
+    auto program = noctern::program::compile(
+        *sources, num_threads, cache.has_value() ? &*cache : nullptr, *source_io);
+    if (!program.has_value()) {
+        fmt::println(stderr, "{}", program.error());
         return 1;
     }
+    for (const noctern::duplicate_definition& duplicate : program->duplicates()) {
+        fmt::println(stderr, "Duplicate definition of `{}` in {}; first defined in {}",
+            duplicate.name, program->files()[duplicate.duplicate_file].path().string(),
+            program->files()[duplicate.first_file].path().string());
+    }
+    if (!program->duplicates().empty()) return 1;
 
-    noctern::tokens tokens = noctern::tokenize_all(source);
-    tokens = noctern::parse(std::move(tokens));
-    noctern::compilation_unit compile_unit(tokens);
-    noctern::symbol_table symbol_table(tokens, compile_unit);
+    const std::optional<noctern::fn_location> main = program->find_fn_decl("Main");
+
+    const auto build_ir = [&](const noctern::program_file& file) {
+        noctern::ir::module module = noctern::ir::build(file.tokens());
+        noctern::optimize_math(module, *math_mode);
+        for (const noctern::ir::function& fn : module.functions) {
+            for (const std::string& error : noctern::ir::verify(fn)) {
+                fmt::println(stderr, "Invalid IR in `{}`: {}", fn.name, error);
+            }
+        }
+        return module;
+    };
+
+    if (emit_ir) {
+        for (const noctern::program_file& file : program->files()) {
+            if (program->files().size() > 1) fmt::println(stdout, "; {}", file.path().string());
+            fmt::print(stdout, "{}", noctern::ir::dump(build_ir(file)));
+        }
+        return 0;
+    }
 
-    std::optional<noctern::token> main = symbol_table.find_fn_decl("Main");
     if (!main.has_value()) {
         fmt::println(stderr, "No `Main()` function found!");
         return 1;
     }
+    const noctern::program_file& main_file = program->files()[main->file];
+
+    if (*math_mode != noctern::math_mode::strict) {
+        // The interpreter only executes strict arithmetic; run the optimized IR instead.
+        const noctern::ir::module module = build_ir(main_file);
+        const noctern::ir::function* main_fn = module.find("Main");
+        assert(main_fn != nullptr);
+        double result = noctern::lower(*main_fn).call({});
+        fmt::println(stdout, "Result: {}", result);
+        return 0;
+    }
 
-    noctern::interpreter interpreter(std::move(symbol_table));
-    double result = interpreter.eval_fn(tokens, *main, noctern::interpreter::frame {});
+    noctern::interpreter interpreter(main_file.symbols());
+    double result
+        = interpreter.eval_fn(main_file.tokens(), main->decl, noctern::interpreter::frame {});
 
     fmt::println(stdout, "Result: {}", result);
 